@@ -0,0 +1,773 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkBinaryRunLengthLine_h
+#define itkBinaryRunLengthLine_h
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility> // std::pair
+
+namespace itk
+{
+/** \class BinaryRunLengthLine
+ *
+ *  \brief A line of a binary mask, stored as alternating run lengths.
+ *
+ *  Only the run lengths and the value of the first run are stored.
+ *  Consecutive segments always have different values, so the value of
+ *  segment i is the first value if i is even, and its negation otherwise.
+ *  This halves the segment size compared to RunLengthLine<bool, CounterType>,
+ *  and the line object holds up to InlineCapacity segments without a heap
+ *  allocation. Selected through the last template parameter of RLEImage,
+ *  see BinaryMaskRLEImage:
+ *  \code
+ *  using MaskType = itk::RLEImage<bool, 3, unsigned short, itk::BinaryRunLengthLine<unsigned short>>;
+ *  \endcode
+ *  With a pixel type other than bool, segments hold palette indices,
+ *  so the image can hold any two pixel values (e.g. 0 and 255).
+ *
+ *  The interface is the same as RunLengthLine's, with these differences
+ *  which keep the values alternating:
+ *  - push_back() extends the last segment if it has the same value.
+ *  - Inserted segments alternate, starting with the given value. Inserting
+ *    at the front sets the first value, so an odd number of segments has to
+ *    start with the opposite of the current first value.
+ *    Elsewhere an odd number of segments can only be inserted at the end.
+ *  - An odd number of segments can only be erased from either end.
+ *  - Assigning a different value to a segment inverts the whole line.
+ *  Runs cannot be split into several segments, so CounterType limits
+ *  the line length (see LimitsLineLength).
+ *
+ *  \ingroup RLEImage
+ */
+template <typename CounterType>
+class BinaryRunLengthLine
+{
+public:
+  /** First element is count of repetitions,
+   * second element is the pixel value. */
+  using value_type = std::pair<CounterType, bool>;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using allocator_type = std::allocator<char>; // segments come from the global heap
+
+  /** Behaves like a reference to the value of a segment. */
+  class value_reference
+  {
+  public:
+    value_reference(BinaryRunLengthLine & line, size_type index)
+      : m_Line(&line)
+      , m_Index(index)
+    {}
+
+    value_reference(const value_reference &) = default;
+
+    operator const bool &() const { return m_Line->ValueAt(m_Index); }
+
+    /** Inverts the line if value differs from the value of this segment. */
+    value_reference &
+    operator=(bool value)
+    {
+      m_Line->SetFirstValue(value != ((m_Index & 1) != 0));
+      return *this;
+    }
+
+    value_reference &
+    operator=(const value_reference & other)
+    {
+      return *this = bool(other);
+    }
+
+  private:
+    BinaryRunLengthLine * m_Line;
+    size_type             m_Index;
+  };
+
+  /** Behaves like std::pair<CounterType, bool> &. */
+  class reference
+  {
+  public:
+    reference(BinaryRunLengthLine & line, size_type index)
+      : first(line.counts()[index])
+      , second(line, index)
+    {}
+
+    reference(const reference &) = default;
+
+    reference &
+    operator=(const reference & other)
+    {
+      return *this = value_type(other);
+    }
+
+    reference &
+    operator=(const value_type & segment)
+    {
+      first = segment.first;
+      second = segment.second;
+      return *this;
+    }
+
+    operator value_type() const { return value_type(first, second); }
+
+    CounterType &   first;
+    value_reference second;
+  };
+
+  /** Behaves like const std::pair<CounterType, bool> &. */
+  class const_reference
+  {
+  public:
+    const_reference(const BinaryRunLengthLine & line, size_type index)
+      : first(line.counts()[index])
+      , second(line.ValueAt(index))
+    {}
+
+    const_reference(const reference & other)
+      : first(other.first)
+      , second(other.second)
+    {}
+
+    operator value_type() const { return value_type(first, second); }
+
+    const CounterType & first;
+    const bool &        second;
+  };
+
+  /** Random access iterator, refers to a segment by its index. */
+  template <typename TReference, typename TLine>
+  class IteratorBase
+  {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename BinaryRunLengthLine::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = TReference;
+    using pointer = void;
+
+    IteratorBase() = default;
+
+    IteratorBase(TLine * line, size_type index)
+      : m_Line(line)
+      , m_Index(index)
+    {}
+
+    /** Allows conversion of iterator to const_iterator. */
+    template <typename TOtherReference, typename TOtherLine>
+    IteratorBase(const IteratorBase<TOtherReference, TOtherLine> & other)
+      : m_Line(other.m_Line)
+      , m_Index(other.m_Index)
+    {}
+
+    reference
+    operator*() const
+    {
+      return reference(*m_Line, m_Index);
+    }
+
+    reference
+    operator[](difference_type n) const
+    {
+      return reference(*m_Line, m_Index + n);
+    }
+
+    IteratorBase &
+    operator++()
+    {
+      ++m_Index;
+      return *this;
+    }
+
+    IteratorBase
+    operator++(int)
+    {
+      IteratorBase old = *this;
+      ++m_Index;
+      return old;
+    }
+
+    IteratorBase &
+    operator--()
+    {
+      --m_Index;
+      return *this;
+    }
+
+    IteratorBase
+    operator--(int)
+    {
+      IteratorBase old = *this;
+      --m_Index;
+      return old;
+    }
+
+    IteratorBase &
+    operator+=(difference_type n)
+    {
+      m_Index += n;
+      return *this;
+    }
+
+    IteratorBase &
+    operator-=(difference_type n)
+    {
+      m_Index -= n;
+      return *this;
+    }
+
+    IteratorBase
+    operator+(difference_type n) const
+    {
+      return IteratorBase(m_Line, m_Index + n);
+    }
+
+    IteratorBase
+    operator-(difference_type n) const
+    {
+      return IteratorBase(m_Line, m_Index - n);
+    }
+
+    difference_type
+    operator-(const IteratorBase & other) const
+    {
+      return difference_type(m_Index) - difference_type(other.m_Index);
+    }
+
+    bool
+    operator==(const IteratorBase & other) const
+    {
+      return m_Index == other.m_Index;
+    }
+
+    bool
+    operator!=(const IteratorBase & other) const
+    {
+      return m_Index != other.m_Index;
+    }
+
+    bool
+    operator<(const IteratorBase & other) const
+    {
+      return m_Index < other.m_Index;
+    }
+
+    bool
+    operator>(const IteratorBase & other) const
+    {
+      return m_Index > other.m_Index;
+    }
+
+    bool
+    operator<=(const IteratorBase & other) const
+    {
+      return m_Index <= other.m_Index;
+    }
+
+    bool
+    operator>=(const IteratorBase & other) const
+    {
+      return m_Index >= other.m_Index;
+    }
+
+    TLine *   m_Line{ nullptr };
+    size_type m_Index{ 0 };
+  };
+
+  using iterator = IteratorBase<reference, BinaryRunLengthLine>;
+  using const_iterator = IteratorBase<const_reference, const BinaryRunLengthLine>;
+
+  /** Runs are never split, so CounterType limits the line length. */
+  static constexpr bool LimitsLineLength = true;
+
+  /** Consecutive segments always have different values. */
+  static constexpr bool AlternatesValues = true;
+
+  /** Lines are always stored as segments. */
+  static constexpr bool StoresPixelRows = false;
+
+  /** Number of segments stored without a heap allocation. */
+  static constexpr size_type InlineCapacity =
+    sizeof(CounterType *) >= sizeof(CounterType) ? sizeof(CounterType *) / sizeof(CounterType) : 1;
+
+  BinaryRunLengthLine() = default;
+
+  /** count segments of the given length, alternating values starting with the given one. */
+  explicit BinaryRunLengthLine(size_type count, const value_type & value = value_type())
+  {
+    this->Reallocate(count);
+    std::fill_n(this->counts(), count, value.first);
+    m_Size = static_cast<std::uint32_t>(count);
+    this->SetFirstValue(value.second);
+  }
+
+  /** Copies get exactly sized storage, inline if it is small enough. */
+  BinaryRunLengthLine(const BinaryRunLengthLine & other)
+  {
+    this->Reallocate(other.m_Size);
+    std::copy_n(other.counts(), other.m_Size, this->counts());
+    m_Size = other.m_Size;
+    this->SetFirstValue(other.GetFirstValue());
+  }
+
+  BinaryRunLengthLine(BinaryRunLengthLine && other) noexcept
+    : m_Storage(other.m_Storage)
+    , m_Size(other.m_Size)
+    , m_Capacity(other.m_Capacity)
+  {
+    other.m_Size = 0;
+    other.m_Capacity = InlineCapacity | InlineFlag;
+  }
+
+  BinaryRunLengthLine &
+  operator=(const BinaryRunLengthLine & other)
+  {
+    if (this != &other)
+    {
+      if (this->capacity() < other.m_Size)
+      {
+        m_Size = 0;
+        this->Reallocate(other.m_Size);
+      }
+      std::copy_n(other.counts(), other.m_Size, this->counts());
+      m_Size = other.m_Size;
+      this->SetFirstValue(other.GetFirstValue());
+    }
+    return *this;
+  }
+
+  BinaryRunLengthLine &
+  operator=(BinaryRunLengthLine && other) noexcept
+  {
+    this->swap(other);
+    return *this;
+  }
+
+  ~BinaryRunLengthLine() { this->Release(); }
+
+  size_type
+  size() const
+  {
+    return m_Size;
+  }
+
+  bool
+  empty() const
+  {
+    return m_Size == 0;
+  }
+
+  size_type
+  capacity() const
+  {
+    return m_Capacity & ~(ExternalFlag | InlineFlag | TrueFirstFlag);
+  }
+
+  reference
+  operator[](size_type i)
+  {
+    assert(i < m_Size);
+    return reference(*this, i);
+  }
+
+  const_reference
+  operator[](size_type i) const
+  {
+    assert(i < m_Size);
+    return const_reference(*this, i);
+  }
+
+  reference
+  front()
+  {
+    return (*this)[0];
+  }
+
+  const_reference
+  front() const
+  {
+    return (*this)[0];
+  }
+
+  reference
+  back()
+  {
+    return (*this)[m_Size - 1];
+  }
+
+  const_reference
+  back() const
+  {
+    return (*this)[m_Size - 1];
+  }
+
+  /** Contiguous array of run lengths, which are all a mask operation needs. */
+  CounterType *
+  counts()
+  {
+    return this->IsInline() ? m_Storage.m_Inline : m_Storage.m_Heap;
+  }
+
+  const CounterType *
+  counts() const
+  {
+    return this->IsInline() ? m_Storage.m_Inline : m_Storage.m_Heap;
+  }
+
+  /** Value of the first segment. */
+  bool
+  GetFirstValue() const
+  {
+    return (m_Capacity & TrueFirstFlag) != 0;
+  }
+
+  /** Sets the value of the first segment, which inverts the line if it differs. */
+  void
+  SetFirstValue(bool value)
+  {
+    m_Capacity = value ? (m_Capacity | TrueFirstFlag) : (m_Capacity & ~TrueFirstFlag);
+  }
+
+  iterator
+  begin()
+  {
+    return iterator(this, 0);
+  }
+
+  const_iterator
+  begin() const
+  {
+    return const_iterator(this, 0);
+  }
+
+  iterator
+  end()
+  {
+    return iterator(this, m_Size);
+  }
+
+  const_iterator
+  end() const
+  {
+    return const_iterator(this, m_Size);
+  }
+
+  void
+  reserve(size_type n)
+  {
+    if (n > this->capacity())
+    {
+      this->Reallocate(n);
+    }
+  }
+
+  /** Reduce capacity to size, moving short lines inline.
+   * External storage is left alone. */
+  void
+  shrink_to_fit()
+  {
+    if (!this->IsExternal() && !this->IsInline() && this->capacity() > m_Size)
+    {
+      this->Reallocate(m_Size);
+    }
+  }
+
+  void
+  clear()
+  {
+    m_Size = 0;
+  }
+
+  /** Appends a segment, or extends the last one if it has the same value. */
+  void
+  push_back(const value_type & value)
+  {
+    if (m_Size > 0 && this->ValueAt(m_Size - 1) == value.second)
+    {
+      this->counts()[m_Size - 1] += value.first;
+      return;
+    }
+    if (m_Size == this->capacity())
+    {
+      this->Grow(m_Size + 1);
+    }
+    if (m_Size == 0)
+    {
+      this->SetFirstValue(value.second);
+    }
+    this->counts()[m_Size++] = value.first;
+  }
+
+  iterator
+  insert(const_iterator pos, const value_type & value)
+  {
+    return this->insert(pos, 1, value);
+  }
+
+  /** Inserts count segments of length value.first, with alternating values
+   * starting with value.second. See the class description for restrictions. */
+  iterator
+  insert(const_iterator pos, size_type count, const value_type & value)
+  {
+    const size_type offset = pos.m_Index;
+    if (offset == 0 && count > 0)
+    {
+      assert(m_Size == 0 || (value.second != ((count & 1) != 0)) == this->GetFirstValue());
+      this->SetFirstValue(value.second);
+    }
+    else
+    {
+      assert(count % 2 == 0 || offset == m_Size);
+      assert(count == 0 || this->ValueAt(offset - 1) != value.second);
+    }
+    this->MakeGap(offset, count);
+    std::fill_n(this->counts() + offset, count, value.first);
+    return iterator(this, offset);
+  }
+
+  iterator
+  erase(const_iterator pos)
+  {
+    return this->erase(pos, pos + 1);
+  }
+
+  /** See the class description for restrictions. */
+  iterator
+  erase(const_iterator first, const_iterator last)
+  {
+    const size_type f = first.m_Index;
+    const size_type l = last.m_Index;
+    assert((l - f) % 2 == 0 || f == 0 || l == m_Size);
+    if (f == 0 && l < m_Size)
+    {
+      this->SetFirstValue(this->ValueAt(l));
+    }
+    CounterType * counts = this->counts();
+    std::move(counts + l, counts + m_Size, counts + f);
+    m_Size -= static_cast<std::uint32_t>(l - f);
+    return iterator(this, f);
+  }
+
+  void
+  swap(BinaryRunLengthLine & other) noexcept
+  {
+    std::swap(m_Storage, other.m_Storage);
+    std::swap(m_Size, other.m_Size);
+    std::swap(m_Capacity, other.m_Capacity);
+  }
+
+  bool
+  operator==(const BinaryRunLengthLine & other) const
+  {
+    return m_Size == other.m_Size && (m_Size == 0 || this->GetFirstValue() == other.GetFirstValue()) &&
+           std::equal(this->counts(), this->counts() + m_Size, other.counts());
+  }
+
+  bool
+  operator!=(const BinaryRunLengthLine & other) const
+  {
+    return !(*this == other);
+  }
+
+  /** Find the segment which contains the pixel at the given position,
+   * relative to the start of the line. Sets remainder to the number of pixels
+   * from that position to the end of the segment (inclusive).
+   * Returns size() if the position is past the end of the line. */
+  template <typename TIndex>
+  size_type
+  FindSegment(TIndex position, TIndex & remainder) const
+  {
+    const CounterType * counts = this->counts();
+    TIndex              t = 0;
+    size_type           x = 0;
+    for (; x < m_Size; ++x)
+    {
+      t += counts[x];
+      if (t > position)
+      {
+        break;
+      }
+    }
+    remainder = t - position;
+    return x;
+  }
+
+  /** Contiguous storage for segments of many lines, see MoveToArena(). */
+  class Arena
+  {
+  public:
+    explicit Arena(size_type segmentCount)
+      : m_Counts(new CounterType[segmentCount])
+      , m_Size(segmentCount)
+    {}
+
+    size_type
+    GetNumberOfBytes() const
+    {
+      return m_Size * sizeof(CounterType);
+    }
+
+  private:
+    friend class BinaryRunLengthLine;
+    std::unique_ptr<CounterType[]> m_Counts;
+    size_type                      m_Size;
+  };
+
+  /** Number of arena slots MoveToArena() would take. */
+  size_type
+  GetNumberOfArenaSlots() const
+  {
+    return m_Size > InlineCapacity ? m_Size : 0;
+  }
+
+  /** Move the segments into the arena, starting at the given segment offset.
+   * The arena must outlive this line's use of it.
+   * Lines short enough to be stored inline are moved inline instead. */
+  void
+  MoveToArena(Arena & arena, size_type offset)
+  {
+    if (m_Size <= InlineCapacity)
+    {
+      this->Reallocate(m_Size);
+      return;
+    }
+    assert(offset + m_Size <= arena.m_Size);
+    CounterType * counts = arena.m_Counts.get() + offset;
+    std::copy_n(this->counts(), m_Size, counts);
+    const bool firstValue = this->GetFirstValue();
+    this->Release();
+    m_Storage.m_Heap = counts;
+    m_Capacity = m_Size | ExternalFlag;
+    this->SetFirstValue(firstValue);
+  }
+
+  /** Do the segments reside in storage owned by someone else? */
+  bool
+  IsExternal() const
+  {
+    return (m_Capacity & ExternalFlag) != 0;
+  }
+
+  /** Are the segments stored within the line object itself? */
+  bool
+  IsInline() const
+  {
+    return (m_Capacity & InlineFlag) != 0;
+  }
+
+  /** Number of bytes this line owns on the heap,
+   * not counting sizeof(BinaryRunLengthLine) and external storage. */
+  size_type
+  GetOwnedBytes() const
+  {
+    return this->IsExternal() || this->IsInline() ? 0 : this->capacity() * sizeof(CounterType);
+  }
+
+private:
+  static constexpr std::uint32_t ExternalFlag = std::uint32_t(1) << 31;
+  static constexpr std::uint32_t InlineFlag = std::uint32_t(1) << 30;
+  static constexpr std::uint32_t TrueFirstFlag = std::uint32_t(1) << 29;
+
+  /** Segment values are references into this table. */
+  static constexpr bool Values[2] = { false, true };
+
+  const bool &
+  ValueAt(size_type i) const
+  {
+    return Values[this->GetFirstValue() != ((i & 1) != 0)];
+  }
+
+  /** Move content into new storage with room for n segments.
+   * Inline storage is used if n segments fit into it. */
+  void
+  Reallocate(size_type n)
+  {
+    assert(n >= m_Size && n < TrueFirstFlag);
+    const bool firstValue = this->GetFirstValue();
+    if (n <= InlineCapacity)
+    {
+      if (!this->IsInline())
+      {
+        CounterType counts[InlineCapacity];
+        std::copy_n(this->counts(), m_Size, counts);
+        this->Release();
+        std::copy_n(counts, m_Size, m_Storage.m_Inline);
+        m_Capacity = InlineCapacity | InlineFlag;
+      }
+    }
+    else
+    {
+      CounterType * counts = new CounterType[n];
+      std::copy_n(this->counts(), m_Size, counts);
+      this->Release();
+      m_Storage.m_Heap = counts;
+      m_Capacity = static_cast<std::uint32_t>(n);
+    }
+    this->SetFirstValue(firstValue);
+  }
+
+  /** Geometric growth, same as std::vector. */
+  void
+  Grow(size_type required)
+  {
+    this->Reallocate(std::max(required, 2 * this->capacity()));
+  }
+
+  /** Shift segments starting at offset by count, growing if needed. */
+  void
+  MakeGap(size_type offset, size_type count)
+  {
+    if (m_Size + count > this->capacity())
+    {
+      this->Grow(m_Size + count);
+    }
+    CounterType * counts = this->counts();
+    std::move_backward(counts + offset, counts + m_Size, counts + m_Size + count);
+    m_Size += static_cast<std::uint32_t>(count);
+  }
+
+  /** Free owned heap storage. Leaves the line without storage,
+   * so one of the above methods must set it up again. */
+  void
+  Release()
+  {
+    if (!this->IsExternal() && !this->IsInline())
+    {
+      delete[] m_Storage.m_Heap;
+    }
+    m_Storage.m_Heap = nullptr;
+    m_Capacity = 0;
+  }
+
+  /** Heap or external storage, or run lengths stored inline. */
+  union Storage
+  {
+    CounterType * m_Heap;
+    CounterType   m_Inline[InlineCapacity];
+  };
+
+  Storage       m_Storage{ nullptr };
+  std::uint32_t m_Size{ 0 };
+  std::uint32_t m_Capacity{ InlineCapacity | InlineFlag }; // highest bits: storage kind, value of first segment
+};
+} // namespace itk
+
+#endif // itkBinaryRunLengthLine_h
@@ -0,0 +1,631 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkCumulativeRunLengthLine_h
+#define itkCumulativeRunLengthLine_h
+
+#include "itkSoARunLengthLine.h"
+
+namespace itk
+{
+/** \class CumulativeRunLengthLine
+ *
+ *  \brief A line of run-length encoded segments which stores
+ *  the end position of each segment instead of its length.
+ *
+ *  Locating the segment which contains a given position (FindSegment(),
+ *  used by RLEImage::GetPixel(), RLEImage::SetPixel() and iterator
+ *  positioning) is a binary search, O(log segments) instead of O(segments).
+ *  The price is paid by edits: changing the length of a segment shifts
+ *  the end positions of all the following segments. Since splitting and
+ *  merging segments moves them anyway, this only matters much for edits
+ *  which move a segment boundary.
+ *
+ *  The interface is the same as RunLengthLine's. Segment lengths are
+ *  exposed through proxies, which keep the end positions consistent:
+ *  \code
+ *  line[x].first--; // shortens segment x, shifts the following ones
+ *  \endcode
+ *  Selected through the last template parameter of RLEImage:
+ *  \code
+ *  using ImageType = itk::RLEImage<short, 3, unsigned short, itk::CumulativeRunLengthLine<short, unsigned short>>;
+ *  \endcode
+ *
+ *  \ingroup RLEImage
+ */
+template <typename TPixel, typename CounterType>
+class CumulativeRunLengthLine
+{
+  /** Counts hold end positions of segments. */
+  using StorageType = SoARunLengthLine<TPixel, CounterType>;
+
+public:
+  /** First element is count of repetitions,
+   * second element is the pixel value. */
+  using value_type = std::pair<CounterType, TPixel>;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using allocator_type = typename StorageType::allocator_type;
+  using Arena = typename StorageType::Arena;
+
+  /** Behaves like a reference to the length of a segment. */
+  class count_reference
+  {
+  public:
+    count_reference(CumulativeRunLengthLine & line, size_type index)
+      : m_Line(&line)
+      , m_Index(index)
+    {}
+
+    count_reference(const count_reference &) = default;
+
+    operator CounterType() const { return m_Line->CountAt(m_Index); }
+
+    count_reference &
+    operator=(CounterType count)
+    {
+      m_Line->Shift(m_Index, CounterType(count - m_Line->CountAt(m_Index)));
+      return *this;
+    }
+
+    count_reference &
+    operator=(const count_reference & other)
+    {
+      return *this = CounterType(other);
+    }
+
+    count_reference &
+    operator+=(CounterType delta)
+    {
+      m_Line->Shift(m_Index, delta);
+      return *this;
+    }
+
+    count_reference &
+    operator-=(CounterType delta)
+    {
+      m_Line->Shift(m_Index, CounterType(-delta));
+      return *this;
+    }
+
+    count_reference &
+    operator++()
+    {
+      return *this += 1;
+    }
+
+    count_reference &
+    operator--()
+    {
+      return *this -= 1;
+    }
+
+    CounterType
+    operator++(int)
+    {
+      CounterType old = *this;
+      ++*this;
+      return old;
+    }
+
+    CounterType
+    operator--(int)
+    {
+      CounterType old = *this;
+      --*this;
+      return old;
+    }
+
+  private:
+    CumulativeRunLengthLine * m_Line;
+    size_type                 m_Index;
+  };
+
+  /** Behaves like std::pair<CounterType, TPixel> &. */
+  class reference
+  {
+  public:
+    reference(CumulativeRunLengthLine & line, size_type index)
+      : first(line, index)
+      , second(line.m_Storage.values()[index])
+    {}
+
+    reference(const reference &) = default;
+
+    reference &
+    operator=(const reference & other)
+    {
+      return *this = value_type(other);
+    }
+
+    reference &
+    operator=(const value_type & segment)
+    {
+      first = segment.first;
+      second = segment.second;
+      return *this;
+    }
+
+    operator value_type() const { return value_type(first, second); }
+
+    count_reference first;
+    TPixel &        second;
+  };
+
+  /** Behaves like const std::pair<CounterType, TPixel> &. */
+  class const_reference
+  {
+  public:
+    const_reference(const CumulativeRunLengthLine & line, size_type index)
+      : first(line.CountAt(index))
+      , second(line.m_Storage.values()[index])
+    {}
+
+    const_reference(const reference & other)
+      : first(other.first)
+      , second(other.second)
+    {}
+
+    operator value_type() const { return value_type(first, second); }
+
+    const CounterType first;
+    const TPixel &    second;
+  };
+
+  /** Random access iterator, refers to a segment by its index. */
+  template <typename TReference, typename TLine>
+  class IteratorBase
+  {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename CumulativeRunLengthLine::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = TReference;
+    using pointer = void;
+
+    IteratorBase() = default;
+
+    IteratorBase(TLine * line, size_type index)
+      : m_Line(line)
+      , m_Index(index)
+    {}
+
+    /** Allows conversion of iterator to const_iterator. */
+    template <typename TOtherReference, typename TOtherLine>
+    IteratorBase(const IteratorBase<TOtherReference, TOtherLine> & other)
+      : m_Line(other.m_Line)
+      , m_Index(other.m_Index)
+    {}
+
+    reference
+    operator*() const
+    {
+      return reference(*m_Line, m_Index);
+    }
+
+    reference
+    operator[](difference_type n) const
+    {
+      return reference(*m_Line, m_Index + n);
+    }
+
+    IteratorBase &
+    operator++()
+    {
+      ++m_Index;
+      return *this;
+    }
+
+    IteratorBase
+    operator++(int)
+    {
+      IteratorBase old = *this;
+      ++m_Index;
+      return old;
+    }
+
+    IteratorBase &
+    operator--()
+    {
+      --m_Index;
+      return *this;
+    }
+
+    IteratorBase
+    operator--(int)
+    {
+      IteratorBase old = *this;
+      --m_Index;
+      return old;
+    }
+
+    IteratorBase &
+    operator+=(difference_type n)
+    {
+      m_Index += n;
+      return *this;
+    }
+
+    IteratorBase &
+    operator-=(difference_type n)
+    {
+      m_Index -= n;
+      return *this;
+    }
+
+    IteratorBase
+    operator+(difference_type n) const
+    {
+      return IteratorBase(m_Line, m_Index + n);
+    }
+
+    IteratorBase
+    operator-(difference_type n) const
+    {
+      return IteratorBase(m_Line, m_Index - n);
+    }
+
+    difference_type
+    operator-(const IteratorBase & other) const
+    {
+      return difference_type(m_Index) - difference_type(other.m_Index);
+    }
+
+    bool
+    operator==(const IteratorBase & other) const
+    {
+      return m_Index == other.m_Index;
+    }
+
+    bool
+    operator!=(const IteratorBase & other) const
+    {
+      return m_Index != other.m_Index;
+    }
+
+    bool
+    operator<(const IteratorBase & other) const
+    {
+      return m_Index < other.m_Index;
+    }
+
+    bool
+    operator>(const IteratorBase & other) const
+    {
+      return m_Index > other.m_Index;
+    }
+
+    bool
+    operator<=(const IteratorBase & other) const
+    {
+      return m_Index <= other.m_Index;
+    }
+
+    bool
+    operator>=(const IteratorBase & other) const
+    {
+      return m_Index >= other.m_Index;
+    }
+
+    TLine *   m_Line{ nullptr };
+    size_type m_Index{ 0 };
+  };
+
+  using iterator = IteratorBase<reference, CumulativeRunLengthLine>;
+  using const_iterator = IteratorBase<const_reference, const CumulativeRunLengthLine>;
+
+  /** End positions are stored in CounterType, so it limits the line length. */
+  static constexpr bool LimitsLineLength = true;
+
+  /** Consecutive segments can have the same value. */
+  static constexpr bool AlternatesValues = false;
+
+  /** Lines are always stored as segments. */
+  static constexpr bool StoresPixelRows = false;
+
+  CumulativeRunLengthLine() = default;
+
+  explicit CumulativeRunLengthLine(size_type count, const value_type & value = value_type())
+    : m_Storage(count, value)
+  {
+    this->AccumulateCounts(0, count);
+  }
+
+  size_type
+  size() const
+  {
+    return m_Storage.size();
+  }
+
+  bool
+  empty() const
+  {
+    return m_Storage.empty();
+  }
+
+  size_type
+  capacity() const
+  {
+    return m_Storage.capacity();
+  }
+
+  reference
+  operator[](size_type i)
+  {
+    assert(i < this->size());
+    return reference(*this, i);
+  }
+
+  const_reference
+  operator[](size_type i) const
+  {
+    assert(i < this->size());
+    return const_reference(*this, i);
+  }
+
+  reference
+  front()
+  {
+    return (*this)[0];
+  }
+
+  const_reference
+  front() const
+  {
+    return (*this)[0];
+  }
+
+  reference
+  back()
+  {
+    return (*this)[this->size() - 1];
+  }
+
+  const_reference
+  back() const
+  {
+    return (*this)[this->size() - 1];
+  }
+
+  /** Contiguous array of segment end positions (exclusive). */
+  const CounterType *
+  ends() const
+  {
+    return m_Storage.counts();
+  }
+
+  iterator
+  begin()
+  {
+    return iterator(this, 0);
+  }
+
+  const_iterator
+  begin() const
+  {
+    return const_iterator(this, 0);
+  }
+
+  iterator
+  end()
+  {
+    return iterator(this, this->size());
+  }
+
+  const_iterator
+  end() const
+  {
+    return const_iterator(this, this->size());
+  }
+
+  void
+  reserve(size_type n)
+  {
+    m_Storage.reserve(n);
+  }
+
+  /** Reduce capacity to size. External storage is left alone. */
+  void
+  shrink_to_fit()
+  {
+    m_Storage.shrink_to_fit();
+  }
+
+  void
+  clear()
+  {
+    m_Storage.clear();
+  }
+
+  void
+  resize(size_type n, const value_type & value = value_type())
+  {
+    size_type oldSize = this->size();
+    m_Storage.resize(n, value);
+    if (n > oldSize)
+    {
+      this->AccumulateCounts(oldSize, n);
+    }
+  }
+
+  void
+  push_back(const value_type & value)
+  {
+    CounterType end = CounterType(this->EndBefore(this->size()) + value.first);
+    m_Storage.push_back(value_type(end, value.second));
+  }
+
+  iterator
+  insert(const_iterator pos, const value_type & value)
+  {
+    return this->insert(pos, 1, value);
+  }
+
+  iterator
+  insert(const_iterator pos, size_type count, const value_type & value)
+  {
+    size_type offset = pos.m_Index;
+    m_Storage.insert(m_Storage.begin() + offset, count, value);
+    return this->AdjustInserted(offset, count);
+  }
+
+  template <typename TInputIterator>
+  iterator
+  insert(const_iterator pos, TInputIterator first, TInputIterator last)
+  {
+    size_type offset = pos.m_Index;
+    size_type count = size_type(std::distance(first, last));
+    m_Storage.insert(m_Storage.begin() + offset, first, last);
+    return this->AdjustInserted(offset, count);
+  }
+
+  iterator
+  erase(const_iterator pos)
+  {
+    return this->erase(pos, pos + 1);
+  }
+
+  iterator
+  erase(const_iterator first, const_iterator last)
+  {
+    size_type   f = first.m_Index;
+    size_type   l = last.m_Index;
+    CounterType removed = CounterType(this->EndBefore(l) - this->EndBefore(f));
+    m_Storage.erase(m_Storage.begin() + f, m_Storage.begin() + l);
+    this->Shift(f, CounterType(-removed));
+    return iterator(this, f);
+  }
+
+  void
+  swap(CumulativeRunLengthLine & other) noexcept
+  {
+    m_Storage.swap(other.m_Storage);
+  }
+
+  bool
+  operator==(const CumulativeRunLengthLine & other) const
+  {
+    return m_Storage == other.m_Storage;
+  }
+
+  bool
+  operator!=(const CumulativeRunLengthLine & other) const
+  {
+    return !(*this == other);
+  }
+
+  /** Find the segment which contains the pixel at the given position,
+   * relative to the start of the line. Sets remainder to the number of pixels
+   * from that position to the end of the segment (inclusive).
+   * Returns size() if the position is past the end of the line.
+   * Binary search over segment end positions. */
+  template <typename TIndex>
+  size_type
+  FindSegment(TIndex position, TIndex & remainder) const
+  {
+    const CounterType * ends = this->ends();
+    const CounterType * found = std::upper_bound(
+      ends, ends + this->size(), position, [](TIndex p, CounterType end) { return p < TIndex(end); });
+    size_type x = size_type(found - ends);
+    remainder = TIndex(x < this->size() ? ends[x] : this->EndBefore(x)) - position;
+    return x;
+  }
+
+  /** Number of arena slots MoveToArena() would take. */
+  size_type
+  GetNumberOfArenaSlots() const
+  {
+    return m_Storage.GetNumberOfArenaSlots();
+  }
+
+  /** Move the segments into the arena, starting at the given segment offset.
+   * The arena must outlive this line's use of it. */
+  void
+  MoveToArena(Arena & arena, size_type offset)
+  {
+    m_Storage.MoveToArena(arena, offset);
+  }
+
+  /** Do the segments reside in storage owned by someone else? */
+  bool
+  IsExternal() const
+  {
+    return m_Storage.IsExternal();
+  }
+
+  /** Number of bytes this line owns on the heap,
+   * not counting sizeof(CumulativeRunLengthLine) and external storage. */
+  size_type
+  GetOwnedBytes() const
+  {
+    return m_Storage.GetOwnedBytes();
+  }
+
+private:
+  /** End position of the segment preceding segment i. */
+  CounterType
+  EndBefore(size_type i) const
+  {
+    return i > 0 ? this->ends()[i - 1] : CounterType(0);
+  }
+
+  CounterType
+  CountAt(size_type i) const
+  {
+    return CounterType(this->ends()[i] - this->EndBefore(i));
+  }
+
+  /** Add delta (modulo CounterType range) to end positions of segments i and onward. */
+  void
+  Shift(size_type i, CounterType delta)
+  {
+    CounterType * ends = m_Storage.counts();
+    for (size_type n = this->size(); i < n; ++i)
+    {
+      ends[i] = CounterType(ends[i] + delta);
+    }
+  }
+
+  /** Turn lengths of segments [first, last) into end positions. */
+  CounterType
+  AccumulateCounts(size_type first, size_type last)
+  {
+    CounterType * ends = m_Storage.counts();
+    CounterType   end = this->EndBefore(first);
+    CounterType   total = 0;
+    for (size_type i = first; i < last; ++i)
+    {
+      total = CounterType(total + ends[i]);
+      ends[i] = CounterType(end + total);
+    }
+    return total;
+  }
+
+  /** Fix end positions after inserting count segments (holding lengths) at offset. */
+  iterator
+  AdjustInserted(size_type offset, size_type count)
+  {
+    CounterType inserted = this->AccumulateCounts(offset, offset + count);
+    this->Shift(offset + count, inserted);
+    return iterator(this, offset);
+  }
+
+  StorageType m_Storage;
+};
+} // namespace itk
+
+#endif // itkCumulativeRunLengthLine_h
@@ -0,0 +1,269 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkFrozenRunLengthLines_h
+#define itkFrozenRunLengthLines_h
+
+#include "itkMacro.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <utility> // std::pair
+#include <vector>
+
+namespace itk
+{
+/** \class FrozenRunLengthLines
+ *
+ *  \brief Read-only storage of all the run-length lines of an RLEImage,
+ *  see RLEImage::Freeze().
+ *
+ *  Run lengths are stored as variable-length integers (7 bits per byte,
+ *  so most take a single byte) in one byte stream. Segment values are
+ *  stored in one tightly packed array, so that GetPixel() can return
+ *  a reference to them. Identical lines share their encoding, which
+ *  makes the many uniform lines of a label image nearly free.
+ *
+ *  Lines are numbered in the order of the RLEImage buffer.
+ *
+ *  \ingroup RLEImage
+ */
+template <typename TPixel, typename CounterType>
+class FrozenRunLengthLines
+{
+public:
+  using value_type = std::pair<CounterType, TPixel>;
+  using size_type = std::size_t;
+
+  /** std::vector<bool> is not an array, so booleans are stored as bytes. */
+  using StoredValueType = std::conditional_t<std::is_same<TPixel, bool>::value, std::uint8_t, TPixel>;
+
+  /** Appends the segments of a line, merging adjacent segments with equal values.
+   * Reuses the encoding of an identical earlier line. */
+  template <typename TLine>
+  void
+  Append(const TLine & line)
+  {
+    static_assert(std::is_trivially_copyable<StoredValueType>::value,
+                  "Freezing requires a trivially copyable pixel type");
+
+    const size_type countStart = m_Counts.size();
+    const size_type valueStart = m_Values.size();
+    if (countStart > std::numeric_limits<std::uint32_t>::max() ||
+        valueStart > std::numeric_limits<std::uint32_t>::max())
+    {
+      throw ExceptionObject(__FILE__, __LINE__, "Too many segments to freeze!", __FUNCTION__);
+    }
+
+    // merge while collecting the values, then write their count and the run lengths
+    std::vector<std::uint64_t> & lengths = m_Lengths;
+    lengths.clear();
+    for (size_type x = 0; x < line.size(); x++)
+    {
+      const CounterType count = line[x].first;
+      const TPixel      value = line[x].second;
+      if (!lengths.empty() && m_Values.back() == value)
+      {
+        lengths.back() += count;
+        continue;
+      }
+      lengths.push_back(count);
+      m_Values.push_back(value);
+    }
+    this->WriteVarint(lengths.size());
+    for (std::uint64_t length : lengths)
+    {
+      this->WriteVarint(length);
+    }
+
+    std::vector<std::uint32_t> & candidates = m_Encodings[this->Hash(countStart, valueStart)];
+    for (std::uint32_t candidate : candidates)
+    {
+      const LineStart & start = m_Lines[candidate];
+      if (m_Counts.size() - countStart <= countStart - start.m_Count &&
+          std::equal(m_Counts.begin() + countStart, m_Counts.end(), m_Counts.begin() + start.m_Count) &&
+          std::equal(m_Values.begin() + valueStart, m_Values.end(), m_Values.begin() + start.m_Value))
+      {
+        m_Counts.resize(countStart);
+        m_Values.resize(valueStart);
+        m_Lines.push_back(start);
+        return;
+      }
+    }
+    candidates.push_back(static_cast<std::uint32_t>(m_Lines.size()));
+    m_Lines.push_back({ static_cast<std::uint32_t>(countStart), static_cast<std::uint32_t>(valueStart) });
+  }
+
+  /** Releases the memory needed only by Append(). */
+  void
+  FinishAppending()
+  {
+    m_Encodings = {};
+    m_Lengths = {};
+    m_Lines.shrink_to_fit();
+    m_Counts.shrink_to_fit();
+    m_Values.shrink_to_fit();
+  }
+
+  size_type
+  GetNumberOfLines() const
+  {
+    return m_Lines.size();
+  }
+
+  /** Replaces the segments of line by those of line number i.
+   * Runs longer than CounterType can count are split into several segments. */
+  template <typename TLine>
+  void
+  Decode(size_type i, TLine & line) const
+  {
+    constexpr std::uint64_t maxCount = std::numeric_limits<CounterType>::max();
+
+    const LineStart &    start = m_Lines[i];
+    const std::uint8_t * bytes = m_Counts.data() + start.m_Count;
+    const StoredValueType * values = m_Values.data() + start.m_Value;
+    const size_type         segmentCount = ReadVarint(bytes);
+    line.clear();
+    line.reserve(segmentCount);
+    for (size_type x = 0; x < segmentCount; x++)
+    {
+      std::uint64_t length = ReadVarint(bytes);
+      for (; length > maxCount; length -= maxCount)
+      {
+        line.push_back(value_type(static_cast<CounterType>(maxCount), TPixel(values[x])));
+      }
+      line.push_back(value_type(static_cast<CounterType>(length), TPixel(values[x])));
+    }
+  }
+
+  /** Value at the given position of line number i. */
+  const TPixel &
+  GetPixel(size_type i, size_type position) const
+  {
+    const LineStart &    start = m_Lines[i];
+    const std::uint8_t * bytes = m_Counts.data() + start.m_Count;
+    const size_type      segmentCount = ReadVarint(bytes);
+    size_type            end = 0;
+    for (size_type x = 0; x < segmentCount; x++)
+    {
+      end += ReadVarint(bytes);
+      if (position < end)
+      {
+        if constexpr (std::is_same<TPixel, bool>::value)
+        {
+          static constexpr bool booleans[2] = { false, true };
+          return booleans[m_Values[start.m_Value + x]];
+        }
+        else
+        {
+          return m_Values[start.m_Value + x];
+        }
+      }
+    }
+    throw ExceptionObject(__FILE__, __LINE__, "Reached past the end of Run-Length line!", __FUNCTION__);
+  }
+
+  /** Number of distinct line encodings. */
+  size_type
+  GetNumberOfDistinctLines() const
+  {
+    // encodings are appended in order, so a line with a new encoding starts past all earlier ones
+    size_type     count = 0;
+    std::uint32_t next = 0;
+    for (const LineStart & start : m_Lines)
+    {
+      if (start.m_Count >= next)
+      {
+        ++count;
+        next = start.m_Count + 1;
+      }
+    }
+    return count;
+  }
+
+  size_type
+  GetNumberOfBytes() const
+  {
+    return m_Lines.capacity() * sizeof(LineStart) + m_Counts.capacity() + m_Values.capacity() * sizeof(StoredValueType);
+  }
+
+private:
+  /** Where the encoding of a line starts. */
+  struct LineStart
+  {
+    std::uint32_t m_Count; // offset into m_Counts
+    std::uint32_t m_Value; // index into m_Values
+  };
+
+  void
+  WriteVarint(std::uint64_t v)
+  {
+    while (v >= 0x80)
+    {
+      m_Counts.push_back(static_cast<std::uint8_t>(v | 0x80));
+      v >>= 7;
+    }
+    m_Counts.push_back(static_cast<std::uint8_t>(v));
+  }
+
+  static std::uint64_t
+  ReadVarint(const std::uint8_t *& bytes)
+  {
+    std::uint64_t v = 0;
+    for (unsigned shift = 0;; shift += 7)
+    {
+      const std::uint8_t b = *bytes++;
+      v |= std::uint64_t(b & 0x7f) << shift;
+      if (b < 0x80)
+      {
+        return v;
+      }
+    }
+  }
+
+  /** FNV-1a hash of the encoding which starts at the given offsets. */
+  std::size_t
+  Hash(size_type countStart, size_type valueStart) const
+  {
+    std::uint64_t h = 14695981039346656037ull;
+    auto          add = [&h](const void * data, size_type n) {
+      const auto * bytes = static_cast<const unsigned char *>(data);
+      for (size_type b = 0; b < n; b++)
+      {
+        h = (h ^ bytes[b]) * 1099511628211ull;
+      }
+    };
+    add(m_Counts.data() + countStart, m_Counts.size() - countStart);
+    add(m_Values.data() + valueStart, (m_Values.size() - valueStart) * sizeof(StoredValueType));
+    return static_cast<std::size_t>(h);
+  }
+
+  std::vector<LineStart>       m_Lines;
+  std::vector<std::uint8_t>    m_Counts; // per line: segment count, then run lengths
+  std::vector<StoredValueType> m_Values;
+
+  // lines with the same hash, only needed while appending
+  std::unordered_map<std::size_t, std::vector<std::uint32_t>> m_Encodings;
+  std::vector<std::uint64_t>                                  m_Lengths; // scratch for Append()
+};
+} // namespace itk
+
+#endif // itkFrozenRunLengthLines_h
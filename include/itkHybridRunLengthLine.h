@@ -0,0 +1,961 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkHybridRunLengthLine_h
+#define itkHybridRunLengthLine_h
+
+#include "itkSoARunLengthLine.h"
+
+#include <limits>
+
+namespace itk
+{
+/** \class HybridRunLengthLine
+ *
+ *  \brief A line of run-length encoded segments which is stored
+ *  as a plain row of pixels when that is smaller.
+ *
+ *  Lines of noisy images have about as many segments as pixels, so their
+ *  segments take more memory than the dense row, and editing them shifts
+ *  many segments. A dense line presents each pixel as a segment of length 1:
+ *  FindSegment() is O(1) and RLEImage::SetPixel() writes the pixel in place.
+ *  A dense line keeps count of its runs, so it can tell when encoding
+ *  it again becomes worthwhile (see PrefersPixels() and PrefersRuns()).
+ *
+ *  RLEImage switches the representation of a line in SetPixel(), copies of
+ *  a line and shrink_to_fit() (hence RLEImage::Compact()) choose it too.
+ *  Other edits keep the representation. The counts of a dense line
+ *  must not be changed, its values can be.
+ *
+ *  Segments are stored as in SoARunLengthLine. Selected through the last
+ *  template parameter of RLEImage:
+ *  \code
+ *  using ImageType = itk::RLEImage<float, 3, unsigned short, itk::HybridRunLengthLine<float, unsigned short>>;
+ *  \endcode
+ *
+ *  \ingroup RLEImage
+ */
+template <typename TPixel, typename CounterType>
+class HybridRunLengthLine
+{
+public:
+  /** First element is count of repetitions,
+   * second element is the pixel value. */
+  using value_type = std::pair<CounterType, TPixel>;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using allocator_type = std::allocator<char>; // segments and pixels come from the global heap
+  using Arena = typename SoARunLengthLine<TPixel, CounterType>::Arena;
+
+  /** Behaves like a reference to the length of a segment,
+   * which must stay 1 in a dense line. */
+  class count_reference
+  {
+  public:
+    count_reference(HybridRunLengthLine & line, size_type index)
+      : m_Line(&line)
+      , m_Index(index)
+    {}
+
+    count_reference(const count_reference &) = default;
+
+    operator CounterType() const { return m_Line->CountAt(m_Index); }
+
+    count_reference &
+    operator=(CounterType count)
+    {
+      assert(!m_Line->IsDense());
+      m_Line->m_Counts[m_Index] = count;
+      return *this;
+    }
+
+    count_reference &
+    operator=(const count_reference & other)
+    {
+      return *this = CounterType(other);
+    }
+
+    count_reference &
+    operator+=(CounterType delta)
+    {
+      return *this = CounterType(*this + delta);
+    }
+
+    count_reference &
+    operator-=(CounterType delta)
+    {
+      return *this = CounterType(*this - delta);
+    }
+
+    count_reference &
+    operator++()
+    {
+      return *this += 1;
+    }
+
+    count_reference &
+    operator--()
+    {
+      return *this -= 1;
+    }
+
+    CounterType
+    operator++(int)
+    {
+      CounterType old = *this;
+      ++*this;
+      return old;
+    }
+
+    CounterType
+    operator--(int)
+    {
+      CounterType old = *this;
+      --*this;
+      return old;
+    }
+
+  private:
+    HybridRunLengthLine * m_Line;
+    size_type             m_Index;
+  };
+
+  /** Behaves like a reference to the value of a segment.
+   * Writing to a pixel of a dense line updates its run count. */
+  class value_reference
+  {
+  public:
+    value_reference(HybridRunLengthLine & line, size_type index)
+      : m_Line(&line)
+      , m_Index(index)
+    {}
+
+    value_reference(const value_reference &) = default;
+
+    operator const TPixel &() const { return m_Line->m_Values[m_Index]; }
+
+    value_reference &
+    operator=(const TPixel & value)
+    {
+      if (m_Line->IsDense())
+      {
+        m_Line->SetDenseValue(m_Index, value);
+      }
+      else
+      {
+        m_Line->m_Values[m_Index] = value;
+      }
+      return *this;
+    }
+
+    value_reference &
+    operator=(const value_reference & other)
+    {
+      return *this = TPixel(static_cast<const TPixel &>(other));
+    }
+
+    /** The conversion above is not considered for a member operator== of TPixel. */
+    friend bool
+    operator==(const value_reference & reference, const TPixel & value)
+    {
+      return static_cast<const TPixel &>(reference) == value;
+    }
+
+  private:
+    HybridRunLengthLine * m_Line;
+    size_type             m_Index;
+  };
+
+  /** Behaves like std::pair<CounterType, TPixel> &. */
+  class reference
+  {
+  public:
+    reference(HybridRunLengthLine & line, size_type index)
+      : first(line, index)
+      , second(line, index)
+    {}
+
+    reference(const reference &) = default;
+
+    reference &
+    operator=(const reference & other)
+    {
+      return *this = value_type(other);
+    }
+
+    reference &
+    operator=(const value_type & segment)
+    {
+      first = segment.first;
+      second = segment.second;
+      return *this;
+    }
+
+    operator value_type() const { return value_type(first, second); }
+
+    count_reference first;
+    value_reference second;
+  };
+
+  /** Behaves like const std::pair<CounterType, TPixel> &. */
+  class const_reference
+  {
+  public:
+    const_reference(const HybridRunLengthLine & line, size_type index)
+      : first(line.CountAt(index))
+      , second(line.m_Values[index])
+    {}
+
+    const_reference(const reference & other)
+      : first(other.first)
+      , second(other.second)
+    {}
+
+    operator value_type() const { return value_type(first, second); }
+
+    const CounterType first;
+    const TPixel &    second;
+  };
+
+  /** Random access iterator, refers to a segment by its index. */
+  template <typename TReference, typename TLine>
+  class IteratorBase
+  {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename HybridRunLengthLine::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = TReference;
+    using pointer = void;
+
+    IteratorBase() = default;
+
+    IteratorBase(TLine * line, size_type index)
+      : m_Line(line)
+      , m_Index(index)
+    {}
+
+    /** Allows conversion of iterator to const_iterator. */
+    template <typename TOtherReference, typename TOtherLine>
+    IteratorBase(const IteratorBase<TOtherReference, TOtherLine> & other)
+      : m_Line(other.m_Line)
+      , m_Index(other.m_Index)
+    {}
+
+    reference
+    operator*() const
+    {
+      return reference(*m_Line, m_Index);
+    }
+
+    reference
+    operator[](difference_type n) const
+    {
+      return reference(*m_Line, m_Index + n);
+    }
+
+    IteratorBase &
+    operator++()
+    {
+      ++m_Index;
+      return *this;
+    }
+
+    IteratorBase
+    operator++(int)
+    {
+      IteratorBase old = *this;
+      ++m_Index;
+      return old;
+    }
+
+    IteratorBase &
+    operator--()
+    {
+      --m_Index;
+      return *this;
+    }
+
+    IteratorBase
+    operator--(int)
+    {
+      IteratorBase old = *this;
+      --m_Index;
+      return old;
+    }
+
+    IteratorBase &
+    operator+=(difference_type n)
+    {
+      m_Index += n;
+      return *this;
+    }
+
+    IteratorBase &
+    operator-=(difference_type n)
+    {
+      m_Index -= n;
+      return *this;
+    }
+
+    IteratorBase
+    operator+(difference_type n) const
+    {
+      return IteratorBase(m_Line, m_Index + n);
+    }
+
+    IteratorBase
+    operator-(difference_type n) const
+    {
+      return IteratorBase(m_Line, m_Index - n);
+    }
+
+    difference_type
+    operator-(const IteratorBase & other) const
+    {
+      return difference_type(m_Index) - difference_type(other.m_Index);
+    }
+
+    bool
+    operator==(const IteratorBase & other) const
+    {
+      return m_Index == other.m_Index;
+    }
+
+    bool
+    operator!=(const IteratorBase & other) const
+    {
+      return m_Index != other.m_Index;
+    }
+
+    bool
+    operator<(const IteratorBase & other) const
+    {
+      return m_Index < other.m_Index;
+    }
+
+    bool
+    operator>(const IteratorBase & other) const
+    {
+      return m_Index > other.m_Index;
+    }
+
+    bool
+    operator<=(const IteratorBase & other) const
+    {
+      return m_Index <= other.m_Index;
+    }
+
+    bool
+    operator>=(const IteratorBase & other) const
+    {
+      return m_Index >= other.m_Index;
+    }
+
+    TLine *   m_Line{ nullptr };
+    size_type m_Index{ 0 };
+  };
+
+  using iterator = IteratorBase<reference, HybridRunLengthLine>;
+  using const_iterator = IteratorBase<const_reference, const HybridRunLengthLine>;
+
+  /** Segment lengths are limited by CounterType, not the line length. */
+  static constexpr bool LimitsLineLength = false;
+
+  /** Consecutive segments can have the same value. */
+  static constexpr bool AlternatesValues = false;
+
+  /** Noisy lines can be stored as rows of pixels. */
+  static constexpr bool StoresPixelRows = true;
+
+  /** Are segmentCount segments larger than a row of length pixels?
+   * Lines of runs with more segments are made dense. */
+  static bool
+  PrefersPixels(size_type segmentCount, size_type length)
+  {
+    return segmentCount * (sizeof(CounterType) + sizeof(TPixel)) > length * sizeof(TPixel);
+  }
+
+  /** Are runCount segments at most half the size of a row of length pixels?
+   * Dense lines with fewer runs are encoded again. The gap between
+   * the two thresholds keeps a line from switching back and forth. */
+  static bool
+  PrefersRuns(size_type runCount, size_type length)
+  {
+    return 2 * runCount * (sizeof(CounterType) + sizeof(TPixel)) <= length * sizeof(TPixel);
+  }
+
+  HybridRunLengthLine() = default;
+
+  explicit HybridRunLengthLine(size_type count, const value_type & value = value_type())
+  {
+    this->Reallocate(count);
+    std::fill_n(m_Counts, count, value.first);
+    std::fill_n(m_Values, count, value.second);
+    m_Size = static_cast<std::uint32_t>(count);
+  }
+
+  /** Copies always get their own, exactly sized, heap storage,
+   * in the representation which suits them. */
+  HybridRunLengthLine(const HybridRunLengthLine & other) { this->Assign(other); }
+
+  HybridRunLengthLine(HybridRunLengthLine && other) noexcept
+    : m_Counts(other.m_Counts)
+    , m_Values(other.m_Values)
+    , m_Size(other.m_Size)
+    , m_Capacity(other.m_Capacity)
+  {
+    other.m_Counts = nullptr;
+    other.m_Values = nullptr;
+    other.m_Size = 0;
+    other.m_Capacity = 0;
+  }
+
+  HybridRunLengthLine &
+  operator=(const HybridRunLengthLine & other)
+  {
+    if (this != &other)
+    {
+      this->Release();
+      m_Size = 0;
+      this->Assign(other);
+    }
+    return *this;
+  }
+
+  HybridRunLengthLine &
+  operator=(HybridRunLengthLine && other) noexcept
+  {
+    this->swap(other);
+    return *this;
+  }
+
+  ~HybridRunLengthLine() { this->Release(); }
+
+  /** Number of segments, or of pixels of a dense line. */
+  size_type
+  size() const
+  {
+    return m_Size;
+  }
+
+  bool
+  empty() const
+  {
+    return m_Size == 0;
+  }
+
+  size_type
+  capacity() const
+  {
+    return this->IsDense() ? m_Size : m_Capacity & ~ExternalFlag;
+  }
+
+  reference
+  operator[](size_type i)
+  {
+    assert(i < m_Size);
+    return reference(*this, i);
+  }
+
+  const_reference
+  operator[](size_type i) const
+  {
+    assert(i < m_Size);
+    return const_reference(*this, i);
+  }
+
+  reference
+  front()
+  {
+    return (*this)[0];
+  }
+
+  const_reference
+  front() const
+  {
+    return (*this)[0];
+  }
+
+  reference
+  back()
+  {
+    return (*this)[m_Size - 1];
+  }
+
+  const_reference
+  back() const
+  {
+    return (*this)[m_Size - 1];
+  }
+
+  iterator
+  begin()
+  {
+    return iterator(this, 0);
+  }
+
+  const_iterator
+  begin() const
+  {
+    return const_iterator(this, 0);
+  }
+
+  iterator
+  end()
+  {
+    return iterator(this, m_Size);
+  }
+
+  const_iterator
+  end() const
+  {
+    return const_iterator(this, m_Size);
+  }
+
+  /** Is the line stored as a row of pixels? */
+  bool
+  IsDense() const
+  {
+    return (m_Capacity & DenseFlag) != 0;
+  }
+
+  /** Number of runs of equal pixels of a dense line. */
+  size_type
+  GetNumberOfRuns() const
+  {
+    assert(this->IsDense());
+    return m_Capacity & ~DenseFlag;
+  }
+
+  /** Contiguous array of pixels of a dense line, or of segment values. */
+  const TPixel *
+  values() const
+  {
+    return m_Values;
+  }
+
+  /** Stores the line as a row of pixels. Does nothing to a dense line. */
+  void
+  MakeDense()
+  {
+    if (this->IsDense())
+    {
+      return;
+    }
+    size_type length = 0;
+    for (size_type x = 0; x < m_Size; ++x)
+    {
+      length += m_Counts[x];
+    }
+    assert(length < DenseFlag);
+    TPixel *  pixels = length > 0 ? new TPixel[length] : nullptr;
+    size_type runCount = 0;
+    for (size_type x = 0, p = 0; x < m_Size; p += m_Counts[x], ++x)
+    {
+      std::fill_n(pixels + p, m_Counts[x], m_Values[x]);
+      runCount += (m_Counts[x] > 0 && (p == 0 || !(pixels[p - 1] == m_Values[x])));
+    }
+    this->Release();
+    m_Values = pixels;
+    m_Size = static_cast<std::uint32_t>(length);
+    m_Capacity = static_cast<std::uint32_t>(runCount) | DenseFlag;
+  }
+
+  /** Encodes a dense line into runs of equal pixels, splitting runs
+   * longer than CounterType can count. Does nothing to a line of runs. */
+  void
+  MakeRuns()
+  {
+    if (!this->IsDense())
+    {
+      return;
+    }
+    constexpr size_type maxCount = std::numeric_limits<CounterType>::max();
+
+    HybridRunLengthLine runs;
+    runs.Reallocate(this->GetNumberOfRuns() + m_Size / maxCount);
+    for (size_type p = 0; p < m_Size;)
+    {
+      size_type end = p + 1;
+      while (end < m_Size && end - p < maxCount && m_Values[end] == m_Values[p])
+      {
+        ++end;
+      }
+      runs.push_back(value_type(static_cast<CounterType>(end - p), m_Values[p]));
+      p = end;
+    }
+    this->swap(runs);
+  }
+
+  void
+  reserve(size_type n)
+  {
+    if (!this->IsDense() && n > this->capacity())
+    {
+      this->Reallocate(n);
+    }
+  }
+
+  /** Reduce capacity to size, switching to the representation which suits
+   * the line (see PrefersPixels() and PrefersRuns()).
+   * External storage is left alone. */
+  void
+  shrink_to_fit()
+  {
+    if (this->IsDense())
+    {
+      if (PrefersRuns(this->GetNumberOfRuns(), m_Size))
+      {
+        this->MakeRuns();
+      }
+      return;
+    }
+    if (this->IsExternal())
+    {
+      return;
+    }
+    if (PrefersPixels(m_Size, this->GetLength()))
+    {
+      this->MakeDense();
+    }
+    else if (this->capacity() > m_Size)
+    {
+      this->Reallocate(m_Size);
+    }
+  }
+
+  /** Empties the line, which then holds runs. */
+  void
+  clear()
+  {
+    if (this->IsDense())
+    {
+      this->Release();
+    }
+    m_Size = 0;
+  }
+
+  void
+  push_back(const value_type & value)
+  {
+    assert(!this->IsDense());
+    value_type copy = value; // value might reside in this line
+    if (m_Size == this->capacity())
+    {
+      this->Grow(m_Size + 1);
+    }
+    m_Counts[m_Size] = copy.first;
+    m_Values[m_Size] = copy.second;
+    ++m_Size;
+  }
+
+  iterator
+  insert(const_iterator pos, const value_type & value)
+  {
+    return this->insert(pos, 1, value);
+  }
+
+  iterator
+  insert(const_iterator pos, size_type count, const value_type & value)
+  {
+    value_type      copy = value; // value might reside in this line
+    difference_type offset = this->MakeGap(pos, count);
+    std::fill_n(m_Counts + offset, count, copy.first);
+    std::fill_n(m_Values + offset, count, copy.second);
+    return this->begin() + offset;
+  }
+
+  template <typename TInputIterator>
+  iterator
+  insert(const_iterator pos, TInputIterator first, TInputIterator last)
+  {
+    difference_type offset = this->MakeGap(pos, size_type(std::distance(first, last)));
+    for (difference_type i = offset; first != last; ++first, ++i)
+    {
+      typename std::iterator_traits<TInputIterator>::value_type segment = *first;
+      m_Counts[i] = segment.first;
+      m_Values[i] = segment.second;
+    }
+    return this->begin() + offset;
+  }
+
+  iterator
+  erase(const_iterator pos)
+  {
+    return this->erase(pos, pos + 1);
+  }
+
+  iterator
+  erase(const_iterator first, const_iterator last)
+  {
+    assert(!this->IsDense());
+    std::move(m_Counts + last.m_Index, m_Counts + m_Size, m_Counts + first.m_Index);
+    std::move(m_Values + last.m_Index, m_Values + m_Size, m_Values + first.m_Index);
+    m_Size -= static_cast<std::uint32_t>(last.m_Index - first.m_Index);
+    return this->begin() + first.m_Index;
+  }
+
+  void
+  swap(HybridRunLengthLine & other) noexcept
+  {
+    std::swap(m_Counts, other.m_Counts);
+    std::swap(m_Values, other.m_Values);
+    std::swap(m_Size, other.m_Size);
+    std::swap(m_Capacity, other.m_Capacity);
+  }
+
+  /** Lines are equal if their segments are, a dense line
+   * is only equal to another dense line with the same pixels. */
+  bool
+  operator==(const HybridRunLengthLine & other) const
+  {
+    if (this->IsDense() != other.IsDense() || m_Size != other.m_Size)
+    {
+      return false;
+    }
+    return (this->IsDense() || std::equal(m_Counts, m_Counts + m_Size, other.m_Counts)) &&
+           std::equal(m_Values, m_Values + m_Size, other.m_Values);
+  }
+
+  bool
+  operator!=(const HybridRunLengthLine & other) const
+  {
+    return !(*this == other);
+  }
+
+  /** Find the segment which contains the pixel at the given position,
+   * relative to the start of the line. Sets remainder to the number of pixels
+   * from that position to the end of the segment (inclusive).
+   * Returns size() if the position is past the end of the line.
+   * The segment of a pixel of a dense line is found in constant time. */
+  template <typename TIndex>
+  size_type
+  FindSegment(TIndex position, TIndex & remainder) const
+  {
+    if (this->IsDense())
+    {
+      remainder = 1;
+      return std::min(size_type(position), size_type(m_Size));
+    }
+    TIndex    t = 0;
+    size_type x = 0;
+    for (; x < m_Size; ++x)
+    {
+      t += m_Counts[x];
+      if (t > position)
+      {
+        break;
+      }
+    }
+    remainder = t - position;
+    return x;
+  }
+
+  /** Number of arena slots MoveToArena() would take.
+   * Dense lines keep their own storage. */
+  size_type
+  GetNumberOfArenaSlots() const
+  {
+    return this->IsDense() ? 0 : m_Size;
+  }
+
+  /** Move the segments into the arena, starting at the given segment offset.
+   * The arena must outlive this line's use of it.
+   * Previously owned heap storage is released. Does nothing to a dense line. */
+  void
+  MoveToArena(Arena & arena, size_type offset)
+  {
+    if (this->IsDense())
+    {
+      return;
+    }
+    SoARunLengthLine<TPixel, CounterType> segments(m_Size);
+    std::copy_n(m_Counts, m_Size, segments.counts());
+    std::move(m_Values, m_Values + m_Size, segments.values());
+    segments.MoveToArena(arena, offset);
+    this->Release();
+    m_Counts = segments.counts();
+    m_Values = segments.values();
+    m_Capacity = m_Size | ExternalFlag;
+  }
+
+  /** Do the segments reside in storage owned by someone else? */
+  bool
+  IsExternal() const
+  {
+    return (m_Capacity & ExternalFlag) != 0;
+  }
+
+  /** Number of bytes this line owns on the heap,
+   * not counting sizeof(HybridRunLengthLine) and external storage. */
+  size_type
+  GetOwnedBytes() const
+  {
+    if (this->IsDense())
+    {
+      return m_Size * sizeof(TPixel);
+    }
+    return this->IsExternal() ? 0 : this->capacity() * (sizeof(CounterType) + sizeof(TPixel));
+  }
+
+private:
+  static constexpr std::uint32_t ExternalFlag = std::uint32_t(1) << 31;
+  static constexpr std::uint32_t DenseFlag = std::uint32_t(1) << 30;
+
+  CounterType
+  CountAt(size_type i) const
+  {
+    return this->IsDense() ? CounterType(1) : m_Counts[i];
+  }
+
+  /** Number of pixels in the line. */
+  size_type
+  GetLength() const
+  {
+    if (this->IsDense())
+    {
+      return m_Size;
+    }
+    size_type length = 0;
+    for (size_type x = 0; x < m_Size; ++x)
+    {
+      length += m_Counts[x];
+    }
+    return length;
+  }
+
+  /** Writes a pixel of a dense line, keeping its run count. */
+  void
+  SetDenseValue(size_type i, const TPixel & value)
+  {
+    const TPixel old = m_Values[i];
+    if (old == value)
+    {
+      return;
+    }
+    // boundaries of runs with both neighbors, before and after the write
+    std::int64_t runCount = this->GetNumberOfRuns();
+    if (i > 0)
+    {
+      runCount += std::int64_t(!(m_Values[i - 1] == value)) - std::int64_t(!(m_Values[i - 1] == old));
+    }
+    if (i + 1 < m_Size)
+    {
+      runCount += std::int64_t(!(m_Values[i + 1] == value)) - std::int64_t(!(m_Values[i + 1] == old));
+    }
+    m_Values[i] = value;
+    m_Capacity = static_cast<std::uint32_t>(runCount) | DenseFlag;
+  }
+
+  /** Copies the content of other, choosing the representation
+   * with PrefersPixels() and PrefersRuns(). The line must hold nothing. */
+  void
+  Assign(const HybridRunLengthLine & other)
+  {
+    assert(m_Size == 0 && !this->IsDense());
+    const size_type length = other.GetLength();
+    const bool      dense =
+      other.IsDense() ? !PrefersRuns(other.GetNumberOfRuns(), length) : PrefersPixels(other.m_Size, length);
+
+    HybridRunLengthLine copy;
+    if (other.IsDense())
+    {
+      copy.m_Values = new TPixel[length];
+      std::copy_n(other.m_Values, length, copy.m_Values);
+      copy.m_Size = other.m_Size;
+      copy.m_Capacity = other.m_Capacity;
+    }
+    else
+    {
+      copy.Reallocate(other.m_Size);
+      std::copy_n(other.m_Counts, other.m_Size, copy.m_Counts);
+      std::copy_n(other.m_Values, other.m_Size, copy.m_Values);
+      copy.m_Size = other.m_Size;
+    }
+    if (dense)
+    {
+      copy.MakeDense();
+    }
+    else
+    {
+      copy.MakeRuns();
+    }
+    this->swap(copy);
+  }
+
+  /** Move content into new heap storage with room for n segments. */
+  void
+  Reallocate(size_type n)
+  {
+    assert(!this->IsDense() && n >= m_Size && n < DenseFlag);
+    CounterType * counts = n > 0 ? new CounterType[n] : nullptr;
+    TPixel *      values = n > 0 ? new TPixel[n] : nullptr;
+    std::copy_n(m_Counts, m_Size, counts);
+    std::move(m_Values, m_Values + m_Size, values);
+    this->Release();
+    m_Counts = counts;
+    m_Values = values;
+    m_Capacity = static_cast<std::uint32_t>(n);
+  }
+
+  /** Geometric growth, same as std::vector. */
+  void
+  Grow(size_type required)
+  {
+    this->Reallocate(std::max(required, 2 * this->capacity()));
+  }
+
+  /** Shift segments starting at pos by count, growing if needed.
+   * Returns the offset of pos. */
+  difference_type
+  MakeGap(const_iterator pos, size_type count)
+  {
+    assert(!this->IsDense());
+    difference_type offset = pos.m_Index;
+    if (m_Size + count > this->capacity())
+    {
+      this->Grow(m_Size + count);
+    }
+    std::move_backward(m_Counts + offset, m_Counts + m_Size, m_Counts + m_Size + count);
+    std::move_backward(m_Values + offset, m_Values + m_Size, m_Values + m_Size + count);
+    m_Size += static_cast<std::uint32_t>(count);
+    return offset;
+  }
+
+  void
+  Release()
+  {
+    if (!this->IsExternal())
+    {
+      delete[] m_Counts;
+      delete[] m_Values;
+    }
+    m_Counts = nullptr;
+    m_Values = nullptr;
+    m_Capacity = 0;
+  }
+
+  CounterType * m_Counts{ nullptr }; // nullptr in a dense line
+  TPixel *      m_Values{ nullptr }; // segment values, or pixels of a dense line
+  std::uint32_t m_Size{ 0 };         // number of segments, or of pixels of a dense line
+  std::uint32_t m_Capacity{ 0 };     // highest bit signals external storage, next one a dense line,
+                                     // whose run count takes the remaining bits
+};
+} // namespace itk
+
+#endif // itkHybridRunLengthLine_h
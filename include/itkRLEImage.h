@@ -18,8 +18,26 @@
 #ifndef itkRLEImage_h
 #define itkRLEImage_h
 
+#include "itkBinaryRunLengthLine.h"
+#include "itkCumulativeRunLengthLine.h"
+#include "itkFrozenRunLengthLines.h"
+#include "itkHybridRunLengthLine.h"
+#include "itkRunLengthLine.h"
+#include "itkSoARunLengthLine.h"
 #include <itkImage.h>
 #include <itkImageBase.h>
+#include <algorithm> // std::min
+#include <atomic>
+#include <cstring> // std::memcmp
+#include <limits>
+#include <map>
+#include <memory>
+#if __has_include(<memory_resource>)
+#  include <memory_resource>
+#endif
+#include <mutex>
+#include <optional>
+#include <type_traits>
 #include <utility> // std::pair
 #include <vector>
 
@@ -29,26 +47,141 @@ namespace itk
  *
  *  \brief Run-Length Encoded image.
  *  It saves memory for label images at the expense of processing times.
- *  Unsuitable for ordinary images (in which case it is counterproductive).
+ *  Unsuitable for ordinary images (in which case it is counterproductive),
+ *  unless lines are stored as HybridRunLengthLine (see HybridRLEImage).
  *
  *  \par Details
- *  BufferedRegion must include complete run-length lines (along X index axis).
+ *  BufferedRegion must include complete run-length lines (along the run axis).
  *  BufferedRegion can be smaller than LargestPossibleRegion along other axes.
  *
+ *  \par Run axis
+ *  Runs follow index axis 0 (X) by default. SetRunAxis() encodes along
+ *  another axis instead, which gives fewer segments when labels change less
+ *  often along it, e.g. along Z for images made of thick axial slabs.
+ *  Iterators visit pixels in the usual order whatever the run axis,
+ *  but walk along runs (which is fastest) only for a run axis of 0.
+ *
+ *  Threads must not write to the same line at once. The default region
+ *  splitter of ITK filters splits along the last axis, which is the run
+ *  axis of an image encoded along Z: a multi-threaded filter writing such
+ *  an output must split along another axis, e.g. with
+ *  ParallelizeImageRegionRestrictDirection() or ImageRegionSplitterDirection
+ *  as RegionOfInterestImageFilter does.
+ *
  *  It is best if pixel type and counter type have the same byte size
  *  (for memory alignment purposes).
  *
+ *  \par Long runs
+ *  A segment holds at most numeric_limits<CounterType>::max() pixels.
+ *  Longer runs are stored as consecutive segments with the same value,
+ *  so a narrow counter such as unsigned char works for lines of any length
+ *  (halving the segment size of uint8 label images). CumulativeRunLengthLine
+ *  stores positions in CounterType, so it still limits the line length.
+ *
  *  \par OnTheFlyCleanup
  *  Should same-valued segments be merged on the fly?
  *  On the fly merging usually provides better performance. Default: On.
  *
+ *  \par Segment storage
+ *  Each line keeps its segments in its own heap block by default.
+ *  Lines with at most RunLengthLine::InlineCapacity segments, such as
+ *  the uniform lines created by Allocate(true) and FillBuffer(), need no heap
+ *  block at all.
+ *  Consolidate() moves the segments of all lines into one contiguous
+ *  arena, reducing the allocation count to O(1) and improving locality.
+ *  The heap blocks of RunLengthLine come from its allocator, so the lines of
+ *  a PmrRLEImage can be drawn from a std::pmr::memory_resource chosen per
+ *  image (see SetLineAllocator()). GetNumberOfBytes() tells the memory
+ *  taken by an image.
+ *
+ *  The layout of segments within a line is chosen by the TLine template
+ *  parameter: RunLengthLine (default) keeps (count, value) pairs together,
+ *  SoARunLengthLine keeps counts and values in separate arrays, which
+ *  speeds up random access (GetPixel, iterator positioning).
+ *  CumulativeRunLengthLine stores segment end positions, making random
+ *  access a binary search at the expense of slower boundary edits.
+ *  HybridRunLengthLine stores a line as a row of pixels when its segments
+ *  would take more memory, which bounds the memory use at about that of
+ *  a dense image and makes editing noisy lines cheap.
+ *  See rleBenchmark for a comparison on a given image.
+ *
+ *  \par Palette encoding
+ *  If TLine stores unsigned integers other than TPixel, e.g.
+ *  RunLengthLine<unsigned char, CounterType>, segments hold indices into
+ *  a per-image palette of pixel values (see PaletteRLEImage).
+ *  This keeps segments small for wide label types and colour maps, and makes
+ *  ReplaceValue() independent of the image size. See PixelLess.
+ *  New values are added to the palette as they are written. Adding them
+ *  is serialized, and the palette storage is reserved up front so that
+ *  other threads can keep reading pixels meanwhile.
+ *
+ *  \par Multi-component pixels
+ *  Fixed length vectors like RGBPixel or Vector are stored in segments
+ *  as they are, and compared with memcmp when they consist of integers
+ *  (see IsSamePixel()). SoARunLengthLine keeps them apart from the counts,
+ *  without padding in between. Variable length pixels (VariableLengthVector)
+ *  work too, but each segment value owns its components and they cannot be
+ *  frozen. Their default value has no components, so fill such images with
+ *  a zero vector after Allocate(); SetNumberOfComponentsPerPixel() is kept
+ *  for GetNumberOfComponentsPerPixel().
+ *
+ *  \par Binary masks
+ *  BinaryRunLengthLine stores only alternating run lengths and the value
+ *  of the first run, half the size of (count, bool) segments.
+ *  See BinaryMaskRLEImage. Its segments are always merged,
+ *  whatever OnTheFlyCleanup says.
+ *
+ *  \par Frozen images
+ *  Images which are only read can be frozen, see Freeze(). A frozen image
+ *  keeps its lines in a compact read-only encoding, typically less than
+ *  half the size. GetPixel() and iterators read it directly,
+ *  the first write converts the image back (Thaw()).
+ *
+ *  \par Sparse lines
+ *  An absent line is an empty buffer entry, whose pixels are all background
+ *  (the default pixel value). Allocate() leaves all lines absent, and a line
+ *  is only materialized by the first write of another value (or, with
+ *  SparseLines off, by the non-const GetBuffer()). Iterators and
+ *  RegionOfInterestImageFilter read absent lines as one shared background
+ *  line. With SetSparseLines(true), lines which become all background are
+ *  made absent again, so the memory of mostly-background volumes scales
+ *  with their segmented content rather than with their size.
+ *
+ *  \par Slab summary
+ *  With SetSlabSummary(true), the image keeps track of which slabs
+ *  (slices along GetSlabAxis()) are uniform. FillBuffer() makes all slabs
+ *  uniform, and writing another value into a uniform slab marks it mixed.
+ *  Mixed slabs are not rechecked until UpdateSlabSummary(), so the summary
+ *  is conservative. Region iterators (see SkipUniformSlab()) and
+ *  RegionOfInterestImageFilter skip uniform slabs without reading their lines.
+ *
+ *  \par Comparison
+ *  IsSameContent() and GetDifferingLines() compare two images line by line,
+ *  run by run, so segmentation and palettes do not matter. Per-line hashes
+ *  computed along the way are kept until the line is written to, so lines
+ *  which changed since are told apart by their hashes alone.
+ *
+ *  \par Write combining
+ *  Generic filters write their outputs pixel by pixel, splitting and merging
+ *  segments for every pixel. With SetWriteCombining(true), the writable
+ *  iterators gather consecutive writes to a line and splice them in at once.
+ *
+ *  \par Edit sessions
+ *  Edits which revisit the same lines, such as a large brush, are fastest
+ *  on rows of pixels. BeginEdit() decodes the lines which cross a region into
+ *  rows, which pixel writes go to until EndEdit() encodes the rows which were
+ *  written back into lines. Memory is taken by the rows only during a session.
+ *
  *  Acknowledgement:
  *  This work is supported by NIH grant R01 EB014346, "Continued development
  *  and maintenance of the ITK-SNAP 3D image segmentation software."
  *
  *  \ingroup RLEImage
  */
-template <typename TPixel, unsigned int VImageDimension = 3, typename CounterType = unsigned short>
+template <typename TPixel,
+          unsigned int VImageDimension = 3,
+          typename CounterType = unsigned short,
+          typename TLine = RunLengthLine<TPixel, CounterType>>
 class RLEImage : public itk::ImageBase<VImageDimension>
 {
 public:
@@ -76,12 +209,89 @@ public:
   /** Typedef alias for PixelType */
   using ValueType = TPixel;
 
+  /** A Run-Length encoded line of pixels. */
+  using RLLine = TLine;
+
+  /** Allocator which lines draw their storage from, see RunLengthLine. */
+  using LineAllocatorType = typename RLLine::allocator_type;
+
+  /** Value stored in segments: the pixel value, or its index into the palette. */
+  using RLValueType = typename RLLine::value_type::second_type;
+
+  /** Do segments store palette indices instead of pixel values? */
+  static constexpr bool IsPaletteEncoded = !std::is_same<RLValueType, TPixel>::value;
+
+  /** Most values the palette can hold: one per index, up to 65536. */
+  static constexpr itk::SizeValueType PaletteCapacity =
+    IsPaletteEncoded
+      ? std::min<itk::SizeValueType>(
+          itk::SizeValueType(std::numeric_limits<std::conditional_t<IsPaletteEncoded, RLValueType, bool>>::max()) + 1,
+          itk::SizeValueType(1) << 16)
+      : 0;
+
   /** First element is count of repetitions,
-   * second element is the pixel value. */
-  using RLSegment = std::pair<CounterType, PixelType>;
+   * second element is the pixel value (or its palette index). */
+  using RLSegment = std::pair<CounterType, RLValueType>;
 
-  /** A Run-Length encoded line of pixels. */
-  using RLLine = std::vector<RLSegment>;
+  static_assert(std::is_same<typename RLLine::value_type, RLSegment>::value,
+                "TLine must be a line of std::pair<CounterType, TPixel> segments");
+  static_assert(!IsPaletteEncoded || (std::is_unsigned<RLValueType>::value && sizeof(RLValueType) <= 2),
+                "Palette indices must be bool, unsigned char or unsigned short");
+
+  /** Can pixels be compared as raw bytes? True for scalars and for fixed
+   * length vectors of integers, like RGBPixel<unsigned char>. */
+  static constexpr bool HasBytewisePixels =
+    std::is_trivially_copyable<TPixel>::value && std::has_unique_object_representations<TPixel>::value;
+
+  /** Are a and b the same pixel value? Compares multi-component pixels
+   * with a single memcmp where possible, rather than component by component. */
+  static bool
+  IsSamePixel(const TPixel & a, const TPixel & b)
+  {
+    if constexpr (HasBytewisePixels && !std::is_scalar<TPixel>::value)
+    {
+      return std::memcmp(&a, &b, sizeof(TPixel)) == 0;
+    }
+    else
+    {
+      return a == b;
+    }
+  }
+
+  /** Orders pixel values, for the palette. Pixels without operator<,
+   * like Vector or VariableLengthVector, are ordered by their components. */
+  struct PixelLess
+  {
+    bool
+    operator()(const TPixel & a, const TPixel & b) const
+    {
+      if constexpr (std::is_scalar<TPixel>::value)
+      {
+        return a < b;
+      }
+      else if constexpr (HasBytewisePixels)
+      {
+        return std::memcmp(&a, &b, sizeof(TPixel)) < 0;
+      }
+      else
+      {
+        const unsigned int aLength = itk::NumericTraits<TPixel>::GetLength(a);
+        const unsigned int bLength = itk::NumericTraits<TPixel>::GetLength(b);
+        for (unsigned int c = 0; c < aLength && c < bLength; c++)
+        {
+          if (a[c] < b[c])
+          {
+            return true;
+          }
+          if (b[c] < a[c])
+          {
+            return false;
+          }
+        }
+        return aLength < bLength;
+      }
+    }
+  };
 
   /** Internal Pixel representation. Used to maintain a uniform API
    * with Image Adaptors and allow to keep a particular internal
@@ -101,6 +311,35 @@ public:
   using IndexType = typename Superclass::IndexType;
   using IndexValueType = typename Superclass::IndexValueType;
 
+  /** A pixel index with the value to write there, see SetPixels(). */
+  using PixelEdit = std::pair<IndexType, TPixel>;
+
+  /** A dense image of one dimension less, such as a 2D slice of a 3D image, see SetSlice(). */
+  using SliceImageType = itk::Image<TPixel, VImageDimension - 1>;
+
+  /** A line decoded into a row of stored values, see BeginEdit(). */
+  struct EditRow
+  {
+    std::vector<RLValueType> m_Values;
+    bool                     m_Dirty{ false }; // written since BeginEdit()
+
+    /** Stored value at position i. std::vector<bool> has no elements
+     * to refer to, so booleans are returned from a table. */
+    const RLValueType &
+    GetValue(std::size_t i) const
+    {
+      if constexpr (std::is_same<RLValueType, bool>::value)
+      {
+        static constexpr bool booleans[2] = { false, true };
+        return booleans[m_Values[i]];
+      }
+      else
+      {
+        return m_Values[i];
+      }
+    }
+  };
+
   /** Offset type alias support. An offset is used to access pixel values. */
   using OffsetType = typename Superclass::OffsetType;
 
@@ -129,7 +368,13 @@ public:
 
   /** Allocate the image memory. The size of the image must
    * already be set, e.g. by calling SetRegions().
-   * Pixel values are initialized using default constructor. */
+   * All lines are left absent (see SetSparseLines()): they read as
+   * the default pixel value, but take no storage until written to.
+   * This suits outputs which are overwritten line by line.
+   * If initialize is true and SparseLines is off, every line is set to
+   * a uniform line of the default pixel value instead. Otherwise, unless
+   * SparseLines is on, the non-const GetBuffer() does that, so code
+   * which writes lines through the buffer never sees an absent line. */
   void
   Allocate(bool initialize = false) override;
 
@@ -142,6 +387,14 @@ public:
     Superclass::Initialize();
     m_OnTheFlyCleanup = true;
     m_Buffer = BufferType::New();
+    m_SegmentArenas.clear();
+    m_FrozenLines.reset();
+    m_AbsentLine = RLLine();
+    m_Slabs.clear();
+    m_LineHashes.clear();
+    m_EditRows.clear();
+    m_EditGeneration++;
+    this->ResetPalette();
   }
 
   /** Fill the image buffer with a value.  Be sure to call Allocate()
@@ -153,14 +406,14 @@ public:
   SetLargestPossibleRegion(const RegionType & region) override
   {
     Superclass::SetLargestPossibleRegion(region);
-    m_Buffer->SetLargestPossibleRegion(region.Slice(0));
+    m_Buffer->SetLargestPossibleRegion(region.Slice(m_RunAxis));
   }
 
   void
   SetBufferedRegion(const RegionType & region) override
   {
     Superclass::SetBufferedRegion(region);
-    m_Buffer->SetBufferedRegion(region.Slice(0));
+    m_Buffer->SetBufferedRegion(region.Slice(m_RunAxis));
   }
 
   using ImageBase<VImageDimension>::SetRequestedRegion;
@@ -169,9 +422,21 @@ public:
   SetRequestedRegion(const RegionType & region) override
   {
     Superclass::SetRequestedRegion(region);
-    m_Buffer->SetRequestedRegion(region.Slice(0));
+    m_Buffer->SetRequestedRegion(region.Slice(m_RunAxis));
   }
 
+  /** Index axis along which pixels are run-length encoded, 0 by default. */
+  unsigned int
+  GetRunAxis() const
+  {
+    return m_RunAxis;
+  }
+
+  /** Sets the index axis along which pixels are run-length encoded.
+   * Changing it releases the pixel data, so call Allocate() afterwards. */
+  void
+  SetRunAxis(unsigned int axis);
+
   /** \brief Set a pixel value.
    *
    * Allocate() needs to have been called first -- for efficiency,
@@ -182,11 +447,67 @@ public:
 
   /** Set a pixel value in the given line and updates segmentRemainder
    * and m_RealIndex to refer to the same pixel.
-   * Returns difference in line length which happens due to merging or splitting segments.
+   * Returns difference in line length which happens due to merging or splitting segments,
+   * or to switching the line between segments and a row of pixels (HybridRunLengthLine).
    * This method is used by iterators directly. */
   int
   SetPixel(RLLine & line, IndexValueType & segmentRemainder, SizeValueType & m_RealIndex, const TPixel & value);
 
+  /** \brief Set length consecutive pixels along the run axis, starting at index.
+   *
+   * The pixels must lie within a single line. The line is rewritten in one
+   * pass over its segments, however many pixels the run covers.
+   * With SparseLines on, a line which becomes all background is made absent. */
+  void
+  SetRun(const IndexType & index, SizeValueType length, const TPixel & value);
+
+  /** Set length pixels of the given line to value, starting at position start
+   * within the line. Segments of the same value next to the run are merged
+   * into it if OnTheFlyCleanup is on. This method is used by iterators directly. */
+  void
+  SetRun(RLLine & line, IndexValueType start, SizeValueType length, const TPixel & value);
+
+  /** \brief Replace consecutive pixels along the run axis, starting at index,
+   * by the segments of runs, which hold stored values (see EncodeValue()).
+   *
+   * The pixels must lie within a single line. This is how the iterators
+   * write the pixels they gathered with WriteCombining on.
+   * With SparseLines on, a line which becomes all background is made absent. */
+  void
+  SetRuns(const IndexType & index, const RLLine & runs);
+
+  /** Replace the pixels of the given line, starting at position start within
+   * the line, by the segments of runs. The line is rebuilt in one pass over
+   * its segments, merging segments of the same value. */
+  void
+  SetRuns(RLLine & line, IndexValueType start, const RLLine & runs);
+
+  /** \brief Set the pixels of a batch of edits, in any order.
+   *
+   * The edits are sorted by line and position within the line, and each
+   * line is rewritten once, in a single pass over its segments and edits,
+   * rather than searched from its start for every pixel. Lines are edited
+   * in parallel unless inParallel is false. If several edits set the same
+   * pixel, the last one wins. Merges segments of the same value whatever
+   * OnTheFlyCleanup says. With SparseLines on, a line which becomes all
+   * background is made absent. */
+  void
+  SetPixels(const std::vector<PixelEdit> & edits, bool inParallel = true);
+
+  /** \brief Write a dense slice back into the image, at the given position
+   * along axis.
+   *
+   * The dimensions of the slice are those of the image other than axis, in
+   * order, and its buffered region gives their indices, as ImageRegion::Slice()
+   * does. A slice along another axis than the run axis is encoded row by row,
+   * and each row is spliced into its line at once (see SetRuns()). A slice
+   * along the run axis sets one pixel of every line it crosses, so it is not
+   * faster than SetPixel() per pixel, except for being done in parallel.
+   * Values new to the palette are added before the rows are written, which
+   * happens in parallel unless inParallel is false. */
+  void
+  SetSlice(const SliceImageType * slice, unsigned int axis, IndexValueType position, bool inParallel = true);
+
   /** \brief Get a pixel. SLOW! Better use iterators for pixel access. */
   const TPixel &
   GetPixel(const IndexType & index) const;
@@ -213,35 +534,330 @@ public:
   {
     // use the GetLength() method which works with variable length arrays,
     // to make it work with as much pixel types as possible
-    return itk::NumericTraits<PixelType>::GetLength({});
+    const unsigned int length = itk::NumericTraits<PixelType>::GetLength({});
+    return length > 0 ? length : m_NumberOfComponentsPerPixel; // variable length pixels
+  }
+
+  /** Only kept for variable length pixels, like VariableLengthVector,
+   * whose default value has no components. */
+  void
+  SetNumberOfComponentsPerPixel(unsigned int n) override
+  {
+    m_NumberOfComponentsPerPixel = n;
   }
 
   /** Typedef for the internally used buffer. */
   using BufferType = typename itk::Image<RLLine, VImageDimension - 1>;
 
-  /** We need to allow itk-style iterators to be constructed. */
+  /** We need to allow itk-style iterators to be constructed.
+   * Ends an edit session and thaws a frozen image. Lines may be written through the returned buffer,
+   * so all slabs are marked mixed, see UpdateSlabSummary(). Unless SparseLines is on,
+   * the lines left absent by Allocate() get their uniform background line first. */
   typename BufferType::Pointer
   GetBuffer()
   {
+    this->EndEdit();
+    this->Thaw();
+    if (m_AbsentLinesLeft)
+    {
+      this->MaterializeAbsentLines();
+    }
+    for (auto & slab : m_Slabs)
+    {
+      slab.m_Mixed.store(true, std::memory_order_relaxed);
+    }
+    this->InvalidateLineHashes();
     return m_Buffer;
   }
 
-  /** We need to allow itk-style const iterators to be constructed. */
+  /** We need to allow itk-style const iterators to be constructed.
+   * Lines may be empty, even with SparseLines off: absent lines (see
+   * Allocate()) stand for a line of background, so read them through
+   * ResolveLine(). The lines of a frozen image are not in the buffer,
+   * see GetLine(). */
   typename BufferType::Pointer
   GetBuffer() const
   {
     return m_Buffer;
   }
 
-  /** Returns N-1-dimensional index, the remainder after 0-index is removed. */
+  /** The buffer, for code which assigns whole lines, such as the threads
+   * of RegionOfInterestImageFilter filling an image after Allocate().
+   * Unlike GetBuffer(), does not end an edit session, thaw the image,
+   * give absent lines their background line, mark slabs mixed or
+   * invalidate line hashes, so it may be called from several threads.
+   * Lines which are not assigned stay absent. Writers update the slab
+   * summary themselves, see UpdateSlabSummary(). */
+  typename BufferType::Pointer
+  GetBufferForOverwrite()
+  {
+    itkAssertOrThrowMacro(!this->IsFrozen() && !this->IsEditing(),
+                          "Cannot overwrite the lines of a frozen image or during an edit session!");
+    return m_Buffer;
+  }
+
+  /** Read-only storage of the lines of a frozen image. */
+  using FrozenLinesType = FrozenRunLengthLines<RLValueType, CounterType>;
+
+  /** Encodes all lines into a compact read-only form and releases the buffer.
+   * GetPixel(), const iterators and RegionOfInterestImageFilter read
+   * the frozen image directly. Writing to it thaws it. Adjacent segments
+   * with equal values are merged. Does nothing if the image is frozen. */
+  void
+  Freeze();
+
+  /** Decodes the lines of a frozen image back into the buffer.
+   * Called by the first write to a frozen image.
+   * Not thread safe: thaw before writing to the image from multiple threads.
+   * Does nothing if the image is not frozen. */
+  void
+  Thaw();
+
+  bool
+  IsFrozen() const
+  {
+    return m_FrozenLines != nullptr;
+  }
+
+  /** Lines of a frozen image, nullptr if it is not frozen. */
+  const FrozenLinesType *
+  GetFrozenLines() const
+  {
+    return m_FrozenLines.get();
+  }
+
+  /** Returns the line at the given buffer index. The line of a frozen image
+   * is decoded into scratch, which is returned. */
+  const RLLine &
+  GetLine(const typename BufferType::IndexType & index, RLLine & scratch) const;
+
+  /** Returns the buffer line itself, or the background line it stands for
+   * if it is absent (empty), see SetSparseLines(). */
+  const RLLine &
+  ResolveLine(const RLLine & line) const
+  {
+    return line.empty() ? m_AbsentLine : line;
+  }
+
+  /** Are all pixels of the line background (the default pixel value)?
+   * True for absent lines. */
+  bool
+  IsBackgroundLine(const RLLine & line) const;
+
+  /** Are lines which become all background made absent (empty)? Default: Off. */
+  bool
+  GetSparseLines() const
+  {
+    return m_SparseLines;
+  }
+
+  /** Should lines which become all background be made absent (empty)?
+   * Converts the lines of an allocated image. Turning it off materializes
+   * absent lines. Compact() makes lines which became background absent. */
+  void
+  SetSparseLines(bool value);
+
+  /** Outermost index axis other than the run axis. The lines of a slab,
+   * a slice along this axis, share the last index of their buffer index. */
+  unsigned int
+  GetSlabAxis() const
+  {
+    return m_RunAxis == VImageDimension - 1 ? VImageDimension - 2 : VImageDimension - 1;
+  }
+
+  /** Is the summary of uniform slabs kept up to date? Default: Off. */
+  bool
+  GetSlabSummary() const
+  {
+    return m_SlabSummary;
+  }
+
+  /** Should the image keep track of uniform slabs? Turning it on scans
+   * the lines of an allocated image. */
+  void
+  SetSlabSummary(bool value);
+
+  /** Rescans the lines to find the uniform slabs, in parallel. Call after
+   * writing lines through GetBuffer(), or to find mixed slabs which
+   * became uniform. Does nothing unless SlabSummary is on. */
+  void
+  UpdateSlabSummary();
+
+  /** Is the slab at the given index along the slab axis known to be uniform?
+   * If so, stored is set to the value stored in its segments, see DecodeValue().
+   * Always false if SlabSummary is off. */
+  bool
+  IsUniformSlab(IndexValueType slab, RLValueType & stored) const
+  {
+    const IndexValueType i = slab - m_Buffer->GetBufferedRegion().GetIndex(VImageDimension - 2);
+    if (m_Slabs.empty() || m_Slabs[i].m_Mixed.load(std::memory_order_relaxed))
+    {
+      return false;
+    }
+    stored = m_Slabs[i].m_Value;
+    return true;
+  }
+
+  /** Marks the slab of the line at the given buffer index as mixed,
+   * unless value is its uniform value. Called for every pixel write
+   * if SlabSummary is on. Can be called from several threads. */
+  void
+  NoteSlabWrite(const typename BufferType::IndexType & lineIndex, const TPixel & value)
+  {
+    const IndexValueType i =
+      lineIndex[VImageDimension - 2] - m_Buffer->GetBufferedRegion().GetIndex(VImageDimension - 2);
+    if (!m_Slabs.empty() && !m_Slabs[i].m_Mixed.load(std::memory_order_relaxed) &&
+        !(this->DecodeValue(m_Slabs[i].m_Value) == value))
+    {
+      m_Slabs[i].m_Mixed.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  /** Pixel value of a value stored in a segment. */
+  const TPixel &
+  DecodeValue(const RLValueType & stored) const
+  {
+    if constexpr (IsPaletteEncoded)
+    {
+      return m_Palette[stored];
+    }
+    else
+    {
+      return stored;
+    }
+  }
+
+  /** Value to store in a segment for the given pixel value.
+   * Adds the value to the palette if needed. */
+  RLValueType
+  EncodeValue(const TPixel & value);
+
+  /** Pixel values indexed by the values stored in segments.
+   * Empty unless the image is palette encoded. */
+  const std::vector<TPixel> &
+  GetPalette() const
+  {
+    return m_Palette;
+  }
+
+  /** Replaces the palette, e.g. by that of an image whose lines are copied.
+   * Ignored unless the image is palette encoded. */
+  void
+  SetPalette(const std::vector<TPixel> & palette);
+
+  /** Changes all the pixels with value from to value to. Only touches the
+   * palette of a palette encoded image (keeping it frozen) unless to is in
+   * the palette already, in which case the two indices are merged in every
+   * line and one of them is reused for the next new value. Otherwise visits
+   * every segment, in parallel. */
+  void
+  ReplaceValue(const TPixel & from, const TPixel & to);
+
+  /** Returns N-1-dimensional index, the remainder after 0-index is removed.
+   * This is the line index only for a run axis of 0, see GetLineIndex(). */
   static inline typename BufferType::IndexType
   truncateIndex(const IndexType & index);
 
-  /** Merges adjacent segments with duplicate values.
+  /** Buffer index of the line which contains the pixel at index. */
+  typename BufferType::IndexType
+  GetLineIndex(const IndexType & index) const;
+
+  /** Index of the pixel of the given line whose index along the run axis is runIndex. */
+  IndexType
+  GetIndexOnLine(const typename BufferType::IndexType & lineIndex, IndexValueType runIndex) const;
+
+  /** Largest number of pixels in a single segment. */
+  static constexpr SizeValueType MaximumSegmentLength = std::numeric_limits<CounterType>::max();
+
+  /** Appends length pixels with the given stored value to line, topping up
+   * its last segment first if that has the same value. Runs longer than
+   * MaximumSegmentLength are split into consecutive segments. */
+  static void
+  AppendRun(RLLine & line, SizeValueType length, const RLValueType & value);
+
+  /** Merges adjacent segments with duplicate values, as far as CounterType allows.
    * Automatically called when turning on OnTheFlyCleanup. */
   void
   CleanUp() const;
 
+  /** Moves the segments of all lines into a single contiguous arena,
+   * replacing any previous arenas. Lines which later grow beyond their
+   * slot in the arena are moved to their own heap storage.
+   * Buffer lines must not be accessed after the image is destroyed.
+   * Does nothing to a frozen image. */
+  void
+  Consolidate();
+
+  /** Makes identical lines share their storage (copy-on-write),
+   * returns the number of lines which now share storage with an earlier line.
+   * Shared lines are left out of Consolidate(), so call this first.
+   * Requires a line type with shared storage, such as RunLengthLine.
+   * Frozen images already share identical lines. */
+  SizeValueType
+  Deduplicate();
+
+  /** Reduces the capacity of every line to its size, in parallel.
+   * Lines edited through SetPixel or built segment by segment
+   * keep spare capacity, like std::vector does.
+   * With SparseLines on, background lines become absent.
+   * Returns the number of bytes reclaimed, none for a frozen image. */
+  SizeValueType
+  Compact();
+
+  /** Allocator for the storage of the lines created by the next Allocate().
+   * With a std::pmr line allocator (see PmrRLEImage) this can be a pointer to
+   * a memory resource, e.g. a pool for images which are edited a lot, or a
+   * monotonic resource released in bulk once the image is gone. The resource
+   * must outlive the lines, and be synchronized if several threads write to
+   * the image. Lines copied out of the image get the default allocator. */
+  void
+  SetLineAllocator(const LineAllocatorType & allocator)
+  {
+    m_LineAllocator.emplace(allocator); // std::pmr allocators cannot be assigned
+  }
+
+  LineAllocatorType
+  GetLineAllocator() const
+  {
+    return m_LineAllocator ? *m_LineAllocator : LineAllocatorType();
+  }
+
+  /** Number of bytes taken by the lines and their segments, segment arenas,
+   * frozen lines and the palette. Storage shared by several lines is split
+   * evenly between them. */
+  SizeValueType
+  GetNumberOfBytes() const;
+
+  /** Hash of the pixels of a line, independent of how they are stored in
+   * segments: lines with the same pixels have the same hash, also in
+   * another image of this type. Hashes computed while comparing images are
+   * kept until the line is written to. */
+  std::size_t
+  GetLineHash(const typename BufferType::IndexType & lineIndex) const;
+
+  /** Does other have the same pixels? It must have the same buffered region
+   * size and run axis. Lines are compared run by run, in parallel, and lines
+   * whose hashes differ are known to differ without a comparison.
+   * Returns false as soon as a difference is found. */
+  bool
+  IsSameContent(const Self * other) const;
+
+  /** Indices of the lines whose pixels differ from those of the same lines
+   * of other, see IsSameContent(). */
+  std::vector<typename BufferType::IndexType>
+  GetDifferingLines(const Self * other) const;
+
+  /** Forgets the hash of a line, see GetLineHash().
+   * Called for every pixel write. Can be called from several threads. */
+  void
+  InvalidateLineHash(const typename BufferType::IndexType & lineIndex)
+  {
+    if (!m_LineHashes.empty())
+    {
+      m_LineHashes[m_Buffer->ComputeOffset(lineIndex)].store(0, std::memory_order_relaxed);
+    }
+  }
+
   /** Should same-valued segments be merged on the fly?
    * On the fly merging usually provides better performance. */
   bool
@@ -266,12 +882,96 @@ public:
     }
   }
 
+  /** \brief Starts an edit session for the lines which cross region.
+   *
+   * The lines are decoded into rows of pixels (see GetEditRow()), which
+   * iterators, GetPixel(), SetPixel(), SetRun(), SetRuns() and SetPixels()
+   * use instead of the lines, so writes to them take constant time.
+   * Iterators notice that a session began or ended (see GetEditGeneration())
+   * when they next read, write or move to another line. Other methods, such as
+   * GetBuffer() or IsSameContent(), see the lines as they were when the
+   * session started. Ends the previous session, and thaws a frozen image. */
+  void
+  BeginEdit(const RegionType & region);
+
+  /** Encodes the rows which were written to since BeginEdit() back into
+   * their lines, in parallel, merging segments of the same value, and
+   * releases the rows. Does nothing outside of an edit session.
+   * Called by Freeze(), ReplaceValue() and the non-const GetBuffer(),
+   * while FillBuffer() discards the rows. */
+  void
+  EndEdit();
+
+  /** Is an edit session going on? See BeginEdit(). */
+  bool
+  IsEditing() const
+  {
+    return !m_EditRows.empty();
+  }
+
+  /** Counts the edit sessions begun and ended, including rows discarded by
+   * FillBuffer() or Allocate(). Iterators compare it with the value they
+   * saw last, to stop using rows which were released or lines which were
+   * rewritten from rows. */
+  SizeValueType
+  GetEditGeneration() const
+  {
+    return m_EditGeneration;
+  }
+
+  /** The row of the line at the given buffer index during an edit session,
+   * nullptr if the line is not being edited. Writers set m_Dirty. */
+  EditRow *
+  GetEditRow(const typename BufferType::IndexType & lineIndex)
+  {
+    return const_cast<EditRow *>(static_cast<const Self *>(this)->GetEditRow(lineIndex));
+  }
+  const EditRow *
+  GetEditRow(const typename BufferType::IndexType & lineIndex) const
+  {
+    if (m_EditRows.empty() || !m_EditLines.IsInside(lineIndex))
+    {
+      return nullptr;
+    }
+    SizeValueType row = 0;
+    for (unsigned int k = VImageDimension - 1; k > 0; k--)
+    {
+      row = row * m_EditLines.GetSize(k - 1) + SizeValueType(lineIndex[k - 1] - m_EditLines.GetIndex(k - 1));
+    }
+    return &m_EditRows[row];
+  }
+
+  /** Do the writable iterators gather the writes to a line? Default: Off. */
+  bool
+  GetWriteCombining() const
+  {
+    return m_WriteCombining;
+  }
+
+  /** Should the writable iterators gather consecutive writes to a line,
+   * and splice them into the line at once (see SetRuns())? This makes
+   * rewriting whole lines linear in their length rather than quadratic.
+   * Gathered writes are spliced in when the iterator moves to another line
+   * or past the end of its region, when it writes a pixel which does not
+   * follow them, and when it is destroyed. Until then, only reads through
+   * the same iterator see them: other iterators, GetPixel() and filters
+   * read the previous pixels, so call the iterator's FlushWrites() before
+   * reading them elsewhere. An iterator with gathered writes keeps the image
+   * alive, and reports rather than throws a failure to splice them in
+   * when it is destroyed. */
+  void
+  SetWriteCombining(bool value)
+  {
+    m_WriteCombining = value;
+  }
+
 protected:
   RLEImage()
     : itk::ImageBase<VImageDimension>()
 
   {
     m_Buffer = BufferType::New();
+    this->ResetPalette();
   }
 
   void
@@ -293,12 +993,136 @@ protected:
   void
   CleanUpLine(RLLine & line) const;
 
+  /** Sets the stored value of a pixel of a line of segments,
+   * see SetPixel(line, segmentRemainder, m_RealIndex, value). */
+  int
+  SetPixelInSegments(RLLine &            line,
+                     IndexValueType &    segmentRemainder,
+                     SizeValueType &     m_RealIndex,
+                     const RLValueType & value);
+
 private:
-  bool m_OnTheFlyCleanup{ true }; // should same-valued segments be merged on the fly
+  bool         m_OnTheFlyCleanup{ true }; // should same-valued segments be merged on the fly
+  unsigned int m_RunAxis{ 0 };            // index axis of the run-length lines
+  bool         m_SparseLines{ false };    // are background lines absent (empty)
+  bool         m_WriteCombining{ false }; // do iterators gather the writes to a line
+  bool         m_AbsentLinesLeft{ false }; // has Allocate() left lines absent with SparseLines off
+
+  /** Gives every absent line its uniform background line, in parallel. */
+  void
+  MaterializeAbsentLines();
+
+  /** Uniform background line, which absent lines stand for. */
+  RLLine m_AbsentLine;
+
+  /** See SetLineAllocator(), the default allocator unless set. */
+  std::optional<LineAllocatorType> m_LineAllocator;
+
+  /** Allocates a buffer of absent lines, which draw storage from the line allocator. */
+  void
+  AllocateLines();
+
+  /** Summary of a slab, see SetSlabSummary(). */
+  struct SlabState
+  {
+    RLValueType       m_Value{};        // stored value of all pixels, unless mixed
+    std::atomic<bool> m_Mixed{ false }; // might the slab have several values
+  };
+
+  /** One state per slab, empty unless SlabSummary is on and the image is allocated. */
+  bool                   m_SlabSummary{ false };
+  std::vector<SlabState> m_Slabs;
+
+  /** Makes all slabs uniform with the given stored value, if SlabSummary is on. */
+  void
+  ResetSlabSummary(const RLValueType & stored);
+
+  /** Cached line hashes, zero if not computed yet. Empty unless the image
+   * has been compared, see GetLineHash(). */
+  mutable std::vector<std::atomic<std::size_t>> m_LineHashes;
+  mutable std::mutex                            m_LineHashesMutex; // serializes making room for them
+
+  /** Forgets all line hashes, keeping room for them. */
+  void
+  InvalidateLineHashes();
+
+  /** Hash of the pixels of a line, never zero. */
+  std::size_t
+  ComputeLineHash(const RLLine & line) const;
+
+  /** Do line of this image and otherLine of other hold the same pixels? */
+  bool
+  IsSameLine(const RLLine & line, const Self * other, const RLLine & otherLine) const;
+
+  /** Offsets of the lines which differ from those of other, stopping at the first one if asked. */
+  std::vector<SizeValueType>
+  CompareLines(const Self * other, bool stopAtFirst) const;
+
+  /** Lines of the edit session and their rows, in buffer order. Empty outside of a session. */
+  typename BufferType::RegionType m_EditLines;
+  std::vector<EditRow>            m_EditRows;
+  SizeValueType                   m_EditGeneration{ 0 }; // see GetEditGeneration()
+
+  /** Buffer index of the line of the given edit row. */
+  typename BufferType::IndexType
+  GetEditLineIndex(SizeValueType row) const;
+
+  /** Contiguous storage for segments of lines, see Consolidate(). */
+  std::vector<typename RLLine::Arena> m_SegmentArenas;
 
   /** Memory for the current buffer. */
   mutable typename BufferType::Pointer m_Buffer;
+
+  /** Lines of a frozen image, see Freeze(). */
+  std::unique_ptr<FrozenLinesType> m_FrozenLines;
+
+  /** Pixel values and their indices, if the image is palette encoded. */
+  std::vector<TPixel>           m_Palette;
+  std::map<TPixel, RLValueType, PixelLess> m_PaletteIndices;
+  std::mutex                               m_PaletteMutex;
+  std::vector<RLValueType>                 m_FreePaletteIndices; // left unused by ReplaceValue()
+
+  unsigned int m_NumberOfComponentsPerPixel = 0;
+
+  /** Empties the palette, except for the default pixel value at index 0. */
+  void
+  ResetPalette();
+
+  /** Changes the stored value from to to in every line and slab, in parallel. */
+  void
+  ReplaceStoredValue(const RLValueType & from, const RLValueType & to);
 };
+
+/** RLEImage whose segments store indices of type TPaletteIndex into a palette of pixel values.
+ * \ingroup RLEImage */
+template <typename TPixel,
+          unsigned int VImageDimension = 3,
+          typename CounterType = unsigned short,
+          typename TPaletteIndex = unsigned short>
+using PaletteRLEImage = RLEImage<TPixel, VImageDimension, CounterType, RunLengthLine<TPaletteIndex, CounterType>>;
+
+/** RLEImage of a binary mask, whose lines store only alternating run lengths.
+ * With a pixel type other than bool, the two pixel values are kept in the palette.
+ * \ingroup RLEImage */
+template <typename TPixel = bool, unsigned int VImageDimension = 3, typename CounterType = unsigned short>
+using BinaryMaskRLEImage = RLEImage<TPixel, VImageDimension, CounterType, BinaryRunLengthLine<CounterType>>;
+
+/** RLEImage whose lines are stored as rows of pixels when that takes less memory than segments.
+ * \ingroup RLEImage */
+template <typename TPixel, unsigned int VImageDimension = 3, typename CounterType = unsigned short>
+using HybridRLEImage = RLEImage<TPixel, VImageDimension, CounterType, HybridRunLengthLine<TPixel, CounterType>>;
+
+#if __has_include(<memory_resource>)
+/** RLEImage whose lines draw their storage from a std::pmr::memory_resource,
+ * see SetLineAllocator(). Lines are 8 bytes larger, for the resource pointer.
+ * \ingroup RLEImage */
+template <typename TPixel, unsigned int VImageDimension = 3, typename CounterType = unsigned short>
+using PmrRLEImage =
+  RLEImage<TPixel,
+           VImageDimension,
+           CounterType,
+           RunLengthLine<TPixel, CounterType, std::pmr::polymorphic_allocator<char>>>;
+#endif
 } // namespace itk
 
 #ifndef ITK_MANUAL_INSTANTIATION
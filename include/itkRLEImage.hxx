@@ -25,11 +25,20 @@
 #include "itkRLEImageScanlineIterator.h"
 #include "itkRLERegionOfInterestImageFilter.h"
 
+#include "itkMultiThreaderBase.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional> // std::hash
+#include <unordered_map>
+
 namespace itk
 {
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 inline auto
-RLEImage<TPixel, VImageDimension, CounterType>::truncateIndex(const IndexType & index) -> typename BufferType::IndexType
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::truncateIndex(const IndexType & index)
+  -> typename BufferType::IndexType
 {
   typename BufferType::IndexType result;
   for (IndexValueType i = 0; i < VImageDimension - 1; i++)
@@ -39,65 +48,464 @@ RLEImage<TPixel, VImageDimension, CounterType>::truncateIndex(const IndexType &
   return result;
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+auto
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::GetLineIndex(const IndexType & index) const
+  -> typename BufferType::IndexType
+{
+  typename BufferType::IndexType result;
+  for (unsigned int i = 0, j = 0; i < VImageDimension; i++)
+  {
+    if (i != m_RunAxis)
+    {
+      result[j++] = index[i];
+    }
+  }
+  return result;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+auto
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::GetIndexOnLine(const typename BufferType::IndexType & lineIndex,
+                                                                      IndexValueType runIndex) const -> IndexType
+{
+  IndexType result;
+  for (unsigned int i = 0, j = 0; i < VImageDimension; i++)
+  {
+    result[i] = (i == m_RunAxis) ? runIndex : lineIndex[j++];
+  }
+  return result;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetRunAxis(unsigned int axis)
+{
+  itkAssertOrThrowMacro(axis < VImageDimension, "Run axis must be one of the index axes!");
+  if (axis == m_RunAxis)
+  {
+    return;
+  }
+  m_RunAxis = axis;
+
+  // lines along the previous axis are meaningless now
+  m_FrozenLines.reset();
+  m_Buffer->Initialize();
+  m_SegmentArenas.clear();
+  m_AbsentLine = RLLine();
+  m_Slabs.clear();
+  m_LineHashes.clear();
+  m_EditRows.clear();
+  m_EditGeneration++;
+  this->ResetPalette();
+  m_Buffer->SetLargestPossibleRegion(this->GetLargestPossibleRegion().Slice(axis));
+  m_Buffer->SetBufferedRegion(this->GetBufferedRegion().Slice(axis));
+  m_Buffer->SetRequestedRegion(this->GetRequestedRegion().Slice(axis));
+  this->Modified();
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+bool
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::IsBackgroundLine(const RLLine & line) const
+{
+  for (SizeValueType x = 0; x < line.size(); x++)
+  {
+    if (!(line[x].second == RLValueType()))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetSparseLines(bool value)
+{
+  if (value == m_SparseLines)
+  {
+    return;
+  }
+  m_SparseLines = value;
+  if (this->IsFrozen() || m_Buffer->GetBufferPointer() == nullptr)
+  {
+    return; // Thaw() and Allocate() take care of the lines
+  }
+  if (!m_SparseLines)
+  {
+    this->MaterializeAbsentLines();
+    return;
+  }
+
+  m_AbsentLinesLeft = false;
+  RLLine *                   lines = m_Buffer->GetBufferPointer();
+  MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+  mt->ParallelizeArray(
+    0,
+    m_Buffer->GetBufferedRegion().GetNumberOfPixels(),
+    [this, lines](SizeValueType i) {
+      if (this->IsBackgroundLine(lines[i]))
+      {
+        lines[i] = RLLine();
+      }
+    },
+    nullptr);
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::MaterializeAbsentLines()
+{
+  m_AbsentLinesLeft = false;
+  RLLine *                   lines = m_Buffer->GetBufferPointer();
+  MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+  mt->ParallelizeArray(
+    0,
+    m_Buffer->GetBufferedRegion().GetNumberOfPixels(),
+    [this, lines](SizeValueType i) {
+      if (lines[i].empty())
+      {
+        lines[i] = m_AbsentLine; // exactly sized copies share their storage
+      }
+    },
+    nullptr);
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetSlabSummary(bool value)
+{
+  if (value == m_SlabSummary)
+  {
+    return;
+  }
+  m_SlabSummary = value;
+  m_Slabs.clear();
+  if (this->IsFrozen() || m_Buffer->GetBufferPointer() != nullptr)
+  {
+    this->UpdateSlabSummary(); // otherwise Allocate() sets it up
+  }
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::ResetSlabSummary(const RLValueType & stored)
+{
+  if (!m_SlabSummary)
+  {
+    return;
+  }
+  const SizeValueType slabCount = m_Buffer->GetBufferedRegion().GetSize(VImageDimension - 2);
+  m_Slabs = std::vector<SlabState>(slabCount); // none is mixed
+  for (auto & slab : m_Slabs)
+  {
+    slab.m_Value = stored;
+  }
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::UpdateSlabSummary()
+{
+  const SizeValueType slabCount = m_Buffer->GetBufferedRegion().GetSize(VImageDimension - 2);
+  if (!m_SlabSummary || slabCount == 0)
+  {
+    return;
+  }
+  this->ResetSlabSummary(RLValueType());
+
+  // lines of a slab are consecutive in the buffer
+  const SizeValueType        linesPerSlab = m_Buffer->GetBufferedRegion().GetNumberOfPixels() / slabCount;
+  const RLLine *             lines = this->IsFrozen() ? nullptr : m_Buffer->GetBufferPointer();
+  MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+  mt->ParallelizeArray(
+    0,
+    slabCount,
+    [this, lines, linesPerSlab](SizeValueType slab) {
+      RLLine scratch;
+      bool   mixed = false;
+      for (SizeValueType i = slab * linesPerSlab; i < (slab + 1) * linesPerSlab && !mixed; i++)
+      {
+        if (lines == nullptr)
+        {
+          m_FrozenLines->Decode(i, scratch);
+        }
+        const RLLine & line = lines == nullptr ? scratch : this->ResolveLine(lines[i]);
+        if (i == slab * linesPerSlab)
+        {
+          m_Slabs[slab].m_Value = line[0].second;
+        }
+        for (SizeValueType x = 0; x < line.size() && !mixed; x++)
+        {
+          mixed = !(line[x].second == m_Slabs[slab].m_Value);
+        }
+      }
+      m_Slabs[slab].m_Mixed.store(mixed, std::memory_order_relaxed);
+    },
+    nullptr);
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RLEImage<TPixel, VImageDimension, CounterType>::Allocate(bool itkNotUsed(initialize))
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::Allocate(bool initialize)
 {
-  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(0) == this->GetLargestPossibleRegion().GetSize(0),
+  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(m_RunAxis) ==
+                          this->GetLargestPossibleRegion().GetSize(m_RunAxis),
                         "BufferedRegion must contain complete run-length lines!");
-  itkAssertOrThrowMacro(this->GetLargestPossibleRegion().GetSize(0) <=
-                          itk::SizeValueType(std::numeric_limits<CounterType>::max()),
-                        "CounterType is not large enough to support image's X dimension!");
+  itkAssertOrThrowMacro(!RLLine::LimitsLineLength ||
+                          this->GetLargestPossibleRegion().GetSize(m_RunAxis) <= MaximumSegmentLength,
+                        "CounterType is not large enough to support image's size along the run axis!");
   this->ComputeOffsetTable();
-  // SizeValueType num = static_cast<SizeValueType>(this->GetOffsetTable()[VImageDimension]);
+  m_FrozenLines.reset();
+  this->ResetPalette();
+  m_AbsentLine = RLLine();
+  AppendRun(m_AbsentLine, this->GetBufferedRegion().GetSize(m_RunAxis), this->EncodeValue(TPixel()));
+
+  // all lines are absent: the image reads as background without any per-line storage
+  this->AllocateLines();
+  if (initialize && !m_SparseLines)
+  {
+    m_Buffer->FillBuffer(RLLine(m_AbsentLine)); // exactly sized copies share their storage
+  }
+  m_AbsentLinesLeft = !initialize && !m_SparseLines;
+  m_SegmentArenas.clear(); // no line refers to them any more
+  this->ResetSlabSummary(RLValueType());
+  m_LineHashes.clear();
+  m_EditRows.clear();
+  m_EditGeneration++;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::AllocateLines()
+{
+  // A new container default constructs its lines, so they are all absent.
+  // Reusing the previous container would keep its lines.
+  m_Buffer->SetPixelContainer(BufferType::PixelContainer::New());
   m_Buffer->Allocate(false);
-  // if (initialize) //there is assumption that the image is fully formed after a call to allocate
+  if constexpr (!std::allocator_traits<LineAllocatorType>::is_always_equal::value)
   {
-    RLSegment segment(CounterType(this->GetBufferedRegion().GetSize(0)), TPixel());
-    RLLine    line(1);
-    line[0] = segment;
-    m_Buffer->FillBuffer(line);
+    // lines keep their allocator when assigned to, so they are constructed with it
+    const LineAllocatorType allocator = this->GetLineAllocator();
+    RLLine *                lines = m_Buffer->GetBufferPointer();
+    const SizeValueType     lineCount = m_Buffer->GetBufferedRegion().GetNumberOfPixels();
+    for (SizeValueType i = 0; i < lineCount; i++)
+    {
+      lines[i].~RLLine();
+      new (&lines[i]) RLLine(allocator);
+    }
   }
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RLEImage<TPixel, VImageDimension, CounterType>::FillBuffer(const TPixel & value)
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::FillBuffer(const TPixel & value)
 {
-  RLSegment segment(CounterType(this->GetBufferedRegion().GetSize(0)), value);
-  RLLine    line(1);
+  m_EditRows.clear(); // all lines are overwritten
+  m_EditGeneration++;
+  if (this->IsFrozen())
+  {
+    m_FrozenLines.reset(); // all lines are overwritten
+    this->AllocateLines();
+  }
+  this->ResetPalette(); // all lines are overwritten
+
+  RLLine            line;
+  const RLValueType stored = this->EncodeValue(value);
+  AppendRun(line, this->GetBufferedRegion().GetSize(m_RunAxis), stored);
+  if (m_SparseLines && this->IsBackgroundLine(line))
+  {
+    line = RLLine();
+  }
+  m_Buffer->FillBuffer(RLLine(line)); // exactly sized copies share their storage
+  m_AbsentLinesLeft = false;
+  this->ResetSlabSummary(stored);
+  this->InvalidateLineHashes();
+}
 
-  line[0] = segment;
-  m_Buffer->FillBuffer(line);
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::AppendRun(RLLine &            line,
+                                                                 SizeValueType       length,
+                                                                 const RLValueType & value)
+{
+  const RLLine & cline = line;
+  if (cline.empty() && length == 0)
+  {
+    line.push_back(RLSegment(0, value)); // the line of an empty region
+    return;
+  }
+  if (!cline.empty() && cline.back().second == value && cline.back().first < MaximumSegmentLength)
+  {
+    const SizeValueType added = std::min(length, SizeValueType(MaximumSegmentLength - cline.back().first));
+    line.back().first += CounterType(added);
+    length -= added;
+  }
+  while (length > 0)
+  {
+    const SizeValueType count = std::min(length, MaximumSegmentLength);
+    line.push_back(RLSegment(CounterType(count), value));
+    length -= count;
+  }
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RLEImage<TPixel, VImageDimension, CounterType>::CleanUpLine(RLLine & line) const
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::Consolidate()
+{
+  if (this->IsFrozen())
+  {
+    return;
+  }
+
+  itk::ImageRegionIterator<BufferType> it(m_Buffer, m_Buffer->GetBufferedRegion());
+
+  SizeValueType segmentCount = 0;
+  while (!it.IsAtEnd())
+  {
+    segmentCount += it.Value().GetNumberOfArenaSlots();
+    ++it;
+  }
+
+  typename RLLine::Arena arena(segmentCount);
+  SizeValueType          offset = 0;
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  {
+    RLLine &      line = it.Value();
+    SizeValueType slots = line.GetNumberOfArenaSlots();
+    line.MoveToArena(arena, offset);
+    offset += slots;
+  }
+
+  // lines have been moved out of the previous arenas
+  m_SegmentArenas.clear();
+  m_SegmentArenas.push_back(std::move(arena));
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+auto
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::Deduplicate() -> SizeValueType
 {
-  CounterType x = 0;
-  RLLine      out;
+  if (this->IsFrozen())
+  {
+    return 0;
+  }
 
-  out.reserve(this->GetLargestPossibleRegion().GetSize(0));
+  // lines with equal hashes, candidates for sharing storage
+  std::unordered_map<std::size_t, std::vector<RLLine *>> representatives;
+  SizeValueType                                          sharedCount = 0;
 
-  do
+  itk::ImageRegionIterator<BufferType> it(m_Buffer, m_Buffer->GetBufferedRegion());
+  for (; !it.IsAtEnd(); ++it)
   {
-    out.push_back(line[x]);
-    while (++x < line.size() && line[x].second == line[x - 1].second)
+    RLLine & line = it.Value();
+    if (line.IsInline())
+    {
+      continue; // nothing to gain
+    }
+    const RLLine &          cline = line;
+    std::vector<RLLine *> & candidates = representatives[cline.Hash()];
+    auto found = std::find_if(candidates.begin(), candidates.end(), [&cline](const RLLine * c) { return *c == cline; });
+    if (found == candidates.end())
+    {
+      candidates.push_back(&line);
+      continue;
+    }
+    RLLine & representative = **found;
+    if (!representative.IsShareable())
     {
-      out.back().first += line[x].first;
+      representative = RLLine(static_cast<const RLLine &>(representative)); // exactly sized copy
     }
-  } while (x < line.size());
+    line = representative;
+    ++sharedCount;
+  }
+  return sharedCount;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+auto
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::Compact() -> SizeValueType
+{
+  if (this->IsFrozen())
+  {
+    return 0;
+  }
+
+  std::atomic<SizeValueType> reclaimed{ 0 };
+
+  MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+  mt->template ParallelizeImageRegion<VImageDimension - 1>(
+    m_Buffer->GetBufferedRegion(),
+    [this, &reclaimed](const typename BufferType::RegionType & region) {
+      SizeValueType                        bytes = 0;
+      itk::ImageRegionIterator<BufferType> it(m_Buffer, region);
+      for (; !it.IsAtEnd(); ++it)
+      {
+        RLLine & line = it.Value();
+        bytes += line.GetOwnedBytes();
+        if (m_SparseLines && this->IsBackgroundLine(line))
+        {
+          line = RLLine();
+        }
+        line.shrink_to_fit();
+        bytes -= line.GetOwnedBytes();
+      }
+      reclaimed += bytes;
+    },
+    nullptr);
+
+  return reclaimed;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+auto
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::GetNumberOfBytes() const -> SizeValueType
+{
+  SizeValueType bytes = m_Palette.capacity() * sizeof(TPixel);
+  if (this->IsFrozen()) // a frozen image has no lines in the buffer
+  {
+    return bytes + m_FrozenLines->GetNumberOfBytes();
+  }
+
+  const RLLine *      lines = m_Buffer->GetBufferPointer();
+  const SizeValueType lineCount = m_Buffer->GetBufferedRegion().GetNumberOfPixels();
+  bytes += lineCount * sizeof(RLLine);
+  for (SizeValueType i = 0; i < lineCount; i++)
+  {
+    bytes += lines[i].GetOwnedBytes();
+  }
+  for (const auto & arena : m_SegmentArenas)
+  {
+    bytes += arena.GetNumberOfBytes();
+  }
+  return bytes;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::CleanUpLine(RLLine & line) const
+{
+  const RLLine & in = line; // reading does not unshare the line
+  RLLine         out;
+
+  out.reserve(in.size());
+  for (SizeValueType x = 0; x < in.size(); x++)
+  {
+    AppendRun(out, in[x].first, in[x].second); // merges as far as CounterType allows
+  }
 
-  out.swap(line);
+  if (out.size() != in.size()) // leave clean lines alone
+  {
+    line = out;
+  }
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RLEImage<TPixel, VImageDimension, CounterType>::CleanUp() const
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::CleanUp() const
 {
   assert(m_Buffer->GetBufferedRegion().GetNumberOfPixels() > 0);
-  if (this->GetLargestPossibleRegion().GetSize(0) == 0)
+  if (this->GetLargestPossibleRegion().GetSize(m_RunAxis) == 0 || this->IsFrozen()) // frozen lines are clean
   {
     return;
   }
@@ -110,27 +518,80 @@ RLEImage<TPixel, VImageDimension, CounterType>::CleanUp() const
   }
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 int
-RLEImage<TPixel, VImageDimension, CounterType>::SetPixel(RLLine &         line,
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetPixel(RLLine &         line,
                                                          IndexValueType & segmentRemainder,
                                                          SizeValueType &  m_RealIndex,
-                                                         const TPixel &   value)
+                                                         const TPixel &   pixel)
 {
   // complete Run-Length Lines have to be buffered
-  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(0) == this->GetLargestPossibleRegion().GetSize(0),
+  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(m_RunAxis) ==
+                          this->GetLargestPossibleRegion().GetSize(m_RunAxis),
                         "BufferedRegion must contain complete run-length lines!");
-  if (line[m_RealIndex].second == value) // already correct value
+  const RLValueType value = this->EncodeValue(pixel);
+  if constexpr (RLLine::StoresPixelRows)
+  {
+    const SizeValueType length = this->GetBufferedRegion().GetSize(m_RunAxis);
+    const SizeValueType oldSize = line.size();
+    if (static_cast<const RLLine &>(line).IsDense())
+    {
+      // each pixel is a segment of its own, written in place
+      line[m_RealIndex].second = value;
+      if (!RLLine::PrefersRuns(line.GetNumberOfRuns(), length))
+      {
+        return 0;
+      }
+      line.MakeRuns();
+      m_RealIndex = line.FindSegment(IndexValueType(m_RealIndex), segmentRemainder);
+    }
+    else
+    {
+      const int change = this->SetPixelInSegments(line, segmentRemainder, m_RealIndex, value);
+      if (change <= 0 || !RLLine::PrefersPixels(line.size(), length))
+      {
+        return change;
+      }
+      // in a dense line, the segment index is the position of the pixel
+      const RLLine & cline = line;
+      IndexValueType position = cline[m_RealIndex].first - segmentRemainder;
+      for (SizeValueType x = 0; x < m_RealIndex; x++)
+      {
+        position += cline[x].first;
+      }
+      line.MakeDense();
+      m_RealIndex = position;
+      segmentRemainder = 1;
+    }
+    return static_cast<int>(line.size()) - static_cast<int>(oldSize);
+  }
+  else
+  {
+    return this->SetPixelInSegments(line, segmentRemainder, m_RealIndex, value);
+  }
+} // >::SetPixel
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+int
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetPixelInSegments(RLLine &            line,
+                                                                          IndexValueType &    segmentRemainder,
+                                                                          SizeValueType &     m_RealIndex,
+                                                                          const RLValueType & value)
+{
+  // segments can only grow up to MaximumSegmentLength
+  auto hasRoom = [&line](SizeValueType x) { return static_cast<const RLLine &>(line)[x].first < MaximumSegmentLength; };
+  if (static_cast<const RLLine &>(line)[m_RealIndex].second == value) // already correct value
   {
     return 0;
   }
   else if (line[m_RealIndex].first == 1) // single pixel segment
   {
-    line[m_RealIndex].second = value;
-    if (m_OnTheFlyCleanup) // now see if we can merge it into adjacent segments
+    // see if we can merge it into adjacent segments, which alternating lines must do
+    if (m_OnTheFlyCleanup || RLLine::AlternatesValues)
     {
       if (m_RealIndex > 0 && m_RealIndex < line.size() - 1 && line[m_RealIndex + 1].second == value &&
-          line[m_RealIndex - 1].second == value)
+          line[m_RealIndex - 1].second == value &&
+          SizeValueType(line[m_RealIndex - 1].first) + line[m_RealIndex + 1].first < MaximumSegmentLength)
       {
         // merge these 3 segments
         line[m_RealIndex - 1].first += 1 + line[m_RealIndex + 1].first;
@@ -139,7 +600,7 @@ RLEImage<TPixel, VImageDimension, CounterType>::SetPixel(RLLine &         line,
         m_RealIndex--;
         return -2;
       }
-      if (m_RealIndex > 0 && line[m_RealIndex - 1].second == value)
+      if (m_RealIndex > 0 && line[m_RealIndex - 1].second == value && hasRoom(m_RealIndex - 1))
       {
         // merge into previous
         line[m_RealIndex - 1].first++;
@@ -148,7 +609,7 @@ RLEImage<TPixel, VImageDimension, CounterType>::SetPixel(RLLine &         line,
         assert(segmentRemainder == 1);
         return -1;
       }
-      else if (m_RealIndex < line.size() - 1 && line[m_RealIndex + 1].second == value)
+      else if (m_RealIndex < line.size() - 1 && line[m_RealIndex + 1].second == value && hasRoom(m_RealIndex + 1))
       {
         // merge into next
         segmentRemainder = ++(line[m_RealIndex + 1].first);
@@ -156,9 +617,11 @@ RLEImage<TPixel, VImageDimension, CounterType>::SetPixel(RLLine &         line,
         return -1;
       }
     }
+    line[m_RealIndex].second = value;
     return 0;
   }
-  else if (segmentRemainder == 1 && m_RealIndex < line.size() - 1 && line[m_RealIndex + 1].second == value)
+  else if (segmentRemainder == 1 && m_RealIndex < line.size() - 1 && line[m_RealIndex + 1].second == value &&
+           hasRoom(m_RealIndex + 1))
   {
     // shift this pixel to next segment
     line[m_RealIndex].first--;
@@ -166,7 +629,8 @@ RLEImage<TPixel, VImageDimension, CounterType>::SetPixel(RLLine &         line,
     m_RealIndex++;
     return 0;
   }
-  else if (m_RealIndex > 0 && segmentRemainder == line[m_RealIndex].first && line[m_RealIndex - 1].second == value)
+  else if (m_RealIndex > 0 && segmentRemainder == line[m_RealIndex].first && line[m_RealIndex - 1].second == value &&
+           hasRoom(m_RealIndex - 1))
   {
     // shift this pixel to previous segment
     line[m_RealIndex].first--;
@@ -202,78 +666,1220 @@ RLEImage<TPixel, VImageDimension, CounterType>::SetPixel(RLLine &         line,
     segmentRemainder = 1;
     return +2;
   }
-} // >::SetPixel
+} // >::SetPixelInSegments
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RLEImage<TPixel, VImageDimension, CounterType>::SetPixel(const IndexType & index, const TPixel & value)
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetPixel(const IndexType & index, const TPixel & value)
 {
   // complete Run-Length Lines have to be buffered
-  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(0) == this->GetLargestPossibleRegion().GetSize(0),
+  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(m_RunAxis) ==
+                          this->GetLargestPossibleRegion().GetSize(m_RunAxis),
                         "BufferedRegion must contain complete run-length lines!");
-  IndexValueType                 bri0 = this->GetBufferedRegion().GetIndex(0);
-  typename BufferType::IndexType bi = truncateIndex(index);
+  this->Thaw();
+  IndexValueType                 bri0 = this->GetBufferedRegion().GetIndex(m_RunAxis);
+  typename BufferType::IndexType bi = this->GetLineIndex(index);
   RLLine &                       line = m_Buffer->GetPixel(bi);
-  IndexValueType                 t = 0;
-  for (SizeValueType x = 0; x < line.size(); x++)
+  this->NoteSlabWrite(bi, value);
+  if (EditRow * row = this->GetEditRow(bi))
   {
-    t += line[x].first;
-    if (t > index[0] - bri0)
+    row->m_Values[index[m_RunAxis] - bri0] = this->EncodeValue(value);
+    row->m_Dirty = true;
+    return;
+  }
+  this->InvalidateLineHash(bi);
+  if (line.empty()) // absent line
+  {
+    if (value == this->DecodeValue(RLValueType()))
     {
-      t -= index[0] - bri0; // we need to supply a reference
-      SetPixel(line, t, x, value);
       return;
     }
+    line = m_AbsentLine;
+  }
+  IndexValueType t = 0;
+  SizeValueType  x = line.FindSegment(index[m_RunAxis] - bri0, t);
+  if (x < line.size())
+  {
+    SetPixel(line, t, x, value);
+    return;
   }
   throw itk::ExceptionObject(__FILE__, __LINE__, "Reached past the end of Run-Length line!", __FUNCTION__);
 } // >::SetPixel
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-const TPixel &
-RLEImage<TPixel, VImageDimension, CounterType>::GetPixel(const IndexType & index) const
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetRun(const IndexType &   index,
+                                                              SizeValueType       length,
+                                                              const TPixel &      value)
 {
   // complete Run-Length Lines have to be buffered
-  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(0) == this->GetLargestPossibleRegion().GetSize(0),
+  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(m_RunAxis) ==
+                          this->GetLargestPossibleRegion().GetSize(m_RunAxis),
                         "BufferedRegion must contain complete run-length lines!");
-  IndexValueType                 bri0 = this->GetBufferedRegion().GetIndex(0);
-  typename BufferType::IndexType bi = truncateIndex(index);
+  if (length == 0)
+  {
+    return;
+  }
+  this->Thaw();
+  IndexValueType                 bri0 = this->GetBufferedRegion().GetIndex(m_RunAxis);
+  typename BufferType::IndexType bi = this->GetLineIndex(index);
   RLLine &                       line = m_Buffer->GetPixel(bi);
-  IndexValueType                 t = 0;
-  for (SizeValueType x = 0; x < line.size(); x++)
+  this->NoteSlabWrite(bi, value);
+  if (EditRow * row = this->GetEditRow(bi))
   {
-    t += line[x].first;
-    if (t > index[0] - bri0)
+    itkAssertOrThrowMacro(index[m_RunAxis] - bri0 + length <= row->m_Values.size(), "Run must lie within its line!");
+    std::fill_n(row->m_Values.begin() + (index[m_RunAxis] - bri0), length, this->EncodeValue(value));
+    row->m_Dirty = true;
+    return;
+  }
+  this->InvalidateLineHash(bi);
+  const bool background = value == this->DecodeValue(RLValueType());
+  if (line.empty()) // absent line
+  {
+    if (background)
     {
-      return line[x].second;
+      return;
     }
+    line = m_AbsentLine;
   }
-  throw itk::ExceptionObject(__FILE__, __LINE__, "Reached past the end of Run-Length line!", __FUNCTION__);
-} // >::GetPixel
+  this->SetRun(line, index[m_RunAxis] - bri0, length, value);
+  if (background && m_SparseLines && this->IsBackgroundLine(line))
+  {
+    line = RLLine();
+  }
+} // >::SetRun
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RLEImage<TPixel, VImageDimension, CounterType>::PrintSelf(std::ostream & os, itk::Indent indent) const
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetRun(RLLine &       line,
+                                                              IndexValueType start,
+                                                              SizeValueType  length,
+                                                              const TPixel & pixel)
 {
-  Superclass::PrintSelf(os, indent);
-  os << indent << "Internal image (for storage of RLLine-s): " << std::endl;
-  m_Buffer->Print(os, indent.GetNextIndent());
-
-  itk::SizeValueType c = 0;
-  itk::SizeValueType pixelCount = this->GetOffsetTable()[VImageDimension];
+  const SizeValueType lineLength = this->GetBufferedRegion().GetSize(m_RunAxis);
+  itkAssertOrThrowMacro(start >= 0 && start + length <= lineLength, "Run must lie within its line!");
+  if (length == 0)
+  {
+    return;
+  }
+  const RLValueType value = this->EncodeValue(pixel);
 
-  itk::ImageRegionConstIterator<BufferType> it(m_Buffer, m_Buffer->GetBufferedRegion());
-  while (!it.IsAtEnd())
+  if constexpr (RLLine::AlternatesValues)
   {
-    c += it.Get().capacity();
-    ++it;
+    // adjacent segments must differ, so the line is rebuilt with merging appends
+    RLLine run;
+    AppendRun(run, length, value);
+    this->SetRuns(line, start, run);
   }
+  else
+  {
+    const RLLine &       cline = line; // reading does not unshare the line
+    const IndexValueType end = start + IndexValueType(length);
+    if constexpr (RLLine::StoresPixelRows)
+    {
+      if (cline.IsDense())
+      {
+        line.MakeRuns();
+      }
+    }
 
-  itk::SizeValueType memUsed =
-    c * sizeof(RLSegment) + sizeof(std::vector<RLLine>) * (pixelCount / this->GetOffsetTable()[1]);
-  double cr = double(memUsed) / (pixelCount * sizeof(PixelType));
+    // the run replaces segments first to last, keeping their pixels outside of it
+    IndexValueType    headRemainder = 0;
+    IndexValueType    tailRemainder = 0;
+    SizeValueType     first = cline.FindSegment(start, headRemainder);
+    SizeValueType     last = cline.FindSegment(end - 1, tailRemainder);
+    SizeValueType     head = cline[first].first - headRemainder;
+    SizeValueType     tail = tailRemainder - 1;
+    const RLValueType headValue = cline[first].second;
+    const RLValueType tailValue = cline[last].second;
+    SizeValueType     run = length;
 
-  os << indent << "OnTheFlyCleanup: " << (m_OnTheFlyCleanup ? "On" : "Off") << std::endl;
-  os << indent << "RLSegment count: " << c << std::endl;
+    // pixels of the first and last segment which have the value join the run
+    if (headValue == value)
+    {
+      run += head;
+      head = 0;
+    }
+    if (tailValue == value)
+    {
+      run += tail;
+      tail = 0;
+    }
+    // and so do the segments next to the pieces, several if long runs were split
+    while (m_OnTheFlyCleanup && first > 0 && cline[first - 1].second == (head > 0 ? headValue : value))
+    {
+      (head > 0 ? head : run) += cline[--first].first;
+    }
+    while (m_OnTheFlyCleanup && last + 1 < cline.size() && cline[last + 1].second == (tail > 0 ? tailValue : value))
+    {
+      (tail > 0 ? tail : run) += cline[++last].first;
+    }
+
+    // make room for the new segments, then fill them in
+    auto segmentsFor = [](SizeValueType count) { return (count + MaximumSegmentLength - 1) / MaximumSegmentLength; };
+    const SizeValueType oldCount = last - first + 1;
+    const SizeValueType newCount = segmentsFor(head) + segmentsFor(run) + segmentsFor(tail);
+    if (newCount > oldCount)
+    {
+      line.insert(line.begin() + first + oldCount, newCount - oldCount, RLSegment(0, value));
+    }
+    else if (newCount < oldCount)
+    {
+      line.erase(line.begin() + first + newCount, line.begin() + first + oldCount);
+    }
+    SizeValueType x = first;
+    auto          fill = [&line, &x](SizeValueType count, const RLValueType & segmentValue) {
+      for (; count > 0; x++)
+      {
+        const SizeValueType segmentCount = std::min(count, MaximumSegmentLength);
+        line[x].first = CounterType(segmentCount);
+        line[x].second = segmentValue;
+        count -= segmentCount;
+      }
+    };
+    fill(head, headValue);
+    fill(run, value);
+    fill(tail, tailValue);
+
+    if constexpr (RLLine::StoresPixelRows)
+    {
+      if (RLLine::PrefersPixels(line.size(), lineLength))
+      {
+        line.MakeDense();
+      }
+    }
+  }
+} // >::SetRun
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetRuns(const IndexType & index, const RLLine & runs)
+{
+  // complete Run-Length Lines have to be buffered
+  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(m_RunAxis) ==
+                          this->GetLargestPossibleRegion().GetSize(m_RunAxis),
+                        "BufferedRegion must contain complete run-length lines!");
+  if (runs.empty())
+  {
+    return;
+  }
+  this->Thaw();
+  IndexValueType                 bri0 = this->GetBufferedRegion().GetIndex(m_RunAxis);
+  typename BufferType::IndexType bi = this->GetLineIndex(index);
+  RLLine &                       line = m_Buffer->GetPixel(bi);
+  bool                           background = true;
+  for (SizeValueType x = 0; x < runs.size(); x++)
+  {
+    const TPixel & value = this->DecodeValue(runs[x].second);
+    this->NoteSlabWrite(bi, value);
+    background = background && value == this->DecodeValue(RLValueType());
+  }
+  if (EditRow * row = this->GetEditRow(bi))
+  {
+    auto position = row->m_Values.begin() + (index[m_RunAxis] - bri0);
+    for (SizeValueType x = 0; x < runs.size(); x++)
+    {
+      itkAssertOrThrowMacro(row->m_Values.end() - position >= runs[x].first, "Runs must lie within their line!");
+      position = std::fill_n(position, runs[x].first, runs[x].second);
+    }
+    row->m_Dirty = true;
+    return;
+  }
+  this->InvalidateLineHash(bi);
+  if (line.empty()) // absent line
+  {
+    if (background)
+    {
+      return;
+    }
+    line = m_AbsentLine;
+  }
+  this->SetRuns(line, index[m_RunAxis] - bri0, runs);
+  if (m_SparseLines && this->IsBackgroundLine(line))
+  {
+    line = RLLine();
+  }
+} // >::SetRuns
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetRuns(RLLine &       line,
+                                                               IndexValueType start,
+                                                               const RLLine & runs)
+{
+  SizeValueType length = 0;
+  for (SizeValueType r = 0; r < runs.size(); r++)
+  {
+    length += runs[r].first;
+  }
+  const SizeValueType lineLength = this->GetBufferedRegion().GetSize(m_RunAxis);
+  itkAssertOrThrowMacro(start >= 0 && start + length <= lineLength, "Runs must lie within their line!");
+  if (length == 0)
+  {
+    return;
+  }
+  const RLLine & cline = line; // reading does not unshare the line
+  if constexpr (RLLine::StoresPixelRows)
+  {
+    if (cline.IsDense())
+    {
+      line.MakeRuns();
+    }
+  }
+
+  // the segments before and after the runs are kept, the pieces of those they cut too
+  const IndexValueType end = start + IndexValueType(length);
+  RLLine               out;
+  SizeValueType        x = 0;
+  IndexValueType       t = 0; // start of segment x
+  out.reserve(cline.size() + runs.size() + 1);
+  for (; t + cline[x].first <= start; t += cline[x++].first)
+  {
+    AppendRun(out, cline[x].first, cline[x].second);
+  }
+  if (t < start)
+  {
+    AppendRun(out, start - t, cline[x].second);
+  }
+  for (SizeValueType r = 0; r < runs.size(); r++)
+  {
+    AppendRun(out, runs[r].first, runs[r].second);
+  }
+  while (x < cline.size() && t + cline[x].first <= end)
+  {
+    t += cline[x++].first;
+  }
+  if (x < cline.size())
+  {
+    AppendRun(out, t + cline[x].first - end, cline[x].second);
+  }
+  for (x++; x < cline.size(); x++)
+  {
+    AppendRun(out, cline[x].first, cline[x].second);
+  }
+  line = out;
+
+  if constexpr (RLLine::StoresPixelRows)
+  {
+    if (RLLine::PrefersPixels(line.size(), lineLength))
+    {
+      line.MakeDense();
+    }
+  }
+} // >::SetRuns
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetPixels(const std::vector<PixelEdit> & edits, bool inParallel)
+{
+  // complete Run-Length Lines have to be buffered
+  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(m_RunAxis) ==
+                          this->GetLargestPossibleRegion().GetSize(m_RunAxis),
+                        "BufferedRegion must contain complete run-length lines!");
+  if (edits.empty())
+  {
+    return;
+  }
+  this->Thaw();
+
+  // bucket the edits by line, keeping the order of the edits of each line
+  struct Edit
+  {
+    IndexValueType m_Position; // within the line
+    RLValueType    m_Value;
+  };
+  const RegionType &           bufferedRegion = this->GetBufferedRegion();
+  std::vector<OffsetValueType> editLines(edits.size());
+  std::vector<SizeValueType>   lineEdits(m_Buffer->GetBufferedRegion().GetNumberOfPixels() + 1, 0);
+  for (SizeValueType e = 0; e < edits.size(); e++)
+  {
+    const IndexType & index = edits[e].first;
+    itkAssertOrThrowMacro(bufferedRegion.IsInside(index),
+                          "Index " << index << " is outside of buffered region " << bufferedRegion);
+    editLines[e] = m_Buffer->ComputeOffset(this->GetLineIndex(index));
+    lineEdits[editLines[e] + 1]++;
+  }
+  for (SizeValueType i = 1; i < lineEdits.size(); i++)
+  {
+    lineEdits[i] += lineEdits[i - 1]; // now the first edit of every line
+  }
+  std::vector<Edit>          order(edits.size());
+  std::vector<SizeValueType> next(lineEdits.begin(), lineEdits.end() - 1);
+  for (SizeValueType e = 0; e < edits.size(); e++)
+  {
+    order[next[editLines[e]]++] = Edit{ edits[e].first[m_RunAxis] - bufferedRegion.GetIndex(m_RunAxis),
+                                        this->EncodeValue(edits[e].second) };
+  }
+
+  RLLine *            lines = m_Buffer->GetBufferPointer();
+  const SizeValueType lineLength = bufferedRegion.GetSize(m_RunAxis);
+  auto                editLine = [&](SizeValueType i) {
+    const SizeValueType first = lineEdits[i];
+    const SizeValueType end = lineEdits[i + 1];
+    if (first == end)
+    {
+      return;
+    }
+    // by position, later edits of a pixel after earlier ones
+    std::stable_sort(order.begin() + first, order.begin() + end, [](const Edit & a, const Edit & b) {
+      return a.m_Position < b.m_Position;
+    });
+    RLLine &                             line = lines[i];
+    const typename BufferType::IndexType bi = m_Buffer->ComputeIndex(OffsetValueType(i));
+    bool                                 background = true;
+    for (SizeValueType e = first; e < end; e++)
+    {
+      const TPixel & value = this->DecodeValue(order[e].m_Value);
+      this->NoteSlabWrite(bi, value);
+      background = background && value == this->DecodeValue(RLValueType());
+    }
+    if (EditRow * row = this->GetEditRow(bi))
+    {
+      for (SizeValueType e = first; e < end; e++)
+      {
+        row->m_Values[order[e].m_Position] = order[e].m_Value;
+      }
+      row->m_Dirty = true;
+      return;
+    }
+    this->InvalidateLineHash(bi);
+    if (line.empty()) // absent line
+    {
+      if (background)
+      {
+        return;
+      }
+      line = m_AbsentLine;
+    }
+    const RLLine & cline = line; // reading does not unshare the line
+    if constexpr (RLLine::StoresPixelRows)
+    {
+      if (cline.IsDense())
+      {
+        line.MakeRuns();
+      }
+    }
+
+    // merge the edits into the segments, copying the pixels in between
+    RLLine         out;
+    SizeValueType  x = 0;
+    IndexValueType segmentEnd = cline[0].first;
+    IndexValueType t = 0; // next pixel to copy
+    auto           copyUpTo = [&](IndexValueType position) {
+      while (t < position)
+      {
+        while (segmentEnd <= t)
+        {
+          segmentEnd += cline[++x].first;
+        }
+        const IndexValueType next = std::min(segmentEnd, position);
+        AppendRun(out, next - t, cline[x].second);
+        t = next;
+      }
+    };
+    out.reserve(cline.size() + 2 * (end - first));
+    for (SizeValueType e = first; e < end; e++)
+    {
+      if (e + 1 < end && order[e + 1].m_Position == order[e].m_Position)
+      {
+        continue; // a later edit sets this pixel
+      }
+      copyUpTo(order[e].m_Position);
+      AppendRun(out, 1, order[e].m_Value);
+      t++;
+    }
+    copyUpTo(lineLength);
+    line = out;
+
+    if constexpr (RLLine::StoresPixelRows)
+    {
+      if (RLLine::PrefersPixels(line.size(), lineLength))
+      {
+        line.MakeDense();
+      }
+    }
+    if (m_SparseLines && this->IsBackgroundLine(line))
+    {
+      line = RLLine();
+    }
+  };
+
+  const SizeValueType lineCount = lineEdits.size() - 1;
+  if (inParallel)
+  {
+    MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+    mt->ParallelizeArray(0, lineCount, editLine, nullptr);
+  }
+  else
+  {
+    for (SizeValueType i = 0; i < lineCount; i++)
+    {
+      editLine(i);
+    }
+  }
+} // >::SetPixels
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetSlice(const SliceImageType * slice,
+                                                                unsigned int           axis,
+                                                                IndexValueType         position,
+                                                                bool                   inParallel)
+{
+  // complete Run-Length Lines have to be buffered
+  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(m_RunAxis) ==
+                          this->GetLargestPossibleRegion().GetSize(m_RunAxis),
+                        "BufferedRegion must contain complete run-length lines!");
+  itkAssertOrThrowMacro(slice != nullptr && axis < VImageDimension, "A slice and an axis of the image are required!");
+  const typename SliceImageType::RegionType & sliceRegion = slice->GetBufferedRegion();
+  if (sliceRegion.GetNumberOfPixels() == 0)
+  {
+    return;
+  }
+
+  // the slice is the plane at position along axis, spanned by the other axes
+  RegionType region;
+  for (unsigned int d = 0, k = 0; d < VImageDimension; d++)
+  {
+    region.SetIndex(d, d == axis ? position : sliceRegion.GetIndex(k));
+    region.SetSize(d, d == axis ? 1 : sliceRegion.GetSize(k++));
+  }
+  itkAssertOrThrowMacro(this->GetBufferedRegion().IsInside(region),
+                        "Slice region " << region << " is outside of buffered region " << this->GetBufferedRegion());
+  this->Thaw();
+
+  // new values are added to the palette here, so that rows can be written in parallel
+  const TPixel *           pixels = slice->GetBufferPointer();
+  std::vector<RLValueType> stored;
+  if constexpr (IsPaletteEncoded)
+  {
+    stored.resize(sliceRegion.GetNumberOfPixels());
+    for (SizeValueType i = 0; i < stored.size(); i++)
+    {
+      stored[i] = i > 0 && IsSamePixel(pixels[i], pixels[i - 1]) ? stored[i - 1] : this->EncodeValue(pixels[i]);
+    }
+  }
+  auto storedAt = [pixels, &stored](OffsetValueType offset) -> const RLValueType & {
+    if constexpr (IsPaletteEncoded)
+    {
+      return stored[offset];
+    }
+    else
+    {
+      return pixels[offset];
+    }
+  };
+  auto same = [](const RLValueType & a, const RLValueType & b) {
+    if constexpr (IsPaletteEncoded)
+    {
+      return a == b;
+    }
+    else
+    {
+      return IsSamePixel(a, b);
+    }
+  };
+
+  // rows of the slice go along the run axis, or along its first axis
+  // if the slice is normal to the run axis, so no two rows share a line
+  const unsigned int    rowAxis = axis == m_RunAxis ? 0 : (m_RunAxis < axis ? m_RunAxis : m_RunAxis - 1);
+  const unsigned int    rowImageAxis = rowAxis < axis ? rowAxis : rowAxis + 1;
+  const SizeValueType   rowLength = sliceRegion.GetSize(rowAxis);
+  const SizeValueType   rowCount = sliceRegion.GetNumberOfPixels() / rowLength;
+  const OffsetValueType stride = slice->GetOffsetTable()[rowAxis];
+  auto                  setRow = [&](SizeValueType r) {
+    typename SliceImageType::IndexType sliceIndex = sliceRegion.GetIndex();
+    for (unsigned int k = 0; k < VImageDimension - 1; k++)
+    {
+      if (k != rowAxis)
+      {
+        sliceIndex[k] += IndexValueType(r % sliceRegion.GetSize(k));
+        r /= sliceRegion.GetSize(k);
+      }
+    }
+    IndexType index;
+    for (unsigned int d = 0, k = 0; d < VImageDimension; d++)
+    {
+      index[d] = d == axis ? position : sliceIndex[k++];
+    }
+    OffsetValueType offset = slice->ComputeOffset(sliceIndex);
+
+    if (axis == m_RunAxis) // every pixel of the row is in another line, of which it is all that changes
+    {
+      for (SizeValueType x = 0; x < rowLength; x++, offset += stride)
+      {
+        this->SetPixel(index, pixels[offset]); // its value is in the palette already
+        index[rowImageAxis]++;
+      }
+      return;
+    }
+
+    // the row becomes runs of stored values, which replace its pixels in one pass over the line
+    RLLine runs;
+    for (SizeValueType x = 0; x < rowLength;)
+    {
+      const RLValueType & value = storedAt(offset);
+      SizeValueType       count = 0;
+      for (; x < rowLength && same(storedAt(offset), value); x++, count++)
+      {
+        offset += stride;
+      }
+      AppendRun(runs, count, value);
+    }
+    this->SetRuns(index, runs);
+  };
+
+  if (inParallel)
+  {
+    MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+    mt->ParallelizeArray(0, rowCount, setRow, nullptr);
+  }
+  else
+  {
+    for (SizeValueType r = 0; r < rowCount; r++)
+    {
+      setRow(r);
+    }
+  }
+} // >::SetSlice
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+auto
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::GetEditLineIndex(SizeValueType row) const
+  -> typename BufferType::IndexType
+{
+  typename BufferType::IndexType lineIndex = m_EditLines.GetIndex();
+  for (unsigned int k = 0; k < VImageDimension - 1; k++)
+  {
+    lineIndex[k] += IndexValueType(row % m_EditLines.GetSize(k));
+    row /= m_EditLines.GetSize(k);
+  }
+  return lineIndex;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::BeginEdit(const RegionType & region)
+{
+  // complete Run-Length Lines have to be buffered
+  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(m_RunAxis) ==
+                          this->GetLargestPossibleRegion().GetSize(m_RunAxis),
+                        "BufferedRegion must contain complete run-length lines!");
+  itkAssertOrThrowMacro(this->GetBufferedRegion().IsInside(region),
+                        "Region " << region << " is outside of buffered region " << this->GetBufferedRegion());
+  this->EndEdit();
+  this->Thaw();
+  m_EditLines = region.Slice(m_RunAxis);
+  m_EditRows = std::vector<EditRow>(m_EditLines.GetNumberOfPixels());
+  m_EditGeneration++;
+
+  const SizeValueType        lineLength = this->GetBufferedRegion().GetSize(m_RunAxis);
+  MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+  mt->ParallelizeArray(
+    0,
+    m_EditRows.size(),
+    [this, lineLength](SizeValueType i) {
+      const RLLine &             line = this->ResolveLine(m_Buffer->GetPixel(this->GetEditLineIndex(i)));
+      std::vector<RLValueType> & values = m_EditRows[i].m_Values;
+      values.reserve(lineLength);
+      for (SizeValueType x = 0; x < line.size(); x++)
+      {
+        values.insert(values.end(), line[x].first, line[x].second);
+      }
+    },
+    nullptr);
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::EndEdit()
+{
+  if (m_EditRows.empty())
+  {
+    return;
+  }
+  MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+  mt->ParallelizeArray(
+    0,
+    m_EditRows.size(),
+    [this](SizeValueType i) {
+      const std::vector<RLValueType> & values = m_EditRows[i].m_Values;
+      if (!m_EditRows[i].m_Dirty)
+      {
+        return;
+      }
+      RLLine line;
+      for (SizeValueType x = 0, next = 1; x < values.size(); x = next++)
+      {
+        while (next < values.size() && values[next] == values[x])
+        {
+          next++;
+        }
+        AppendRun(line, next - x, values[x]);
+      }
+      if constexpr (RLLine::StoresPixelRows)
+      {
+        if (RLLine::PrefersPixels(line.size(), values.size()))
+        {
+          line.MakeDense();
+        }
+      }
+      if (m_SparseLines && this->IsBackgroundLine(line))
+      {
+        line = RLLine();
+      }
+      const typename BufferType::IndexType lineIndex = this->GetEditLineIndex(i);
+      m_Buffer->GetPixel(lineIndex) = line;
+      this->InvalidateLineHash(lineIndex);
+    },
+    nullptr);
+  m_EditRows = std::vector<EditRow>(); // releases the rows
+  m_EditGeneration++;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+const TPixel &
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::GetPixel(const IndexType & index) const
+{
+  // complete Run-Length Lines have to be buffered
+  itkAssertOrThrowMacro(this->GetBufferedRegion().GetSize(m_RunAxis) ==
+                          this->GetLargestPossibleRegion().GetSize(m_RunAxis),
+                        "BufferedRegion must contain complete run-length lines!");
+  IndexValueType                 bri0 = this->GetBufferedRegion().GetIndex(m_RunAxis);
+  typename BufferType::IndexType bi = this->GetLineIndex(index);
+  if (this->IsFrozen())
+  {
+    return this->DecodeValue(m_FrozenLines->GetPixel(m_Buffer->ComputeOffset(bi), index[m_RunAxis] - bri0));
+  }
+  if (const EditRow * row = this->GetEditRow(bi))
+  {
+    return this->DecodeValue(row->GetValue(index[m_RunAxis] - bri0));
+  }
+  const RLLine & line = this->ResolveLine(m_Buffer->GetPixel(bi));
+  IndexValueType t = 0;
+  SizeValueType  x = line.FindSegment(index[m_RunAxis] - bri0, t);
+  if (x < line.size())
+  {
+    return this->DecodeValue(line[x].second);
+  }
+  throw itk::ExceptionObject(__FILE__, __LINE__, "Reached past the end of Run-Length line!", __FUNCTION__);
+} // >::GetPixel
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+auto
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::GetLine(const typename BufferType::IndexType & index,
+                                                               RLLine &                               scratch) const
+  -> const RLLine &
+{
+  if (this->IsFrozen())
+  {
+    m_FrozenLines->Decode(m_Buffer->ComputeOffset(index), scratch);
+    return scratch;
+  }
+  return this->ResolveLine(m_Buffer->GetPixel(index));
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::InvalidateLineHashes()
+{
+  for (auto & hash : m_LineHashes)
+  {
+    hash.store(0, std::memory_order_relaxed);
+  }
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+std::size_t
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::ComputeLineHash(const RLLine & line) const
+{
+  // FNV-1a over the runs of equal pixels, so the segmentation does not matter
+  std::uint64_t hash = 14695981039346656037ULL;
+  auto          mix = [&hash](std::uint64_t word) {
+    hash ^= word;
+    hash *= 1099511628211ULL;
+  };
+  auto mixRun = [&mix](SizeValueType length, const TPixel & value) {
+    mix(length);
+    if constexpr (std::is_scalar<TPixel>::value)
+    {
+      mix(std::hash<TPixel>()(value)); // equal values like 0.0 and -0.0 hash alike
+    }
+    else if constexpr (HasBytewisePixels)
+    {
+      const auto * bytes = reinterpret_cast<const unsigned char *>(&value);
+      for (SizeValueType b = 0; b < sizeof(TPixel); b++)
+      {
+        mix(bytes[b]);
+      }
+    }
+    else // e.g. vectors of floats
+    {
+      using ComponentType = std::decay_t<decltype(value[0])>;
+      for (unsigned int c = 0; c < itk::NumericTraits<TPixel>::GetLength(value); c++)
+      {
+        mix(std::hash<ComponentType>()(value[c]));
+      }
+    }
+  };
+
+  SizeValueType runLength = 0;
+  TPixel        runValue{};
+  for (SizeValueType x = 0; x < line.size(); x++)
+  {
+    const SizeValueType length = line[x].first;
+    if (length == 0)
+    {
+      continue;
+    }
+    const TPixel value = this->DecodeValue(line[x].second);
+    if (runLength > 0 && value == runValue)
+    {
+      runLength += length;
+      continue;
+    }
+    if (runLength > 0)
+    {
+      mixRun(runLength, runValue);
+    }
+    runLength = length;
+    runValue = value;
+  }
+  mixRun(runLength, runValue);
+
+  const auto result = static_cast<std::size_t>(hash ^ (hash >> 32));
+  return result == 0 ? 1 : result; // zero marks hashes which are not computed
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+std::size_t
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::GetLineHash(
+  const typename BufferType::IndexType & lineIndex) const
+{
+  const SizeValueType offset = m_Buffer->ComputeOffset(lineIndex);
+  if (!m_LineHashes.empty())
+  {
+    const std::size_t cached = m_LineHashes[offset].load(std::memory_order_relaxed);
+    if (cached != 0)
+    {
+      return cached;
+    }
+  }
+
+  RLLine            scratch;
+  const std::size_t hash = this->ComputeLineHash(this->GetLine(lineIndex, scratch));
+  if (!m_LineHashes.empty())
+  {
+    m_LineHashes[offset].store(hash, std::memory_order_relaxed);
+  }
+  return hash;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+bool
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::IsSameLine(const RLLine & line,
+                                                                  const Self *   other,
+                                                                  const RLLine & otherLine) const
+{
+  // walk both lines a run at a time, they can be segmented differently
+  SizeValueType x = 0;
+  SizeValueType y = 0;
+  SizeValueType left = 0; // pixels left in segment x - 1
+  SizeValueType otherLeft = 0;
+  while (true)
+  {
+    for (; left == 0 && x < line.size(); x++)
+    {
+      left = line[x].first;
+    }
+    for (; otherLeft == 0 && y < otherLine.size(); y++)
+    {
+      otherLeft = otherLine[y].first;
+    }
+    if (left == 0 || otherLeft == 0)
+    {
+      return left == otherLeft;
+    }
+    if (!(this->DecodeValue(line[x - 1].second) == other->DecodeValue(otherLine[y - 1].second)))
+    {
+      return false;
+    }
+    const SizeValueType step = std::min(left, otherLeft);
+    left -= step;
+    otherLeft -= step;
+  }
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+auto
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::CompareLines(const Self * other, bool stopAtFirst) const
+  -> std::vector<SizeValueType>
+{
+  itkAssertOrThrowMacro(other != nullptr, "Nothing to compare with!");
+  itkAssertOrThrowMacro(other->GetBufferedRegion().GetSize() == this->GetBufferedRegion().GetSize(),
+                        "Compared images must have the same buffered size!");
+  itkAssertOrThrowMacro(other->GetRunAxis() == m_RunAxis, "Compared images must have the same run axis!");
+
+  // hashes computed from now on are kept until the lines are written to
+  const SizeValueType lineCount = m_Buffer->GetBufferedRegion().GetNumberOfPixels();
+  for (const Self * image : { this, other })
+  {
+    // comparisons running in other threads may be making room too, once it is there it stays
+    std::lock_guard<std::mutex> lock(image->m_LineHashesMutex);
+    if (image->m_LineHashes.size() != lineCount)
+    {
+      image->m_LineHashes = std::vector<std::atomic<std::size_t>>(lineCount);
+    }
+  }
+
+  std::vector<SizeValueType> differing;
+  std::mutex                 differingMutex;
+  std::atomic<bool>          found{ false };
+  MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+  mt->ParallelizeArray(
+    0,
+    lineCount,
+    [&](SizeValueType i) {
+      if (stopAtFirst && found.load(std::memory_order_relaxed))
+      {
+        return;
+      }
+      // the buffered regions of the images can start at different indices
+      const typename BufferType::IndexType index = m_Buffer->ComputeIndex(i);
+      const typename BufferType::IndexType otherIndex = other->m_Buffer->ComputeIndex(i);
+      RLLine                               scratch;
+      RLLine                               otherScratch;
+      const RLLine &                       line = this->GetLine(index, scratch);
+      const RLLine &                       otherLine = other->GetLine(otherIndex, otherScratch);
+      bool                                 same = false;
+      if constexpr (!IsPaletteEncoded)
+      {
+        same = line == otherLine; // cheap when they share their storage
+      }
+      if (!same)
+      {
+        same = this->GetLineHash(index) == other->GetLineHash(otherIndex) &&
+               this->IsSameLine(line, other, otherLine);
+      }
+      if (!same)
+      {
+        found.store(true, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(differingMutex);
+        differing.push_back(i);
+      }
+    },
+    nullptr);
+  std::sort(differing.begin(), differing.end());
+  return differing;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+bool
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::IsSameContent(const Self * other) const
+{
+  if (other == nullptr || other->GetBufferedRegion().GetSize() != this->GetBufferedRegion().GetSize())
+  {
+    return false;
+  }
+  return this->CompareLines(other, true).empty();
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+auto
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::GetDifferingLines(const Self * other) const
+  -> std::vector<typename BufferType::IndexType>
+{
+  std::vector<typename BufferType::IndexType> lines;
+  for (SizeValueType i : this->CompareLines(other, false))
+  {
+    lines.push_back(m_Buffer->ComputeIndex(i));
+  }
+  return lines;
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::Freeze()
+{
+  if (this->IsFrozen())
+  {
+    return;
+  }
+  this->EndEdit();
+
+  auto           frozen = std::make_unique<FrozenLinesType>();
+  SizeValueType  lineCount = m_Buffer->GetBufferedRegion().GetNumberOfPixels();
+  const RLLine * lines = m_Buffer->GetBufferPointer();
+  for (SizeValueType i = 0; i < lineCount; i++)
+  {
+    frozen->Append(this->ResolveLine(lines[i]));
+  }
+  frozen->FinishAppending();
+  m_FrozenLines = std::move(frozen);
+
+  // release the lines, then the arenas they might refer to
+  m_Buffer->SetPixelContainer(BufferType::PixelContainer::New());
+  m_SegmentArenas.clear();
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::Thaw()
+{
+  if (!this->IsFrozen())
+  {
+    return;
+  }
+
+  this->AllocateLines();
+  RLLine *                   lines = m_Buffer->GetBufferPointer();
+  MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+  mt->ParallelizeArray(
+    0,
+    m_FrozenLines->GetNumberOfLines(),
+    [this, lines](SizeValueType i) {
+      m_FrozenLines->Decode(i, lines[i]);
+      if (m_SparseLines && this->IsBackgroundLine(lines[i]))
+      {
+        lines[i] = RLLine();
+      }
+      else if constexpr (RLLine::StoresPixelRows)
+      {
+        lines[i].shrink_to_fit(); // noisy lines become rows of pixels again
+      }
+    },
+    nullptr);
+  m_FrozenLines.reset();
+  m_AbsentLinesLeft = false; // all lines were decoded
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+auto
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::EncodeValue(const TPixel & value) -> RLValueType
+{
+  if constexpr (IsPaletteEncoded)
+  {
+    std::lock_guard<std::mutex> lock(m_PaletteMutex);
+    auto                        found = m_PaletteIndices.find(value);
+    if (found != m_PaletteIndices.end())
+    {
+      return found->second;
+    }
+    if (!m_FreePaletteIndices.empty()) // freed by ReplaceValue(), no segment refers to it
+    {
+      const RLValueType index = m_FreePaletteIndices.back();
+      m_FreePaletteIndices.pop_back();
+      m_Palette[index] = value;
+      m_PaletteIndices.emplace(value, index);
+      return index;
+    }
+    if (m_Palette.size() >= PaletteCapacity)
+    {
+      throw itk::ExceptionObject(__FILE__, __LINE__, "Palette is full, use a larger index type!", __FUNCTION__);
+    }
+    const auto index = static_cast<RLValueType>(m_Palette.size());
+    m_Palette.push_back(value);
+    m_PaletteIndices.emplace(value, index);
+    return index;
+  }
+  else
+  {
+    return value;
+  }
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::SetPalette(const std::vector<TPixel> & palette)
+{
+  if constexpr (IsPaletteEncoded)
+  {
+    itkAssertOrThrowMacro(palette.size() <= PaletteCapacity, "Palette has more values than indices!");
+    std::lock_guard<std::mutex> lock(m_PaletteMutex);
+    m_Palette.clear();
+    m_Palette.reserve(PaletteCapacity); // never reallocated while pixels are read
+    m_Palette.insert(m_Palette.end(), palette.begin(), palette.end());
+    m_PaletteIndices.clear();
+    m_FreePaletteIndices.clear();
+    for (SizeValueType i = 0; i < m_Palette.size(); i++)
+    {
+      m_PaletteIndices.emplace(m_Palette[i], static_cast<RLValueType>(i)); // keeps the first of equal values
+    }
+    this->InvalidateLineHashes(); // stored values mean other pixels now
+  }
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::ResetPalette()
+{
+  if constexpr (IsPaletteEncoded)
+  {
+    this->SetPalette(std::vector<TPixel>(1, TPixel()));
+  }
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::ReplaceValue(const TPixel & from, const TPixel & to)
+{
+  this->EndEdit();
+  this->InvalidateLineHashes();
+  if constexpr (IsPaletteEncoded)
+  {
+    RLValueType dropped;
+    RLValueType kept;
+    {
+      std::lock_guard<std::mutex> lock(m_PaletteMutex);
+      auto                        found = m_PaletteIndices.find(from);
+      if (found == m_PaletteIndices.end() || from == to)
+      {
+        return;
+      }
+      const RLValueType index = found->second;
+      m_PaletteIndices.erase(found);
+      auto existing = m_PaletteIndices.find(to);
+      if (existing == m_PaletteIndices.end())
+      {
+        m_Palette[index] = to;
+        m_PaletteIndices.emplace(to, index);
+        return;
+      }
+      // both values are in the palette: the lower index keeps to (so index 0 is never freed),
+      // the other one is freed for the next new value once no segment refers to it
+      kept = std::min(index, existing->second);
+      dropped = std::max(index, existing->second);
+      m_Palette[kept] = to;
+      existing->second = kept;
+      m_FreePaletteIndices.push_back(dropped);
+    }
+    this->ReplaceStoredValue(dropped, kept);
+  }
+  else if (!(from == to))
+  {
+    this->ReplaceStoredValue(from, to);
+  }
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::ReplaceStoredValue(const RLValueType & from,
+                                                                          const RLValueType & to)
+{
+  this->Thaw();
+  RLLine *                   lines = m_Buffer->GetBufferPointer();
+  const SizeValueType        lineLength = this->GetBufferedRegion().GetSize(m_RunAxis);
+  MultiThreaderBase::Pointer mt = MultiThreaderBase::New();
+  mt->ParallelizeArray(
+    0,
+    m_Buffer->GetBufferedRegion().GetNumberOfPixels(),
+    [this, lines, lineLength, &from, &to](SizeValueType i) {
+      if constexpr (RLLine::AlternatesValues)
+      {
+        // a binary line with segments of value from becomes uniform
+        const RLLine & cline = this->ResolveLine(lines[i]);
+        if (cline.front().second == from || cline.size() > 1)
+        {
+          RLLine line;
+          AppendRun(line, lineLength, to);
+          lines[i] = line;
+        }
+      }
+      else
+      {
+        if (lines[i].empty()) // absent line
+        {
+          if (!(from == RLValueType()))
+          {
+            return;
+          }
+          lines[i] = m_AbsentLine;
+        }
+        const RLLine & cline = lines[i]; // reading does not unshare the line
+        bool           changed = false;
+        for (SizeValueType x = 0; x < cline.size(); x++)
+        {
+          if (cline[x].second == from)
+          {
+            lines[i][x].second = to;
+            changed = true;
+          }
+        }
+        if (changed && m_OnTheFlyCleanup)
+        {
+          this->CleanUpLine(lines[i]);
+        }
+      }
+    },
+    nullptr);
+
+  for (auto & slab : m_Slabs) // mixed slabs stay mixed
+  {
+    if (slab.m_Value == from)
+    {
+      slab.m_Value = to;
+    }
+  }
+}
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+void
+RLEImage<TPixel, VImageDimension, CounterType, TLine>::PrintSelf(std::ostream & os, itk::Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Internal image (for storage of RLLine-s): " << std::endl;
+  m_Buffer->Print(os, indent.GetNextIndent());
+
+  itk::SizeValueType c = 0;
+  itk::SizeValueType absentCount = 0;
+  itk::SizeValueType pixelCount = this->GetOffsetTable()[VImageDimension];
+
+  if (!this->IsFrozen()) // a frozen image has no lines in the buffer
+  {
+    itk::ImageRegionConstIterator<BufferType> it(m_Buffer, m_Buffer->GetBufferedRegion());
+    while (!it.IsAtEnd())
+    {
+      c += it.Value().size();
+      absentCount += it.Value().empty();
+      ++it;
+    }
+  }
+
+  itk::SizeValueType arenaBytes = 0;
+  for (const auto & arena : m_SegmentArenas)
+  {
+    arenaBytes += arena.GetNumberOfBytes();
+  }
+
+  itk::SizeValueType uniformSlabs = 0;
+  for (const auto & slab : m_Slabs)
+  {
+    uniformSlabs += !slab.m_Mixed.load(std::memory_order_relaxed);
+  }
+
+  itk::SizeValueType frozenBytes = this->IsFrozen() ? m_FrozenLines->GetNumberOfBytes() : 0;
+  itk::SizeValueType paletteBytes = m_Palette.capacity() * sizeof(TPixel);
+  itk::SizeValueType memUsed = this->GetNumberOfBytes();
+  double             cr = double(memUsed) / (pixelCount * sizeof(PixelType));
+
+  os << indent << "OnTheFlyCleanup: " << (m_OnTheFlyCleanup ? "On" : "Off") << std::endl;
+  os << indent << "RunAxis: " << m_RunAxis << std::endl;
+  os << indent << "WriteCombining: " << (m_WriteCombining ? "On" : "Off") << std::endl;
+  os << indent << "SparseLines: " << (m_SparseLines ? "On" : "Off") << " (" << absentCount << " absent lines)"
+     << std::endl;
+  os << indent << "SlabSummary: " << (m_SlabSummary ? "On" : "Off") << " (" << uniformSlabs << " of "
+     << m_Slabs.size() << " slabs uniform)" << std::endl;
+  os << indent << "RLSegment count: " << c << std::endl;
+  os << indent << "Segment arenas: " << m_SegmentArenas.size() << " (" << arenaBytes << " bytes)" << std::endl;
+  if (IsPaletteEncoded)
+  {
+    os << indent << "Palette: " << m_Palette.size() << " values (" << paletteBytes << " bytes)" << std::endl;
+  }
+  if (this->IsFrozen())
+  {
+    os << indent << "Frozen: " << m_FrozenLines->GetNumberOfLines() << " lines, "
+       << m_FrozenLines->GetNumberOfDistinctLines() << " distinct (" << frozenBytes << " bytes)" << std::endl;
+  }
   int prec = os.precision(3);
   os << indent << "Compressed size in relation to original size: " << cr * 100 << "%" << std::endl;
   os.precision(prec);
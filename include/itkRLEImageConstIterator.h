@@ -26,6 +26,7 @@
 #include "itkIndex.h"
 #include "itkNumericTraits.h"
 #include "itkRLEImage.h"
+#include <vector>
 
 class MultiLabelMeshPipeline;
 
@@ -34,12 +35,17 @@ namespace itk
 /** \class ImageConstIterator
  *  \brief A multi-dimensional image iterator templated over image type.
  *  Specialized for RLEImage.
+ *
+ *  Pixels are visited in the usual order, along index axis 0 first.
+ *  If that is not the run axis of the image, consecutive pixels lie on
+ *  different lines. The iterator then remembers the segment it last visited
+ *  on each line, so coming back to the line finds the next pixel from there.
  *  \ingroup RLEImage
  *  \ingroup ITKCommon
  */
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
   friend class ::MultiLabelMeshPipeline;
 
@@ -57,7 +63,7 @@ public:
   itkVirtualGetNameOfClassMacro(ImageConstIterator);
 
   /** Image type alias support. */
-  using ImageType = RLEImage<TPixel, VImageDimension, CounterType>;
+  using ImageType = RLEImage<TPixel, VImageDimension, CounterType, TLine>;
 
   /** Run-Length Line (we iterate along it). */
   using RLLine = typename ImageType::RLLine;
@@ -83,6 +89,9 @@ public:
   /** Region type alias support. */
   using RegionType = typename ImageType::RegionType;
 
+  /** Offset value type alias support. */
+  using OffsetValueType = typename ImageType::OffsetValueType;
+
   /** Internal Pixel Type */
   using InternalPixelType = typename ImageType::InternalPixelType;
 
@@ -101,16 +110,33 @@ public:
     m_EndIndex0 = 0;
     m_RealIndex = 0;
     m_SegmentRemainder = 0;
+    m_RunAxis = 0;
+    m_PixelNumber = 0;
+  }
+
+  /** Destructor. Splices in the writes gathered by a writable iterator,
+   * see RLEImage::SetWriteCombining(). Failing to do so is reported, not thrown. */
+  virtual ~ImageConstIterator()
+  {
+    try
+    {
+      this->FlushWrites();
+    }
+    catch (const std::exception & e)
+    {
+      itkGenericOutputMacro(<< "Writes gathered by an RLEImage iterator were lost: " << e.what());
+    }
   }
 
-  /** Default Destructor. */
-  virtual ~ImageConstIterator() = default;
   /** Copy Constructor. The copy constructor is provided to make sure the
    * handle to the image is properly reference counted. */
   ImageConstIterator(const Self & it)
-    : m_Buffer(const_cast<ImageType *>(it.GetImage())->GetBuffer())
+    : m_Buffer(it.GetImage()->GetBuffer())
   {
-    m_RunLengthLine = it.m_RunLengthLine;
+    m_FrozenLine = it.m_FrozenLine;
+    m_RowLine = it.m_RowLine;
+    m_RunLengthLine = it.m_RunLengthLine == &it.m_FrozenLine ? &m_FrozenLine : it.m_RunLengthLine;
+    m_RunLengthLine = it.m_RunLengthLine == &it.m_RowLine ? &m_RowLine : m_RunLengthLine;
     m_Image = it.m_Image; // copy the smart pointer
     m_Index0 = it.m_Index0;
     this->m_BI = it.m_BI;
@@ -119,12 +145,20 @@ public:
     m_SegmentRemainder = it.m_SegmentRemainder;
     m_BeginIndex0 = it.m_BeginIndex0;
     m_EndIndex0 = it.m_EndIndex0;
+
+    m_RunAxis = it.m_RunAxis;
+    m_Region = it.m_Region;
+    m_PixelIndex = it.m_PixelIndex;
+    m_PixelNumber = it.m_PixelNumber;
+    m_CursorNumber = it.m_CursorNumber; // the cursors of other lines are not copied
+    m_EditRow = it.m_EditRow;
+    m_EditGeneration = it.m_EditGeneration;
   }
 
   /** Constructor establishes an iterator to walk a particular image and a
    * particular region of that image. */
   ImageConstIterator(const ImageType * ptr, const RegionType & region)
-    : m_Buffer(const_cast<ImageType *>(ptr)->GetBuffer())
+    : m_Buffer(ptr->GetBuffer())
   {
     m_Image = ptr;
     SetRegion(region);
@@ -137,8 +171,12 @@ public:
   {
     if (this != &it)
     {
+      this->FlushWrites(); // gathered writes are not handed over
       m_Buffer = it.m_Buffer;
-      m_RunLengthLine = it.m_RunLengthLine;
+      m_FrozenLine = it.m_FrozenLine;
+      m_RowLine = it.m_RowLine;
+      m_RunLengthLine = it.m_RunLengthLine == &it.m_FrozenLine ? &m_FrozenLine : it.m_RunLengthLine;
+      m_RunLengthLine = it.m_RunLengthLine == &it.m_RowLine ? &m_RowLine : m_RunLengthLine;
       m_Image = it.m_Image; // copy the smart pointer
       m_Index0 = it.m_Index0;
       m_BI = it.m_BI;
@@ -147,6 +185,15 @@ public:
       m_SegmentRemainder = it.m_SegmentRemainder;
       m_BeginIndex0 = it.m_BeginIndex0;
       m_EndIndex0 = it.m_EndIndex0;
+
+      m_RunAxis = it.m_RunAxis;
+      m_Region = it.m_Region;
+      m_PixelIndex = it.m_PixelIndex;
+      m_PixelNumber = it.m_PixelNumber;
+      m_Cursors.clear();
+      m_CursorNumber = it.m_CursorNumber;
+      m_EditRow = it.m_EditRow;
+      m_EditGeneration = it.m_EditGeneration;
     }
     return *this;
   }
@@ -164,6 +211,20 @@ public:
                             "Region " << region << " is outside of buffered region " << bufferedRegion);
     }
 
+    m_RunAxis = m_Image->GetRunAxis();
+    if (m_RunAxis != 0)
+    {
+      // m_Index0 counts pixels along axis 0 within the region, to tell the end of a row
+      m_Region = region;
+      m_BI = BufferIterator(m_Buffer, region.Slice(m_RunAxis));
+      m_BeginIndex0 = 0;
+      m_EndIndex0 = region.GetSize(0);
+      m_Cursors.clear();
+      m_CursorNumber = -1;
+      SetPixelNumber(0);
+      return;
+    }
+
     m_BI = BufferIterator(m_Buffer, region.Slice(0));
     m_Index0 = region.GetIndex(0);
     m_BeginIndex0 = m_Index0 - m_Image->GetBufferedRegion().GetIndex(0);
@@ -183,6 +244,10 @@ public:
   bool
   operator!=(const Self & it) const
   {
+    if (m_RunAxis != 0)
+    {
+      return m_PixelNumber != it.m_PixelNumber;
+    }
     return m_BI != it.m_BI || m_Index0 + m_BeginIndex0 != it.m_Index0 + it.m_BeginIndex0;
   }
 
@@ -191,6 +256,10 @@ public:
   bool
   operator==(const Self & it) const
   {
+    if (m_RunAxis != 0)
+    {
+      return m_PixelNumber == it.m_PixelNumber;
+    }
     return m_BI == it.m_BI && m_Index0 + m_BeginIndex0 == it.m_Index0 + it.m_BeginIndex0;
   }
 
@@ -199,6 +268,10 @@ public:
   bool
   operator<=(const Self & it) const
   {
+    if (m_RunAxis != 0)
+    {
+      return m_PixelNumber <= it.m_PixelNumber;
+    }
     if (m_BI < it.m_BI)
     {
       return true;
@@ -215,6 +288,10 @@ public:
   bool
   operator<(const Self & it) const
   {
+    if (m_RunAxis != 0)
+    {
+      return m_PixelNumber < it.m_PixelNumber;
+    }
     if (m_BI < it.m_BI)
     {
       return true;
@@ -231,6 +308,10 @@ public:
   bool
   operator>=(const Self & it) const
   {
+    if (m_RunAxis != 0)
+    {
+      return m_PixelNumber >= it.m_PixelNumber;
+    }
     if (m_BI > it.m_BI)
     {
       return true;
@@ -247,6 +328,10 @@ public:
   bool
   operator>(const Self & it) const
   {
+    if (m_RunAxis != 0)
+    {
+      return m_PixelNumber > it.m_PixelNumber;
+    }
     if (m_BI > it.m_BI)
     {
       return true;
@@ -262,6 +347,10 @@ public:
   const IndexType
   GetIndex() const
   {
+    if (m_RunAxis != 0)
+    {
+      return m_PixelIndex;
+    }
     IndexType indR(m_Image->GetBufferedRegion().GetIndex());
 
     indR[0] += m_Index0;
@@ -277,6 +366,16 @@ public:
   virtual void
   SetIndex(const IndexType & ind)
   {
+    if (m_RunAxis != 0)
+    {
+      OffsetValueType number = 0;
+      for (unsigned int i = VImageDimension; i > 0; i--)
+      {
+        number = number * m_Region.GetSize(i - 1) + (ind[i - 1] - m_Region.GetIndex(i - 1));
+      }
+      SetPixelNumber(number);
+      return;
+    }
     typename BufferType::IndexType bufInd;
     for (IndexValueType i = 1; i < VImageDimension; i++)
     {
@@ -291,6 +390,10 @@ public:
   const RegionType
   GetRegion() const
   {
+    if (m_RunAxis != 0)
+    {
+      return m_Region;
+    }
     RegionType r;
 
     r.SetIndex(0, m_BeginIndex0 + m_Image->GetBufferedRegion().GetIndex(0));
@@ -324,9 +427,25 @@ public:
   const PixelType &
   Value() const
   {
-    RLLine & line = const_cast<Self *>(this)->m_BI.Value();
-
-    return line[m_RealIndex].second;
+    this->CatchUpWithEdits();
+    if (m_EditRow != nullptr)
+    {
+      return m_Image->DecodeValue(m_EditRow->GetValue(this->GetRunIndex()));
+    }
+    const IndexValueType runIndex = this->GetRunIndex();
+    if (!m_PendingRuns.empty() && m_BI.GetIndex() == m_PendingLine && runIndex >= m_PendingStart &&
+        runIndex < m_PendingEnd)
+    {
+      // the pixel has been written with WriteCombining on, most likely by the last write
+      IndexValueType start = m_PendingEnd;
+      SizeValueType  x = m_PendingRuns.size();
+      do
+      {
+        start -= IndexValueType(m_PendingRuns[--x].first);
+      } while (runIndex < start);
+      return m_Image->DecodeValue(m_PendingRuns[x].second);
+    }
+    return m_Image->DecodeValue((*m_RunLengthLine)[m_RealIndex].second);
   }
 
   /** Move an iterator to the beginning of the region. "Begin" is
@@ -334,6 +453,11 @@ public:
   void
   GoToBegin()
   {
+    if (m_RunAxis != 0)
+    {
+      SetPixelNumber(0);
+      return;
+    }
     m_BI.GoToBegin();
     SetIndexInternal(m_BeginIndex0);
   }
@@ -343,8 +467,14 @@ public:
   void
   GoToEnd()
   {
+    if (m_RunAxis != 0)
+    {
+      SetPixelNumber(m_Region.GetNumberOfPixels());
+      return;
+    }
     m_BI.GoToEnd();
     m_Index0 = m_BeginIndex0;
+    this->FlushWrites();
   }
 
   /** Is the iterator at the beginning of the region? "Begin" is defined
@@ -352,6 +482,10 @@ public:
   bool
   IsAtBegin() const
   {
+    if (m_RunAxis != 0)
+    {
+      return m_PixelNumber == 0;
+    }
     return m_Index0 == m_BeginIndex0 && m_BI.IsAtBegin();
   }
 
@@ -360,36 +494,345 @@ public:
   bool
   IsAtEnd() const
   {
+    if (m_RunAxis != 0)
+    {
+      return m_PixelNumber == OffsetValueType(m_Region.GetNumberOfPixels());
+    }
     return m_Index0 == m_BeginIndex0 && m_BI.IsAtEnd();
   }
 
+  /** Splices the writes gathered with WriteCombining on into their line,
+   * see RLEImage::SetWriteCombining(). This happens by itself as the iterator
+   * leaves the line, call it to let other iterators read the pixels earlier. */
+  void
+  FlushWrites() const
+  {
+    if (m_PendingRuns.empty())
+    {
+      return;
+    }
+    Self *                                 self = const_cast<Self *>(this);
+    const typename ImageType::ConstPointer keepAlive = m_PendingImage;
+    ImageType *                            image = const_cast<ImageType *>(keepAlive.GetPointer());
+    RLLine                                 runs;
+    runs.swap(m_PendingRuns); // dropped if splicing them in throws
+    m_PendingImage = nullptr;
+    image->SetRuns(image->GetIndexOnLine(m_PendingLine, m_PendingStart), runs);
+    if (!m_Cursors.empty())
+    {
+      self->m_Cursors[this->GetLineNumber(m_PendingLine)].m_Line = nullptr; // its segments have changed
+    }
+    if (m_BI.GetIndex() == m_PendingLine && m_BI.GetRegion().IsInside(m_PendingLine))
+    {
+      this->ResolveCurrentLine();
+      m_RealIndex = m_RunLengthLine->FindSegment(this->GetRunIndex(), m_SegmentRemainder);
+    }
+  }
+
 protected: // made protected so other iterators can access
   /** Set the internal index, m_RealIndex and m_SegmentRemainder. */
   virtual void
   SetIndexInternal(const IndexValueType ind0)
   {
+    this->FlushWrites(); // the writes gathered on the line left behind
     m_Index0 = ind0;
-    m_RunLengthLine = &m_BI.Value();
+    m_EditGeneration = m_Image->GetEditGeneration();
+    this->ResolveCurrentLine();
+    m_RealIndex = m_RunLengthLine->FindSegment(m_Index0, m_SegmentRemainder);
+  } // SetIndexInternal
+
+  /** Moves to the pixel with the given number (in iteration order) within
+   * the region, for a run axis other than 0. Past either end of the region,
+   * only the number is kept. */
+  void
+  SetPixelNumber(OffsetValueType number)
+  {
+    this->FlushWrites(); // the writes gathered on the line left behind
+    this->SaveCursor();
+    m_PixelNumber = number;
+    if (number < 0 || number >= OffsetValueType(m_Region.GetNumberOfPixels()))
+    {
+      m_Index0 = m_BeginIndex0;
+      m_CursorNumber = -1;
+      return;
+    }
+    for (unsigned int i = 0; i < VImageDimension; i++)
+    {
+      m_PixelIndex[i] = m_Region.GetIndex(i) + number % OffsetValueType(m_Region.GetSize(i));
+      number /= OffsetValueType(m_Region.GetSize(i));
+    }
+    m_Index0 = m_PixelIndex[0] - m_Region.GetIndex(0);
 
-    CounterType   t = 0;
-    SizeValueType x = 0;
-    for (; x < (*m_RunLengthLine).size(); x++)
+    m_BI.SetIndex(m_Image->GetLineIndex(m_PixelIndex));
+    if (m_EditGeneration != m_Image->GetEditGeneration())
+    {
+      m_EditGeneration = m_Image->GetEditGeneration();
+      m_Cursors.clear(); // lines may have been rewritten from rows
+    }
+    this->ResolveCurrentLine();
+    m_CursorNumber = this->GetLineNumber(m_BI.GetIndex());
+    this->RestoreCursor();
+  } // SetPixelNumber
+
+  /** Points m_RunLengthLine at the current line, and m_EditRow at its row
+   * during an edit session. An edited line is walked as a uniform line of
+   * the same length, as EndEdit() rewrites it while the iterator is on it. */
+  void
+  ResolveCurrentLine() const
+  {
+    Self * self = const_cast<Self *>(this);
+    if (m_RunLengthLine == &m_FrozenLine && !m_Image->IsFrozen())
+    {
+      // the image has been thawed into a new buffer
+      BufferIterator bi(m_Buffer, m_BI.GetRegion());
+      bi.SetIndex(m_BI.GetIndex());
+      self->m_BI = bi;
+    }
+    self->m_EditRow = const_cast<ImageType *>(m_Image.GetPointer())->GetEditRow(m_BI.GetIndex());
+    if (m_EditRow != nullptr)
     {
-      t += (*m_RunLengthLine)[x].first;
-      if (t > m_Index0)
+      if (m_RowLine.empty())
       {
-        break;
+        ImageType::AppendRun(self->m_RowLine, m_EditRow->m_Values.size(), typename ImageType::RLValueType());
       }
+      self->m_RunLengthLine = &m_RowLine;
+    }
+    else if (m_Image->IsFrozen())
+    {
+      self->m_RunLengthLine = &m_Image->GetLine(m_BI.GetIndex(), self->m_FrozenLine);
+    }
+    else
+    {
+      self->m_RunLengthLine = &m_Image->ResolveLine(self->m_BI.Value());
+    }
+  }
+
+  /** Locates the current pixel again if an edit session began or ended
+   * since the iterator located it, see RLEImage::GetEditGeneration(). */
+  void
+  CatchUpWithEdits() const
+  {
+    if (m_EditGeneration == m_Image->GetEditGeneration())
+    {
+      return;
+    }
+    this->FlushWrites(); // gathered before the session
+    Self * self = const_cast<Self *>(this);
+    self->m_EditGeneration = m_Image->GetEditGeneration();
+    self->m_Cursors.clear();
+    this->ResolveCurrentLine();
+    m_RealIndex = m_RunLengthLine->FindSegment(this->GetRunIndex(), m_SegmentRemainder);
+  }
+
+  /** Number of the line with the given buffer index among the lines of the region,
+   * for a run axis other than 0. */
+  OffsetValueType
+  GetLineNumber(const typename BufferType::IndexType & lineIndex) const
+  {
+    const typename BufferType::RegionType & lines = m_BI.GetRegion();
+    OffsetValueType                         number = 0;
+    for (unsigned int i = VImageDimension - 1; i > 0; i--)
+    {
+      number = number * OffsetValueType(lines.GetSize(i - 1)) + (lineIndex[i - 1] - lines.GetIndex(i - 1));
+    }
+    return number;
+  }
+
+  /** Remembers the segment of the current pixel on its line, before moving to another line. */
+  void
+  SaveCursor()
+  {
+    if (m_CursorNumber < 0)
+    {
+      return;
+    }
+    if (m_Cursors.empty())
+    {
+      m_Cursors.resize(m_BI.GetRegion().GetNumberOfPixels());
+    }
+    LineCursor & cursor = m_Cursors[m_CursorNumber];
+    cursor.m_Line = m_RunLengthLine;
+    cursor.m_Size = m_RunLengthLine->size();
+    cursor.m_RealIndex = m_RealIndex;
+    cursor.m_Start = this->GetRunIndex() + m_SegmentRemainder - IndexValueType((*m_RunLengthLine)[m_RealIndex].first);
+  }
+
+  /** Locates the current pixel within its line, walking from the segment
+   * last visited on the line if it is still there. */
+  void
+  RestoreCursor()
+  {
+    const IndexValueType runIndex = this->GetRunIndex();
+    if (m_Cursors.empty() || m_Cursors[m_CursorNumber].m_Line != m_RunLengthLine ||
+        m_Cursors[m_CursorNumber].m_Size != m_RunLengthLine->size())
+    {
+      m_RealIndex = m_RunLengthLine->FindSegment(runIndex, m_SegmentRemainder);
+      return;
+    }
+    const RLLine &       line = *m_RunLengthLine;
+    const LineCursor &   cursor = m_Cursors[m_CursorNumber];
+    SizeValueType        x = cursor.m_RealIndex;
+    IndexValueType       start = cursor.m_Start;
+    while (runIndex < start)
+    {
+      start -= IndexValueType(line[--x].first);
+    }
+    IndexValueType end = start + IndexValueType(line[x].first);
+    while (runIndex >= end)
+    {
+      end += IndexValueType(line[++x].first);
     }
     m_RealIndex = x;
-    m_SegmentRemainder = t - m_Index0;
-  } // SetIndexInternal
+    m_SegmentRemainder = end - runIndex;
+  }
+
+  /** Position of the current pixel within its line. */
+  IndexValueType
+  GetRunIndex() const
+  {
+    if (m_RunAxis == 0)
+    {
+      return m_Index0;
+    }
+    return m_PixelIndex[m_RunAxis] - m_Image->GetBufferedRegion().GetIndex(m_RunAxis);
+  }
+
+  /** The current line, for writing by the non-const iterators.
+   * Thaws a frozen image and materializes an absent line,
+   * the position within the line stays valid. */
+  RLLine &
+  GetWritableLine() const
+  {
+    Self * self = const_cast<Self *>(this);
+    if (m_RunLengthLine == &m_FrozenLine)
+    {
+      const_cast<ImageType *>(m_Image.GetPointer())->Thaw();
+      BufferIterator bi(m_Buffer, m_BI.GetRegion());
+      bi.SetIndex(m_BI.GetIndex());
+      self->m_BI = bi;
+      self->m_Cursors.clear(); // thawing can change how lines are stored (HybridRunLengthLine)
+      self->m_RunLengthLine = &m_Image->ResolveLine(self->m_BI.Value());
+      // thawing can change how the line is stored (HybridRunLengthLine)
+      m_RealIndex = m_RunLengthLine->FindSegment(this->GetRunIndex(), m_SegmentRemainder);
+    }
+    RLLine & line = self->m_BI.Value();
+    if (m_RunLengthLine != &line) // absent line, a copy of the background line has the same segments
+    {
+      line = *m_RunLengthLine;
+      self->m_RunLengthLine = &line;
+    }
+    return line;
+  }
+
+  /** Sets the current pixel, for the non-const iterators. Writing background
+   * to an absent line leaves it absent.
+   * Changing the RLE structure invalidates all other iterators (except this one). */
+  void
+  SetCurrentPixel(const PixelType & value) const
+  {
+    using RLValueType = typename ImageType::RLValueType;
+    Self *      self = const_cast<Self *>(this);
+    ImageType * image = const_cast<ImageType *>(m_Image.GetPointer());
+    this->CatchUpWithEdits();
+    if (m_EditRow != nullptr)
+    {
+      if (image->GetSlabSummary())
+      {
+        image->NoteSlabWrite(m_BI.GetIndex(), value);
+      }
+      m_EditRow->m_Values[this->GetRunIndex()] = image->EncodeValue(value);
+      m_EditRow->m_Dirty = true;
+      return;
+    }
+    if (image->GetWriteCombining())
+    {
+      this->GatherWrite(1, value);
+      return;
+    }
+    this->FlushWrites(); // gathered before WriteCombining was turned off
+    if (m_RunLengthLine != &m_FrozenLine && m_RunLengthLine != &self->m_BI.Value() &&
+        value == image->DecodeValue(RLValueType()))
+    {
+      return;
+    }
+    if (image->GetSlabSummary())
+    {
+      image->NoteSlabWrite(m_BI.GetIndex(), value);
+    }
+    image->InvalidateLineHash(m_BI.GetIndex());
+    image->SetPixel(this->GetWritableLine(), m_SegmentRemainder, m_RealIndex, value);
+  }
+
+  /** Sets length pixels along the run axis starting with the current one,
+   * for the non-const iterators. See SetCurrentPixel(). */
+  void
+  SetCurrentRun(SizeValueType length, const PixelType & value) const
+  {
+    using RLValueType = typename ImageType::RLValueType;
+    Self *      self = const_cast<Self *>(this);
+    ImageType * image = const_cast<ImageType *>(m_Image.GetPointer());
+    this->CatchUpWithEdits();
+    if (m_EditRow != nullptr)
+    {
+      image->SetRun(image->GetIndexOnLine(m_BI.GetIndex(), this->GetRunIndex()), length, value);
+      return;
+    }
+    if (length > 0 && image->GetWriteCombining())
+    {
+      this->GatherWrite(length, value);
+      return;
+    }
+    this->FlushWrites();
+    if (length == 0 || (m_RunLengthLine != &m_FrozenLine && m_RunLengthLine != &self->m_BI.Value() &&
+                        value == image->DecodeValue(RLValueType())))
+    {
+      return;
+    }
+    if (image->GetSlabSummary())
+    {
+      image->NoteSlabWrite(m_BI.GetIndex(), value);
+    }
+    image->InvalidateLineHash(m_BI.GetIndex());
+    RLLine &             line = this->GetWritableLine();
+    const IndexValueType runIndex = this->GetRunIndex();
+    image->SetRun(line, runIndex, length, value);
+    m_RealIndex = line.FindSegment(runIndex, m_SegmentRemainder);
+  }
+
+  /** Gathers a write of length pixels along the run axis, starting with the
+   * current one, for the non-const iterators with WriteCombining on.
+   * Writes which do not follow the gathered ones splice those in first. */
+  void
+  GatherWrite(SizeValueType length, const PixelType & value) const
+  {
+    const IndexValueType runIndex = this->GetRunIndex();
+    if (!m_PendingRuns.empty() && (runIndex != m_PendingEnd || m_BI.GetIndex() != m_PendingLine))
+    {
+      this->FlushWrites();
+    }
+    if (m_PendingRuns.empty())
+    {
+      if (m_RunLengthLine == &m_FrozenLine)
+      {
+        this->GetWritableLine(); // thaws the image
+      }
+      m_PendingImage = m_Image.GetPointer(); // kept alive until the writes are spliced in
+      m_PendingLine = m_BI.GetIndex();
+      m_PendingStart = runIndex;
+      m_PendingEnd = runIndex;
+    }
+    ImageType * image = const_cast<ImageType *>(m_Image.GetPointer());
+    ImageType::AppendRun(m_PendingRuns, length, image->EncodeValue(value));
+    m_PendingEnd += IndexValueType(length);
+  }
 
   typename ImageType::ConstWeakPointer m_Image;
 
   IndexValueType m_Index0; // index into the RLLine
 
-  const RLLine * m_RunLengthLine;
+  const RLLine * m_RunLengthLine{ nullptr };
+  RLLine         m_FrozenLine; // current line of a frozen image
+  RLLine         m_RowLine;    // uniform line walked while the current line is edited as a row
 
   mutable SizeValueType  m_RealIndex;        // index into line's segment
   mutable IndexValueType m_SegmentRemainder; // how many pixels remain in current segment
@@ -398,24 +841,57 @@ protected: // made protected so other iterators can access
   IndexValueType m_EndIndex0;   // index to one pixel past last pixel in region in relation to buffer start
   BufferIterator m_BI;          // iterator over internal buffer image
 
+  // used only if the run axis is not 0
+  unsigned int    m_RunAxis;     // run axis of the image
+  RegionType      m_Region;      // region to iterate over
+  IndexType       m_PixelIndex;  // index of the current pixel
+  OffsetValueType m_PixelNumber; // number of the current pixel in iteration order
+
+  // segment last visited on each line of the region, to move along the line from there
+  struct LineCursor
+  {
+    const RLLine * m_Line{ nullptr }; // line it refers to, nullptr if unknown
+    SizeValueType  m_Size{ 0 };       // number of segments of the line
+    SizeValueType  m_RealIndex{ 0 };  // index of the segment
+    IndexValueType m_Start{ 0 };      // position of its first pixel within the line
+  };
+  std::vector<LineCursor> m_Cursors;             // allocated on the first move to another line
+  OffsetValueType         m_CursorNumber{ -1 }; // number of the current line within the region, -1 if none
+
+  // writes gathered with WriteCombining on, not yet spliced into their line
+  mutable RLLine                           m_PendingRuns;
+  mutable typename ImageType::ConstPointer m_PendingImage;      // image they are written to
+  mutable typename BufferType::IndexType   m_PendingLine{};     // buffer index of their line
+  mutable IndexValueType                   m_PendingStart{ 0 }; // position of their first pixel within the line
+  mutable IndexValueType                   m_PendingEnd{ 0 };   // one past their last pixel
+
+  typename ImageType::EditRow * m_EditRow{ nullptr };  // row of the current line during an edit session
+  SizeValueType                 m_EditGeneration{ 0 }; // edit generation of the image when m_EditRow was set
+
   typename BufferType::Pointer m_Buffer;
 };
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
   // just inherit constructors
 
 public:
   /** Image type alias support. */
-  using ImageType = RLEImage<TPixel, VImageDimension, CounterType>;
+  using ImageType = RLEImage<TPixel, VImageDimension, CounterType, TLine>;
 
-  using RegionType = typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>::RegionType;
+  using RegionType =
+    typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>::RegionType;
 
   void
   GoToReverseBegin()
   {
+    if (this->m_RunAxis != 0)
+    {
+      this->SetPixelNumber(this->m_Region.GetNumberOfPixels() - 1);
+      return;
+    }
     this->m_BI.GoToReverseBegin();
     this->m_Index0 = this->m_EndIndex0 - 1;
     SetIndexInternal(this->m_Index0);
@@ -424,6 +900,10 @@ public:
   bool
   IsAtReverseEnd()
   {
+    if (this->m_RunAxis != 0)
+    {
+      return this->m_PixelNumber < 0;
+    }
     return this->m_BI.IsAtReverseEnd();
   }
 
@@ -444,17 +924,18 @@ public:
   {}
 }; // no additional implementation required
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageConstIteratorWithOnlyIndex<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageConstIteratorWithOnlyIndex<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
   // just inherit constructors
 
 public:
   /** Image type alias support. */
-  using ImageType = RLEImage<TPixel, VImageDimension, CounterType>;
+  using ImageType = RLEImage<TPixel, VImageDimension, CounterType, TLine>;
 
-  using RegionType = typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>::RegionType;
+  using RegionType =
+    typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>::RegionType;
 
   /** Default Constructor. Need to provide a default constructor since we
    * provide a copy constructor. */
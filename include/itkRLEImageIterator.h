@@ -32,9 +32,9 @@ namespace itk
  * \ingroup ITKCommon
  */
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageIterator<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
 public:
   /** Standard class type alias. */
@@ -47,7 +47,7 @@ public:
   static constexpr unsigned int ImageIteratorDimension = VImageDimension;
 
   /** Define the superclass */
-  using Superclass = ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>;
+  using Superclass = ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>;
 
   /** Inherit types from the superclass */
   using IndexType = typename Superclass::IndexType;
@@ -89,11 +89,15 @@ public:
   void
   Set(const PixelType & value) const
   {
-    const_cast<ImageType *>(this->m_Image.GetPointer())
-      ->SetPixel(*const_cast<typename ImageType::RLLine *>(this->m_RunLengthLine),
-                 this->m_SegmentRemainder,
-                 this->m_RealIndex,
-                 value);
+    this->SetCurrentPixel(value);
+  }
+
+  /** Set length pixels along the run axis, starting with the current one,
+   * see RLEImage::SetRun(). The iterator stays on the current pixel. */
+  void
+  SetRun(SizeValueType length, const PixelType & value) const
+  {
+    this->SetCurrentRun(length, value);
   }
 
   ///** Return a reference to the pixel
@@ -128,14 +132,15 @@ protected:
   }
 };
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
 public:
-  using ImageType = RLEImage<TPixel, VImageDimension, CounterType>;
+  using ImageType = RLEImage<TPixel, VImageDimension, CounterType, TLine>;
 
-  using RegionType = typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>::RegionType;
+  using RegionType =
+    typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>::RegionType;
 
   /** Default Constructor. Need to provide a default constructor since we
    * provide a copy constructor. */
@@ -158,11 +163,15 @@ public:
   void
   Set(const TPixel & value) const
   {
-    const_cast<ImageType *>(this->m_Image.GetPointer())
-      ->SetPixel(*const_cast<typename ImageType::RLLine *>(this->m_RunLengthLine),
-                 this->m_SegmentRemainder,
-                 this->m_RealIndex,
-                 value);
+    this->SetCurrentPixel(value);
+  }
+
+  /** Set length pixels along the run axis, starting with the current one,
+   * see RLEImage::SetRun(). The iterator stays on the current pixel. */
+  void
+  SetRun(SizeValueType length, const TPixel & value) const
+  {
+    this->SetCurrentRun(length, value);
   }
 
   /** Get the image that this iterator walks. */
@@ -38,16 +38,16 @@ namespace itk
  *  \ingroup RLEImage
  *  \ingroup ITKCommon
  */
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
   friend class ::MultiLabelMeshPipeline;
 
 public:
   /** Standard class type alias. */
-  using Self = ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>;
-  using Superclass = ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>;
+  using Self = ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>;
+  using Superclass = ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>;
 
   /** Dimension of the image that the iterator walks.  This constant is needed so
    * functions that are templated over image iterator type (as opposed to
@@ -108,6 +108,12 @@ public:
   Self &
   operator++()
   {
+    if (this->m_RunAxis != 0)
+    {
+      this->SetPixelNumber(this->m_PixelNumber + 1);
+      return *this;
+    }
+
     this->m_Index0++;
 
     if (this->m_Index0 >= this->m_EndIndex0)
@@ -120,6 +126,7 @@ public:
       else
       {
         this->m_Index0 = this->m_BeginIndex0;
+        this->FlushWrites();
       }
       return *this;
     }
@@ -130,6 +137,11 @@ public:
       return *this;
     }
 
+    if (this->m_EditGeneration != this->m_Image->GetEditGeneration())
+    {
+      this->CatchUpWithEdits(); // the line may have been rewritten
+      return *this;
+    }
     this->m_RealIndex++;
     this->m_SegmentRemainder = (*this->m_RunLengthLine)[this->m_RealIndex].first;
     return *this;
@@ -145,6 +157,12 @@ public:
   Self &
   operator--()
   {
+    if (this->m_RunAxis != 0)
+    {
+      this->SetPixelNumber(this->m_PixelNumber - 1);
+      return *this;
+    }
+
     this->m_Index0--;
 
     if (this->m_Index0 < this->m_BeginIndex0)
@@ -153,6 +171,11 @@ public:
       this->SetIndexInternal(this->m_EndIndex0 - 1);
       return *this;
     }
+    if (this->m_EditGeneration != this->m_Image->GetEditGeneration())
+    {
+      this->CatchUpWithEdits(); // the line may have been rewritten
+      return *this;
+    }
 
     this->m_SegmentRemainder++;
     if (this->m_SegmentRemainder <= (*this->m_RunLengthLine)[this->m_RealIndex].first)
@@ -164,16 +187,71 @@ public:
     this->m_SegmentRemainder = 1;
     return *this;
   } // --
+
+  /** If the rest of the current slab (see RLEImage::GetSlabAxis()) within
+   * the region is known to be uniform, moves to the first pixel of the next
+   * slab, sets value and the number of pixels skipped, and returns true.
+   * Otherwise does nothing and returns false. This lets a pass over the image
+   * handle uniform slabs at once, see RLEImage::SetSlabSummary().
+   * Flushes the writes gathered with WriteCombining on first, as the
+   * summary only learns of them then. Only supported for a run axis of 0. */
+  bool
+  SkipUniformSlab(PixelType & value, SizeValueType & count)
+  {
+    constexpr unsigned int slabDim = VImageDimension - 2; // slab axis within the buffer index
+    typename ImageType::RLValueType stored;
+    this->FlushWrites();
+    if (this->m_RunAxis != 0 || this->IsAtEnd())
+    {
+      return false;
+    }
+    typename ImageType::BufferType::IndexType lineIndex = this->m_BI.GetIndex();
+    if (!this->m_Image->IsUniformSlab(lineIndex[slabDim], stored))
+    {
+      return false;
+    }
+    value = this->m_Image->DecodeValue(stored);
+
+    // number of the current line within the slab, and the number of lines in the slab
+    const typename ImageType::BufferType::RegionType & lineRegion = this->m_BI.GetRegion();
+    SizeValueType                                      lineNumber = 0;
+    SizeValueType                                      lineCount = 1;
+    for (int k = int(slabDim) - 1; k >= 0; k--)
+    {
+      lineNumber = lineNumber * lineRegion.GetSize(k) + SizeValueType(lineIndex[k] - lineRegion.GetIndex(k));
+      lineCount *= lineRegion.GetSize(k);
+    }
+    const SizeValueType width = this->m_EndIndex0 - this->m_BeginIndex0;
+    count = SizeValueType(this->m_EndIndex0 - this->m_Index0) + (lineCount - 1 - lineNumber) * width;
+
+    // first line of the next slab
+    for (unsigned int k = 0; k < slabDim; k++)
+    {
+      lineIndex[k] = lineRegion.GetIndex(k);
+    }
+    if (++lineIndex[slabDim] < lineRegion.GetIndex(slabDim) + IndexValueType(lineRegion.GetSize(slabDim)))
+    {
+      this->m_BI.SetIndex(lineIndex);
+      this->SetIndexInternal(this->m_BeginIndex0);
+    }
+    else
+    {
+      this->m_BI.GoToEnd();
+      this->m_Index0 = this->m_BeginIndex0;
+    }
+    return true;
+  }
 };
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageRegionConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageRegionConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
 public:
-  using ImageType = RLEImage<TPixel, VImageDimension, CounterType>;
+  using ImageType = RLEImage<TPixel, VImageDimension, CounterType, TLine>;
 
-  using RegionType = typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>::RegionType;
+  using RegionType =
+    typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>::RegionType;
 
   /** Default constructor. Needed since we provide a cast constructor. */
   ImageRegionConstIteratorWithIndex()
@@ -189,6 +267,11 @@ public:
   void
   GoToReverseBegin()
   {
+    if (this->m_RunAxis != 0)
+    {
+      this->SetPixelNumber(this->m_Region.GetNumberOfPixels() - 1);
+      return;
+    }
     this->m_BI.GoToEnd(); // after last pixel
     --(this->m_BI);       // go to last valid pixel
     this->m_Index0 = this->m_EndIndex0 - 1;
@@ -198,6 +281,10 @@ public:
   bool
   IsAtReverseEnd()
   {
+    if (this->m_RunAxis != 0)
+    {
+      return this->m_PixelNumber == 0;
+    }
     return (this->m_Index0 == this->m_BeginIndex0) && this->m_BI.IsAtBegin();
   }
 
@@ -213,16 +300,17 @@ public:
   }
 }; // no additional implementation required
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageRegionConstIteratorWithOnlyIndex<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageRegionConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageRegionConstIteratorWithOnlyIndex<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageRegionConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
   // just inherit constructors
 
 public:
-  using ImageType = RLEImage<TPixel, VImageDimension, CounterType>;
+  using ImageType = RLEImage<TPixel, VImageDimension, CounterType, TLine>;
 
-  using RegionType = typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>::RegionType;
+  using RegionType =
+    typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>::RegionType;
 
   /** Default constructor. Needed since we provide a cast constructor. */
   ImageRegionConstIteratorWithOnlyIndex()
@@ -46,14 +46,14 @@ namespace itk
  * \ingroup ITKCommon
  */
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageRegionIterator<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageRegionIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
 public:
   /** Standard class type alias. */
   using Self = ImageRegionIterator;
-  using Superclass = ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>;
+  using Superclass = ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>;
 
   /** Types inherited from the Superclass */
   using IndexType = typename Superclass::IndexType;
@@ -88,11 +88,15 @@ public:
   void
   Set(const PixelType & value) const
   {
-    const_cast<ImageType *>(this->m_Image.GetPointer())
-      ->SetPixel(*const_cast<typename ImageType::RLLine *>(this->m_RunLengthLine),
-                 this->m_SegmentRemainder,
-                 this->m_RealIndex,
-                 value);
+    this->SetCurrentPixel(value);
+  }
+
+  /** Set length pixels along the run axis, starting with the current one,
+   * see RLEImage::SetRun(). The iterator stays on the current pixel. */
+  void
+  SetRun(SizeValueType length, const PixelType & value) const
+  {
+    this->SetCurrentRun(length, value);
   }
 
 protected:
@@ -107,14 +111,15 @@ protected:
   }
 };
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageRegionIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageRegionConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageRegionIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageRegionConstIteratorWithIndex<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
 public:
-  using ImageType = RLEImage<TPixel, VImageDimension, CounterType>;
+  using ImageType = RLEImage<TPixel, VImageDimension, CounterType, TLine>;
 
-  using RegionType = typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>::RegionType;
+  using RegionType =
+    typename itk::ImageConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>::RegionType;
 
   /** Default constructor. Needed since we provide a cast constructor. */
   ImageRegionIteratorWithIndex()
@@ -132,11 +137,15 @@ public:
   void
   Set(const TPixel & value) const
   {
-    const_cast<ImageType *>(this->m_Image.GetPointer())
-      ->SetPixel(*const_cast<typename ImageType::RLLine *>(this->m_RunLengthLine),
-                 this->m_SegmentRemainder,
-                 this->m_RealIndex,
-                 value);
+    this->SetCurrentPixel(value);
+  }
+
+  /** Set length pixels along the run axis, starting with the current one,
+   * see RLEImage::SetRun(). The iterator stays on the current pixel. */
+  void
+  SetRun(SizeValueType length, const TPixel & value) const
+  {
+    this->SetCurrentRun(length, value);
   }
 
   /** Constructor that can be used to cast from an ImageIterator to an
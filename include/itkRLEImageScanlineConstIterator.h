@@ -30,14 +30,14 @@ namespace itk
  *  \ingroup RLEImage
  *  \ingroup ITKCommon
  */
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageScanlineConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageScanlineConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
 public:
   /** Standard class type alias. */
   using Self = ImageScanlineConstIterator;
-  using Superclass = ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>;
+  using Superclass = ImageRegionConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>;
 
   /** Dimension of the image that the iterator walks.  This constant is needed so
    * functions that are templated over image iterator type (as opposed to
@@ -97,7 +97,17 @@ public:
   void
   GoToBeginOfLine()
   {
+    if (this->m_RunAxis != 0)
+    {
+      this->SetPixelNumber(this->m_PixelNumber - this->m_Index0);
+      return;
+    }
     this->m_Index0 = this->m_BeginIndex0;
+    if (this->m_EditGeneration != this->m_Image->GetEditGeneration())
+    {
+      this->CatchUpWithEdits(); // the line may have been rewritten
+      return;
+    }
     this->m_RealIndex = 0;
     this->m_SegmentRemainder = (*this->m_RunLengthLine)[this->m_RealIndex].first;
   }
@@ -106,6 +116,12 @@ public:
   void
   GoToEndOfLine()
   {
+    if (this->m_RunAxis != 0)
+    {
+      this->m_PixelNumber += this->m_EndIndex0 - this->m_Index0;
+      this->m_Index0 = this->m_EndIndex0;
+      return;
+    }
     this->m_Index0 = this->m_EndIndex0;
     this->m_RealIndex = this->m_RunLengthLine->size() - 1;
     this->m_SegmentRemainder = 0;
@@ -122,6 +138,11 @@ public:
   inline void
   NextLine()
   {
+    if (this->m_RunAxis != 0)
+    {
+      this->SetPixelNumber(this->m_PixelNumber - this->m_Index0 + this->m_EndIndex0);
+      return;
+    }
     ++(this->m_BI);
     if (!this->m_BI.IsAtEnd())
     {
@@ -130,6 +151,7 @@ public:
     else
     {
       this->m_Index0 = this->m_BeginIndex0; // make this iterator at end too
+      this->FlushWrites();
     }
   }
 
@@ -144,6 +166,19 @@ public:
   operator++()
   {
     itkAssertInDebugAndIgnoreInReleaseMacro(!this->IsAtEndOfLine());
+    if (this->m_RunAxis != 0)
+    {
+      if (this->m_Index0 + 1 < this->m_EndIndex0)
+      {
+        this->SetPixelNumber(this->m_PixelNumber + 1);
+      }
+      else // the end of the row is not a pixel
+      {
+        this->m_PixelNumber++;
+        this->m_Index0++;
+      }
+      return *this;
+    }
     this->m_Index0++;
     this->m_SegmentRemainder--;
     if (this->m_SegmentRemainder > 0)
@@ -155,6 +190,11 @@ public:
     {
       return *this;
     }
+    if (this->m_EditGeneration != this->m_Image->GetEditGeneration())
+    {
+      this->CatchUpWithEdits(); // the line may have been rewritten
+      return *this;
+    }
     this->m_RealIndex++;
     this->m_SegmentRemainder = (*this->m_RunLengthLine)[this->m_RealIndex].first;
     return *this;
@@ -166,7 +206,17 @@ public:
   Self &
   operator--()
   {
+    if (this->m_RunAxis != 0)
+    {
+      this->SetPixelNumber(this->m_PixelNumber - 1);
+      return *this;
+    }
     this->m_Index0--;
+    if (this->m_EditGeneration != this->m_Image->GetEditGeneration())
+    {
+      this->CatchUpWithEdits(); // the line may have been rewritten
+      return *this;
+    }
     this->m_SegmentRemainder++;
     if (this->m_SegmentRemainder <= (*this->m_RunLengthLine)[this->m_RealIndex].first)
     {
@@ -180,15 +230,15 @@ public:
 };
 
 // Deduction guide for class template argument deduction (CTAD).
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-ImageScanlineConstIterator(SmartPointer<const RLEImage<TPixel, VImageDimension, CounterType>>,
-                           const typename RLEImage<TPixel, VImageDimension, CounterType>::RegionType &)
-  -> ImageScanlineConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>;
-
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-ImageScanlineConstIterator(const RLEImage<TPixel, VImageDimension, CounterType> *,
-                           const typename RLEImage<TPixel, VImageDimension, CounterType>::RegionType &)
-  -> ImageScanlineConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>;
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+ImageScanlineConstIterator(SmartPointer<const RLEImage<TPixel, VImageDimension, CounterType, TLine>>,
+                           const typename RLEImage<TPixel, VImageDimension, CounterType, TLine>::RegionType &)
+  -> ImageScanlineConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>;
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+ImageScanlineConstIterator(const RLEImage<TPixel, VImageDimension, CounterType, TLine> *,
+                           const typename RLEImage<TPixel, VImageDimension, CounterType, TLine>::RegionType &)
+  -> ImageScanlineConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>;
 
 } // end namespace itk
 
@@ -31,14 +31,14 @@ namespace itk
  *  \ingroup RLEImage
  *  \ingroup ITKCommon
  */
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class ImageScanlineIterator<RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageScanlineConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class ImageScanlineIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageScanlineConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
 public:
   /** Standard class type alias. */
   using Self = ImageScanlineIterator;
-  using Superclass = ImageScanlineConstIterator<RLEImage<TPixel, VImageDimension, CounterType>>;
+  using Superclass = ImageScanlineConstIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>;
 
   /** Types inherited from the Superclass */
   using IndexType = typename Superclass::IndexType;
@@ -74,11 +74,15 @@ public:
   void
   Set(const PixelType & value) const
   {
-    const_cast<ImageType *>(this->m_Image.GetPointer())
-      ->SetPixel(*const_cast<typename ImageType::RLLine *>(this->m_RunLengthLine),
-                 this->m_SegmentRemainder,
-                 this->m_RealIndex,
-                 value);
+    this->SetCurrentPixel(value);
+  }
+
+  /** Set length pixels along the run axis, starting with the current one,
+   * see RLEImage::SetRun(). The iterator stays on the current pixel. */
+  void
+  SetRun(SizeValueType length, const PixelType & value) const
+  {
+    this->SetCurrentRun(length, value);
   }
 
   ///** Return a reference to the pixel
@@ -104,16 +108,16 @@ protected:
 };
 
 // Deduction guide for class template argument deduction (CTAD).
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-ImageScanlineIterator(SmartPointer<RLEImage<TPixel, VImageDimension, CounterType>>,
-                      const typename RLEImage<TPixel, VImageDimension, CounterType>::RegionType &)
-  -> ImageScanlineIterator<RLEImage<TPixel, VImageDimension, CounterType>>;
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+ImageScanlineIterator(SmartPointer<RLEImage<TPixel, VImageDimension, CounterType, TLine>>,
+                      const typename RLEImage<TPixel, VImageDimension, CounterType, TLine>::RegionType &)
+  -> ImageScanlineIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>;
 
 // Deduction guide for class template argument deduction (CTAD).
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-ImageScanlineIterator(RLEImage<TPixel, VImageDimension, CounterType> *,
-                      const typename RLEImage<TPixel, VImageDimension, CounterType>::RegionType &)
-  -> ImageScanlineIterator<RLEImage<TPixel, VImageDimension, CounterType>>;
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+ImageScanlineIterator(RLEImage<TPixel, VImageDimension, CounterType, TLine> *,
+                      const typename RLEImage<TPixel, VImageDimension, CounterType, TLine>::RegionType &)
+  -> ImageScanlineIterator<RLEImage<TPixel, VImageDimension, CounterType, TLine>>;
 
 } // end namespace itk
 
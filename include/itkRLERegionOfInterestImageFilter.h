@@ -22,6 +22,8 @@
 #include "itkRLEImage.h"
 #include "itkRegionOfInterestImageFilter.h"
 #include "itkSmartPointer.h"
+#include <array>
+#include <vector>
 
 namespace itk
 {
@@ -44,18 +46,18 @@ namespace itk
  *  \ingroup RLEImage
  *  \ingroup ITKCommon
  */
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
-                                  RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageToImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
-                              RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
+                                  RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageToImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
+                              RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
 public:
   ITK_DISALLOW_COPY_AND_MOVE(RegionOfInterestImageFilter);
 
   /** Standard class type alias. */
   using Self = RegionOfInterestImageFilter;
-  using RLEImageType = RLEImage<TPixel, VImageDimension, CounterType>;
+  using RLEImageType = RLEImage<TPixel, VImageDimension, CounterType, TLine>;
   using ImageType = RLEImageType;
   using Superclass = ImageToImageFilter<RLEImageType, RLEImageType>;
   using Pointer = SmartPointer<Self>;
@@ -81,6 +83,12 @@ public:
   itkSetMacro(RegionOfInterest, RegionType);
   itkGetConstMacro(RegionOfInterest, RegionType);
 
+  /** Set/Get whether the output lines are reallocated to their exact
+   * size after the conversion, see RLEImage::Compact(). Off by default. */
+  itkSetMacro(CompactOutput, bool);
+  itkGetConstMacro(CompactOutput, bool);
+  itkBooleanMacro(CompactOutput);
+
   /** ImageDimension enumeration */
   static constexpr unsigned int ImageDimension = VImageDimension;
   static constexpr unsigned int OutputImageDimension = VImageDimension;
@@ -127,27 +135,63 @@ protected:
   void
   DynamicThreadedGenerateData(const RegionType & outputRegionForThread) override;
 
+  /** Lines are copied with their palette indices. */
+  void
+  BeforeThreadedGenerateData() override
+  {
+    this->GetOutput()->SetPalette(this->GetInput()->GetPalette());
+  }
+
+  /** Splits the output along the axes other than its run axis only,
+   * so that every line is written by a single thread. */
+  void
+  GenerateData() override
+  {
+    this->AllocateOutputs();
+    this->BeforeThreadedGenerateData();
+    this->GetMultiThreader()->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+    this->GetMultiThreader()->template ParallelizeImageRegionRestrictDirection<VImageDimension>(
+      this->GetOutput()->GetRunAxis(),
+      this->GetOutput()->GetRequestedRegion(),
+      [this](const RegionType & outputRegionForThread) { this->DynamicThreadedGenerateData(outputRegionForThread); },
+      this);
+    this->AfterThreadedGenerateData();
+  }
+
+  void
+  AfterThreadedGenerateData() override
+  {
+    if (m_CompactOutput)
+    {
+      this->GetOutput()->Compact();
+    }
+    this->GetOutput()->UpdateSlabSummary(); // lines were written through the buffer
+  }
+
 private:
   RegionType m_RegionOfInterest;
+  bool       m_CompactOutput{ false };
 };
 
 template <typename TPixelIn,
           typename TPixelOut,
           unsigned int VImageDimension,
           typename CounterTypeIn,
-          typename CounterTypeOut>
-class RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn>,
-                                  RLEImage<TPixelOut, VImageDimension, CounterTypeOut>>
-  : public ImageToImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn>,
-                              RLEImage<TPixelOut, VImageDimension, CounterTypeOut>>
+          typename CounterTypeOut,
+          typename TLineIn,
+          typename TLineOut>
+class RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn, TLineIn>,
+                                  RLEImage<TPixelOut, VImageDimension, CounterTypeOut, TLineOut>>
+  : public ImageToImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn, TLineIn>,
+                              RLEImage<TPixelOut, VImageDimension, CounterTypeOut, TLineOut>>
 {
 public:
   ITK_DISALLOW_COPY_AND_MOVE(RegionOfInterestImageFilter);
 
   /** Standard class type alias. */
   using Self = RegionOfInterestImageFilter;
-  using RLEImageTypeIn = RLEImage<TPixelIn, VImageDimension, CounterTypeIn>;
-  using RLEImageTypeOut = RLEImage<TPixelOut, VImageDimension, CounterTypeOut>;
+  using RLEImageTypeIn = RLEImage<TPixelIn, VImageDimension, CounterTypeIn, TLineIn>;
+  using RLEImageTypeOut = RLEImage<TPixelOut, VImageDimension, CounterTypeOut, TLineOut>;
   using ImageType = RLEImageTypeOut;
   using Superclass = ImageToImageFilter<RLEImageTypeIn, RLEImageTypeOut>;
   using Pointer = SmartPointer<Self>;
@@ -173,6 +217,12 @@ public:
   itkSetMacro(RegionOfInterest, RegionType);
   itkGetConstMacro(RegionOfInterest, RegionType);
 
+  /** Set/Get whether the output lines are reallocated to their exact
+   * size after the conversion, see RLEImage::Compact(). Off by default. */
+  itkSetMacro(CompactOutput, bool);
+  itkGetConstMacro(CompactOutput, bool);
+  itkBooleanMacro(CompactOutput);
+
   /** ImageDimension enumeration */
   static constexpr unsigned int ImageDimension = VImageDimension;
   static constexpr unsigned int OutputImageDimension = VImageDimension;
@@ -219,8 +269,53 @@ protected:
   void
   DynamicThreadedGenerateData(const RegionType & outputRegionForThread) override;
 
+  /** Maps every value of the input palette to a value stored by the output,
+   * so the threads translate segments without locking the output palette. */
+  void
+  BeforeThreadedGenerateData() override
+  {
+    m_StoredValues.clear();
+    if constexpr (RLEImageTypeIn::IsPaletteEncoded)
+    {
+      RLEImageTypeOut * out = this->GetOutput();
+      for (const TPixelIn & value : this->GetInput()->GetPalette())
+      {
+        m_StoredValues.push_back(out->EncodeValue(static_cast<TPixelOut>(value)));
+      }
+    }
+  }
+
+  /** Splits the output along the axes other than its run axis only,
+   * so that every line is written by a single thread. */
+  void
+  GenerateData() override
+  {
+    this->AllocateOutputs();
+    this->BeforeThreadedGenerateData();
+    this->GetMultiThreader()->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+    this->GetMultiThreader()->template ParallelizeImageRegionRestrictDirection<VImageDimension>(
+      this->GetOutput()->GetRunAxis(),
+      this->GetOutput()->GetRequestedRegion(),
+      [this](const RegionType & outputRegionForThread) { this->DynamicThreadedGenerateData(outputRegionForThread); },
+      this);
+    this->AfterThreadedGenerateData();
+  }
+
+  void
+  AfterThreadedGenerateData() override
+  {
+    if (m_CompactOutput)
+    {
+      this->GetOutput()->Compact();
+    }
+    this->GetOutput()->UpdateSlabSummary(); // lines were written through the buffer
+  }
+
 private:
   RegionType m_RegionOfInterest;
+  bool       m_CompactOutput{ false };
+
+  std::vector<typename RLEImageTypeOut::RLValueType> m_StoredValues; // by the stored values of the input
 };
 
 // not implemented on purpose, so it will produce a meaningful error message
@@ -234,21 +329,23 @@ template <typename TPixelIn,
           unsigned int VImageDimensionIn,
           unsigned int VImageDimensionOut,
           typename CounterTypeIn,
-          typename CounterTypeOut>
-class RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimensionIn, CounterTypeIn>,
-                                  RLEImage<TPixelOut, VImageDimensionOut, CounterTypeOut>>
+          typename CounterTypeOut,
+          typename TLineIn,
+          typename TLineOut>
+class RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimensionIn, CounterTypeIn, TLineIn>,
+                                  RLEImage<TPixelOut, VImageDimensionOut, CounterTypeOut, TLineOut>>
   : InputAndOutputImagesMustHaveSameDimension<VImageDimensionIn, VImageDimensionOut>
 {};
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class RegionOfInterestImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VImageDimension, CounterType>>
-  : public ImageToImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VImageDimension, CounterType>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class RegionOfInterestImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VImageDimension, CounterType, TLine>>
+  : public ImageToImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VImageDimension, CounterType, TLine>>
 {
 public:
   ITK_DISALLOW_COPY_AND_MOVE(RegionOfInterestImageFilter);
 
   /** Standard class type alias. */
-  using RLEImageType = RLEImage<TPixel, VImageDimension, CounterType>;
+  using RLEImageType = RLEImage<TPixel, VImageDimension, CounterType, TLine>;
 
   using Self = RegionOfInterestImageFilter;
   using ImageType = Image<TPixel, VImageDimension>;
@@ -276,6 +373,38 @@ public:
   itkSetMacro(RegionOfInterest, RegionType);
   itkGetConstMacro(RegionOfInterest, RegionType);
 
+  /** Set/Get whether the output lines are reallocated to their exact
+   * size after the conversion, see RLEImage::Compact(). Off by default. */
+  itkSetMacro(CompactOutput, bool);
+  itkGetConstMacro(CompactOutput, bool);
+  itkBooleanMacro(CompactOutput);
+
+  /** Set/Get the index axis along which the output is run-length encoded,
+   * see RLEImage::SetRunAxis(). Default: 0. */
+  itkSetMacro(RunAxis, unsigned int);
+  itkGetConstMacro(RunAxis, unsigned int);
+
+  /** Set/Get whether the run axis is chosen automatically during the update,
+   * as the axis along which a sample of the input has the fewest segments.
+   * RunAxis is then set to the chosen axis. Off by default. */
+  itkSetMacro(AutomaticRunAxis, bool);
+  itkGetConstMacro(AutomaticRunAxis, bool);
+  itkBooleanMacro(AutomaticRunAxis);
+
+  /** Set/Get whether all-background output lines are stored as absent lines,
+   * see RLEImage::SetSparseLines(). Off by default. */
+  itkSetMacro(SparseLines, bool);
+  itkGetConstMacro(SparseLines, bool);
+  itkBooleanMacro(SparseLines);
+
+  /** Estimated number of output segments if encoded along the given axis.
+   * Set by an update with AutomaticRunAxis on, zero otherwise. */
+  SizeValueType
+  GetEstimatedSegmentCount(unsigned int axis) const
+  {
+    return m_EstimatedSegmentCounts[axis];
+  }
+
   /** ImageDimension enumeration */
   static constexpr unsigned int ImageDimension = VImageDimension;
   static constexpr unsigned int OutputImageDimension = VImageDimension;
@@ -322,19 +451,61 @@ protected:
   void
   DynamicThreadedGenerateData(const RegionType & outputRegionForThread) override;
 
+  /** Splits the output along the axes other than its run axis only,
+   * so that every line is written by a single thread. */
+  void
+  GenerateData() override
+  {
+    if (m_AutomaticRunAxis)
+    {
+      m_RunAxis = this->EstimateRunAxis();
+      this->GetOutput()->SetRunAxis(m_RunAxis);
+    }
+    this->AllocateOutputs();
+    this->BeforeThreadedGenerateData();
+    this->GetMultiThreader()->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+    this->GetMultiThreader()->template ParallelizeImageRegionRestrictDirection<VImageDimension>(
+      this->GetOutput()->GetRunAxis(),
+      this->GetOutput()->GetRequestedRegion(),
+      [this](const RegionType & outputRegionForThread) { this->DynamicThreadedGenerateData(outputRegionForThread); },
+      this);
+    this->AfterThreadedGenerateData();
+  }
+
+  void
+  AfterThreadedGenerateData() override
+  {
+    if (m_CompactOutput)
+    {
+      this->GetOutput()->Compact();
+    }
+    this->GetOutput()->UpdateSlabSummary(); // lines were written through the buffer
+  }
+
+  /** Counts value changes between neighbors along each axis in every few rows
+   * of the input, estimates the segment counts from them, and returns the axis
+   * with the fewest segments among those whose length TLine supports. */
+  unsigned int
+  EstimateRunAxis();
+
 private:
-  RegionType m_RegionOfInterest;
+  RegionType                                 m_RegionOfInterest;
+  bool                                       m_CompactOutput{ false };
+  unsigned int                               m_RunAxis{ 0 };
+  bool                                       m_AutomaticRunAxis{ false };
+  bool                                       m_SparseLines{ false };
+  std::array<SizeValueType, VImageDimension> m_EstimatedSegmentCounts{};
 };
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
-class RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>, Image<TPixel, VImageDimension>>
-  : public ImageToImageFilter<RLEImage<TPixel, VImageDimension, CounterType>, Image<TPixel, VImageDimension>>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+class RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>, Image<TPixel, VImageDimension>>
+  : public ImageToImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>, Image<TPixel, VImageDimension>>
 {
 public:
   ITK_DISALLOW_COPY_AND_MOVE(RegionOfInterestImageFilter);
 
   /** Standard class type alias. */
-  using RLEImageType = RLEImage<TPixel, VImageDimension, CounterType>;
+  using RLEImageType = RLEImage<TPixel, VImageDimension, CounterType, TLine>;
 
   using Self = RegionOfInterestImageFilter;
   using ImageType = Image<TPixel, VImageDimension>;
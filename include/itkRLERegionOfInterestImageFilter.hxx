@@ -21,51 +21,123 @@
 
 #include "itkImage.h"
 #include "itkImageAlgorithm.h"
+#include "itkImageScanlineConstIterator.h"
 #include "itkObjectFactory.h"
 #include "itkRegionOfInterestImageFilter.h"
+#include <atomic>
+#include <limits>
+#include <map>
+#include <type_traits>
 #include <typeinfo>
 
 namespace itk
 {
-template <typename RLEImageTypeIn, typename RLEImageTypeOut>
+/** Palette indices of the pixel values a work unit has met, so that the
+ * palette of the image is locked once per value rather than once per run. */
+template <typename RLEImageType>
+class PaletteIndexCache
+{
+public:
+  explicit PaletteIndexCache(RLEImageType * image)
+    : m_Image(image)
+  {}
+
+  typename RLEImageType::RLValueType
+  EncodeValue(const typename RLEImageType::PixelType & value)
+  {
+    if constexpr (RLEImageType::IsPaletteEncoded)
+    {
+      auto found = m_Indices.find(value);
+      if (found == m_Indices.end())
+      {
+        found = m_Indices.emplace(value, m_Image->EncodeValue(value)).first;
+      }
+      return found->second;
+    }
+    else
+    {
+      return value;
+    }
+  }
+
+private:
+  RLEImageType * m_Image;
+  std::map<typename RLEImageType::PixelType,
+           typename RLEImageType::RLValueType,
+           typename RLEImageType::PixelLess>
+    m_Indices;
+};
+
+/** Copies the part of the lines of in between start0 and end0 into the lines of out.
+ * convertStoredValue turns a value stored in a segment of in into one to store in out. */
+template <typename RLEImageTypeIn, typename RLEImageTypeOut, typename TConvert>
 void
-copyImagePortion(ImageRegionConstIterator<typename RLEImageTypeIn::BufferType> iIt,
+copyImagePortion(const RLEImageTypeIn *                                        in,
+                 RLEImageTypeOut *                                             out,
+                 TConvert                                                      convertStoredValue,
+                 ImageRegionConstIterator<typename RLEImageTypeIn::BufferType> iIt,
                  ImageRegionIterator<typename RLEImageTypeOut::BufferType>     oIt,
                  IndexValueType                                                start0,
                  IndexValueType                                                end0)
 {
+  typename RLEImageTypeIn::RLLine      frozenLine; // decoded line of a frozen input
+  typename RLEImageTypeIn::RLValueType uniform;    // stored value of a uniform input slab
+  constexpr unsigned int               slabDim = RLEImageTypeIn::ImageDimension - 2;
+
+  // absent input lines stay absent if background stays background
+  const bool keepAbsent =
+    out->GetSparseLines() && !in->IsFrozen() &&
+    convertStoredValue(typename RLEImageTypeIn::RLValueType()) == typename RLEImageTypeOut::RLValueType();
+  auto finishLine = [out](typename RLEImageTypeOut::RLLine & oLine) {
+    if (out->GetSparseLines() && out->IsBackgroundLine(oLine))
+    {
+      oLine = typename RLEImageTypeOut::RLLine(); // absent line
+    }
+    else if constexpr (RLEImageTypeOut::RLLine::StoresPixelRows)
+    {
+      oLine.shrink_to_fit(); // a noisy line becomes a row of pixels
+    }
+  };
   while (!oIt.IsAtEnd())
   {
     // determine begin and end iterator and copy range
     typename RLEImageTypeOut::RLLine & oLine = oIt.Value();
     oLine.clear();
-    const typename RLEImageTypeIn::RLLine & iLine = iIt.Value();
-    typename RLEImageTypeIn::RLCounterType  t = 0;
-    SizeValueType                           x = 0;
-    // find start
-    for (; x < iLine.size(); x++)
+    if (keepAbsent && iIt.Value().empty())
     {
-      t += iLine[x].first;
-      if (t > start0)
-      {
-        break;
-      }
+      oLine = typename RLEImageTypeOut::RLLine(); // releases the storage
+      ++iIt;
+      ++oIt;
+      continue;
     }
+    if (in->IsUniformSlab(iIt.GetIndex()[slabDim], uniform)) // the input line is not read
+    {
+      RLEImageTypeOut::AppendRun(oLine, end0 - start0, convertStoredValue(uniform));
+      finishLine(oLine);
+      ++iIt;
+      ++oIt;
+      continue;
+    }
+    const typename RLEImageTypeIn::RLLine & iLine =
+      in->IsFrozen() ? in->GetLine(iIt.GetIndex(), frozenLine) : in->ResolveLine(iIt.Value());
+    IndexValueType                          t = 0;
+    // find start
+    SizeValueType x = iLine.FindSegment(start0, t);
     assert(x < iLine.size());
+    t += start0; // end of segment x
 
     SizeValueType begin = x;
     if (t >= end0) // both begin and end are in this segment
     {
-      oLine.push_back(
-        typename RLEImageTypeOut::RLSegment(typename RLEImageTypeOut::RLCounterType(end0 - start0), iLine[x].second));
+      RLEImageTypeOut::AppendRun(oLine, end0 - start0, convertStoredValue(iLine[x].second));
+      finishLine(oLine);
       ++iIt;
       ++oIt;
       continue; // next line
     }
     else if (t - start0 < iLine[x].first) // not the first pixel in segment
     {
-      oLine.push_back(
-        typename RLEImageTypeOut::RLSegment(typename RLEImageTypeOut::RLCounterType(t - start0), iLine[x].second));
+      RLEImageTypeOut::AppendRun(oLine, t - start0, convertStoredValue(iLine[x].second));
       begin++; // start copying from next segment
     }
     for (x++; x < iLine.size(); x++)
@@ -76,37 +148,36 @@ copyImagePortion(ImageRegionConstIterator<typename RLEImageTypeIn::BufferType> i
         break;
       }
     }
-    if (t == end0)
-    {
-      oLine.insert(oLine.end(), iLine.begin() + begin, iLine.begin() + x + 1);
-    }
-    else // we need to take special care of the last segment
+    for (; begin < x; begin++)
     {
-      oLine.insert(oLine.end(), iLine.begin() + begin, iLine.begin() + x);
-      oLine.push_back(typename RLEImageTypeOut::RLSegment(
-        typename RLEImageTypeOut::RLCounterType(end0 + iLine[x].first - t), iLine[x].second));
+      RLEImageTypeOut::AppendRun(oLine, iLine[begin].first, convertStoredValue(iLine[begin].second));
     }
+    // the last segment might be cut short
+    const IndexValueType lastCount = end0 + iLine[x].first - t;
+    RLEImageTypeOut::AppendRun(oLine, lastCount, convertStoredValue(iLine[x].second));
+    finishLine(oLine);
 
     ++iIt;
     ++oIt;
   }
 } // copyImagePortion
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
-                            RLEImage<TPixel, VImageDimension, CounterType>>::PrintSelf(std::ostream & os,
-                                                                                       Indent         indent) const
+RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
+                            RLEImage<TPixel, VImageDimension, CounterType, TLine>>::PrintSelf(std::ostream & os,
+                                                                                              Indent indent) const
 {
   Superclass::PrintSelf(os, indent);
 
   os << indent << "RegionOfInterest: " << m_RegionOfInterest << std::endl;
+  os << indent << "CompactOutput: " << m_CompactOutput << std::endl;
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
-                            RLEImage<TPixel, VImageDimension, CounterType>>::GenerateInputRequestedRegion()
+RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
+                            RLEImage<TPixel, VImageDimension, CounterType, TLine>>::GenerateInputRequestedRegion()
 {
   // call the superclass' implementation of this method
   Superclass::GenerateInputRequestedRegion();
@@ -121,11 +192,11 @@ RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
   }
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
-                            RLEImage<TPixel, VImageDimension, CounterType>>::EnlargeOutputRequestedRegion(DataObject *
-                                                                                                            output)
+RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
+                            RLEImage<TPixel, VImageDimension, CounterType, TLine>>::
+  EnlargeOutputRequestedRegion(DataObject * output)
 {
   // call the superclass' implementation of this method
   Superclass::EnlargeOutputRequestedRegion(output);
@@ -135,10 +206,10 @@ RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
 }
 
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
-                            RLEImage<TPixel, VImageDimension, CounterType>>::GenerateOutputInformation()
+RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
+                            RLEImage<TPixel, VImageDimension, CounterType, TLine>>::GenerateOutputInformation()
 {
   // do not call the superclass' implementation of this method since
   // this filter allows the input the output to be of different dimensions
@@ -162,6 +233,9 @@ RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
 
   // Copy Information without modification.
   outputPtr->CopyInformation(inputPtr);
+  outputPtr->SetRunAxis(inputPtr->GetRunAxis()); // lines are copied
+  outputPtr->SetSparseLines(inputPtr->GetSparseLines());
+  outputPtr->SetSlabSummary(inputPtr->GetSlabSummary());
 
   // Adjust output region
   outputPtr->SetLargestPossibleRegion(region);
@@ -174,11 +248,11 @@ RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
 } // >::GenerateOutputInformation
 
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<
-  RLEImage<TPixel, VImageDimension, CounterType>,
-  RLEImage<TPixel, VImageDimension, CounterType>>::DynamicThreadedGenerateData(const RegionType & outputRegionForThread)
+RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
+                            RLEImage<TPixel, VImageDimension, CounterType, TLine>>::
+  DynamicThreadedGenerateData(const RegionType & outputRegionForThread)
 {
   // Get the input and output pointers
   const RLEImageType * in = this->GetInput();
@@ -188,14 +262,17 @@ RegionOfInterestImageFilter<
   // so we ignore all the output regions which do not start
   // at the beginning of a line.
   // But the regions which do start at the beginning of a line
-  // must process the whole line
-  RegionType reqRegion = out->GetRequestedRegion();
-  if (reqRegion.GetIndex(0) != outputRegionForThread.GetIndex(0))
+  // must process the whole line.
+  // AllocateOutputs() left the output lines absent, without any storage:
+  // each of them is assigned exactly once below (see RLEImage::GetBufferForOverwrite()).
+  const unsigned int runAxis = out->GetRunAxis();
+  RegionType         reqRegion = out->GetRequestedRegion();
+  if (reqRegion.GetIndex(runAxis) != outputRegionForThread.GetIndex(runAxis))
   {
     return; // another thread will process this
   }
   RegionType outRegion = outputRegionForThread;
-  outRegion.SetSize(0, reqRegion.GetSize(0));
+  outRegion.SetSize(runAxis, reqRegion.GetSize(runAxis));
 
   // Define the portion of the input to walk for this thread
   InputImageRegionType inputRegionForThread;
@@ -212,17 +289,33 @@ RegionOfInterestImageFilter<
   }
   inputRegionForThread.SetIndex(start);
 
-  bool copyLines = (in->GetLargestPossibleRegion().GetSize(0) == outRegion.GetSize(0));
-  typename ImageType::BufferType::RegionType               oReg = outRegion.Slice(0);
-  typename ImageType::BufferType::RegionType               iReg = inputRegionForThread.Slice(0);
+  bool copyLines = (in->GetLargestPossibleRegion().GetSize(runAxis) == outRegion.GetSize(runAxis));
+  typename ImageType::BufferType::RegionType               oReg = outRegion.Slice(runAxis);
+  typename ImageType::BufferType::RegionType               iReg = inputRegionForThread.Slice(runAxis);
   ImageRegionConstIterator<typename ImageType::BufferType> iIt(in->GetBuffer(), iReg);
-  ImageRegionIterator<typename ImageType::BufferType>      oIt(out->GetBuffer(), oReg);
+  ImageRegionIterator<typename ImageType::BufferType>      oIt(out->GetBufferForOverwrite(), oReg);
 
   if (copyLines)
   {
     while (!oIt.IsAtEnd())
     {
-      oIt.Set(iIt.Get());
+      if (in->IsFrozen())
+      {
+        in->GetLine(iIt.GetIndex(), oIt.Value()); // decodes into the output line
+        if (out->GetSparseLines() && out->IsBackgroundLine(oIt.Value()))
+        {
+          oIt.Value() = typename ImageType::RLLine(); // absent line
+        }
+        else if constexpr (TLine::StoresPixelRows)
+        {
+          oIt.Value().shrink_to_fit(); // a noisy line becomes a row of pixels
+        }
+      }
+      else
+      {
+        const typename ImageType::RLLine & iLine = iIt.Value();
+        oIt.Set(out->GetSparseLines() ? iLine : in->ResolveLine(iLine));
+      }
 
       ++iIt;
       ++oIt;
@@ -230,7 +323,11 @@ RegionOfInterestImageFilter<
   }
   else
   {
-    copyImagePortion<ImageType, ImageType>(iIt, oIt, start[0], end[0]);
+    // positions within the lines are relative to the buffered region
+    const IndexValueType bufferStart = in->GetBufferedRegion().GetIndex(runAxis);
+    auto sharedPalette = [](const typename ImageType::RLValueType & value) { return value; };
+    copyImagePortion<ImageType, ImageType>(
+      in, out, sharedPalette, iIt, oIt, start[runAxis] - bufferStart, end[runAxis] - bufferStart);
   }
 } // DynamicThreadedGenerateData
 
@@ -238,25 +335,31 @@ template <typename TPixelIn,
           typename TPixelOut,
           unsigned int VImageDimension,
           typename CounterTypeIn,
-          typename CounterTypeOut>
+          typename CounterTypeOut,
+          typename TLineIn,
+          typename TLineOut>
 void
-RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn>,
-                            RLEImage<TPixelOut, VImageDimension, CounterTypeOut>>::PrintSelf(std::ostream & os,
-                                                                                             Indent indent) const
+RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn, TLineIn>,
+                            RLEImage<TPixelOut, VImageDimension, CounterTypeOut, TLineOut>>::
+  PrintSelf(std::ostream & os, Indent indent) const
 {
   Superclass::PrintSelf(os, indent);
 
   os << indent << "RegionOfInterest: " << m_RegionOfInterest << std::endl;
+  os << indent << "CompactOutput: " << m_CompactOutput << std::endl;
 }
 
 template <typename TPixelIn,
           typename TPixelOut,
           unsigned int VImageDimension,
           typename CounterTypeIn,
-          typename CounterTypeOut>
+          typename CounterTypeOut,
+          typename TLineIn,
+          typename TLineOut>
 void
-RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn>,
-                            RLEImage<TPixelOut, VImageDimension, CounterTypeOut>>::GenerateInputRequestedRegion()
+RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn, TLineIn>,
+                            RLEImage<TPixelOut, VImageDimension, CounterTypeOut, TLineOut>>::
+  GenerateInputRequestedRegion()
 {
   // call the superclass' implementation of this method
   Superclass::GenerateInputRequestedRegion();
@@ -275,11 +378,13 @@ template <typename TPixelIn,
           typename TPixelOut,
           unsigned int VImageDimension,
           typename CounterTypeIn,
-          typename CounterTypeOut>
+          typename CounterTypeOut,
+          typename TLineIn,
+          typename TLineOut>
 void
 RegionOfInterestImageFilter<
-  RLEImage<TPixelIn, VImageDimension, CounterTypeIn>,
-  RLEImage<TPixelOut, VImageDimension, CounterTypeOut>>::EnlargeOutputRequestedRegion(DataObject * output)
+  RLEImage<TPixelIn, VImageDimension, CounterTypeIn, TLineIn>,
+  RLEImage<TPixelOut, VImageDimension, CounterTypeOut, TLineOut>>::EnlargeOutputRequestedRegion(DataObject * output)
 {
   // call the superclass' implementation of this method
   Superclass::EnlargeOutputRequestedRegion(output);
@@ -293,10 +398,12 @@ template <typename TPixelIn,
           typename TPixelOut,
           unsigned int VImageDimension,
           typename CounterTypeIn,
-          typename CounterTypeOut>
+          typename CounterTypeOut,
+          typename TLineIn,
+          typename TLineOut>
 void
-RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn>,
-                            RLEImage<TPixelOut, VImageDimension, CounterTypeOut>>::GenerateOutputInformation()
+RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn, TLineIn>,
+                            RLEImage<TPixelOut, VImageDimension, CounterTypeOut, TLineOut>>::GenerateOutputInformation()
 {
   // do not call the superclass' implementation of this method since
   // this filter allows the input the output to be of different dimensions
@@ -320,6 +427,9 @@ RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn>,
 
   // Copy Information without modification.
   outputPtr->CopyInformation(inputPtr);
+  outputPtr->SetRunAxis(inputPtr->GetRunAxis()); // lines are copied
+  outputPtr->SetSparseLines(inputPtr->GetSparseLines());
+  outputPtr->SetSlabSummary(inputPtr->GetSlabSummary());
 
   // Adjust output region
   outputPtr->SetLargestPossibleRegion(region);
@@ -336,10 +446,12 @@ template <typename TPixelIn,
           typename TPixelOut,
           unsigned int VImageDimension,
           typename CounterTypeIn,
-          typename CounterTypeOut>
+          typename CounterTypeOut,
+          typename TLineIn,
+          typename TLineOut>
 void
-RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn>,
-                            RLEImage<TPixelOut, VImageDimension, CounterTypeOut>>::
+RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn, TLineIn>,
+                            RLEImage<TPixelOut, VImageDimension, CounterTypeOut, TLineOut>>::
   DynamicThreadedGenerateData(const RegionType & outputRegionForThread)
 {
   // Get the input and output pointers
@@ -350,14 +462,17 @@ RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn>,
   // so we ignore all the output regions which do not start
   // at the beginning of a line.
   // But the regions which do start at the beginning of a line
-  // must process the whole line
-  RegionType reqRegion = out->GetRequestedRegion();
-  if (reqRegion.GetIndex(0) != outputRegionForThread.GetIndex(0))
+  // must process the whole line.
+  // AllocateOutputs() left the output lines absent, without any storage:
+  // each of them is assigned exactly once below (see RLEImage::GetBufferForOverwrite()).
+  const unsigned int runAxis = out->GetRunAxis();
+  RegionType         reqRegion = out->GetRequestedRegion();
+  if (reqRegion.GetIndex(runAxis) != outputRegionForThread.GetIndex(runAxis))
   {
     return; // another thread will process this
   }
   RegionType outRegion = outputRegionForThread;
-  outRegion.SetSize(0, reqRegion.GetSize(0));
+  outRegion.SetSize(runAxis, reqRegion.GetSize(runAxis));
 
   // Define the portion of the input to walk for this thread
   InputImageRegionType inputRegionForThread;
@@ -374,29 +489,49 @@ RegionOfInterestImageFilter<RLEImage<TPixelIn, VImageDimension, CounterTypeIn>,
   }
   inputRegionForThread.SetIndex(start);
 
-  typename RLEImageTypeIn::BufferType::RegionType               iReg = inputRegionForThread.Slice(0);
-  typename RLEImageTypeOut::BufferType::RegionType              oReg = outRegion.Slice(0);
+  typename RLEImageTypeIn::BufferType::RegionType               iReg = inputRegionForThread.Slice(runAxis);
+  typename RLEImageTypeOut::BufferType::RegionType              oReg = outRegion.Slice(runAxis);
   ImageRegionConstIterator<typename RLEImageTypeIn::BufferType> iIt(in->GetBuffer(), iReg);
-  ImageRegionIterator<typename RLEImageTypeOut::BufferType>     oIt(out->GetBuffer(), oReg);
-
-  copyImagePortion<RLEImageTypeIn, RLEImageTypeOut>(iIt, oIt, start[0], end[0]);
+  ImageRegionIterator<typename RLEImageTypeOut::BufferType>     oIt(out->GetBufferForOverwrite(), oReg);
+
+  // positions within the lines are relative to the buffered region
+  const IndexValueType bufferStart = in->GetBufferedRegion().GetIndex(runAxis);
+  // palette indices of in go through the table made by BeforeThreadedGenerateData(),
+  // other values are encoded once per work unit
+  PaletteIndexCache<RLEImageTypeOut> cache(out);
+  auto convert = [this, in, &cache](const typename RLEImageTypeIn::RLValueType & value) {
+    if constexpr (RLEImageTypeIn::IsPaletteEncoded)
+    {
+      return m_StoredValues[value];
+    }
+    else
+    {
+      return cache.EncodeValue(static_cast<TPixelOut>(in->DecodeValue(value)));
+    }
+  };
+  copyImagePortion<RLEImageTypeIn, RLEImageTypeOut>(
+    in, out, convert, iIt, oIt, start[runAxis] - bufferStart, end[runAxis] - bufferStart);
 } // DynamicThreadedGenerateData
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VImageDimension, CounterType>>::PrintSelf(
-  std::ostream & os,
-  Indent         indent) const
+RegionOfInterestImageFilter<Image<TPixel, VImageDimension>,
+                            RLEImage<TPixel, VImageDimension, CounterType, TLine>>::PrintSelf(std::ostream & os,
+                                                                                              Indent indent) const
 {
   Superclass::PrintSelf(os, indent);
 
   os << indent << "RegionOfInterest: " << m_RegionOfInterest << std::endl;
+  os << indent << "CompactOutput: " << m_CompactOutput << std::endl;
+  os << indent << "RunAxis: " << m_RunAxis << std::endl;
+  os << indent << "AutomaticRunAxis: " << m_AutomaticRunAxis << std::endl;
+  os << indent << "SparseLines: " << m_SparseLines << std::endl;
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
 RegionOfInterestImageFilter<Image<TPixel, VImageDimension>,
-                            RLEImage<TPixel, VImageDimension, CounterType>>::GenerateInputRequestedRegion()
+                            RLEImage<TPixel, VImageDimension, CounterType, TLine>>::GenerateInputRequestedRegion()
 {
   // call the superclass' implementation of this method
   Superclass::GenerateInputRequestedRegion();
@@ -411,9 +546,9 @@ RegionOfInterestImageFilter<Image<TPixel, VImageDimension>,
   }
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VImageDimension, CounterType>>::
+RegionOfInterestImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VImageDimension, CounterType, TLine>>::
   EnlargeOutputRequestedRegion(DataObject * output)
 {
   // call the superclass' implementation of this method
@@ -424,10 +559,10 @@ RegionOfInterestImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VIm
 }
 
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
 RegionOfInterestImageFilter<Image<TPixel, VImageDimension>,
-                            RLEImage<TPixel, VImageDimension, CounterType>>::GenerateOutputInformation()
+                            RLEImage<TPixel, VImageDimension, CounterType, TLine>>::GenerateOutputInformation()
 {
   // do not call the superclass' implementation of this method since
   // this filter allows the input the output to be of different dimensions
@@ -451,6 +586,8 @@ RegionOfInterestImageFilter<Image<TPixel, VImageDimension>,
 
   // Copy Information without modification.
   outputPtr->CopyInformation(inputPtr);
+  outputPtr->SetRunAxis(m_RunAxis);
+  outputPtr->SetSparseLines(m_SparseLines);
 
   // Adjust output region
   outputPtr->SetLargestPossibleRegion(region);
@@ -463,9 +600,100 @@ RegionOfInterestImageFilter<Image<TPixel, VImageDimension>,
 } // >::GenerateOutputInformation
 
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
+unsigned int
+RegionOfInterestImageFilter<Image<TPixel, VImageDimension>,
+                            RLEImage<TPixel, VImageDimension, CounterType, TLine>>::EstimateRunAxis()
+{
+  const ImageType *   in = this->GetInput();
+  const RegionType &  roi = m_RegionOfInterest;
+  const SizeValueType pixelCount = roi.GetNumberOfPixels();
+  if (pixelCount == 0)
+  {
+    return m_RunAxis;
+  }
+  const SizeValueType rowCount = pixelCount / roi.GetSize(0);
+
+  // visit every step-th row (along axis 0), about a million pixels
+  const SizeValueType        step = std::max<SizeValueType>(1, pixelCount >> 20);
+  std::atomic<SizeValueType> sampledRows{ 0 };
+  std::atomic<SizeValueType> changes[VImageDimension]; // between neighbors along each axis
+  for (auto & c : changes)
+  {
+    c = 0;
+  }
+
+  this->GetMultiThreader()->template ParallelizeImageRegionRestrictDirection<VImageDimension>(
+    0,
+    roi,
+    [&](const RegionType & region) {
+      SizeValueType                         rows = 0;
+      SizeValueType                         counts[VImageDimension] = {};
+      ImageScanlineConstIterator<ImageType> it(in, region);
+      for (; !it.IsAtEnd(); it.NextLine())
+      {
+        const IndexType rowStart = it.GetIndex();
+        SizeValueType   row = 0; // number of this row within the region of interest
+        for (unsigned int i = VImageDimension - 1; i > 0; i--)
+        {
+          row = row * roi.GetSize(i) + (rowStart[i] - roi.GetIndex(i));
+        }
+        if (row % step != 0)
+        {
+          continue;
+        }
+        ++rows;
+
+        const TPixel * p = in->GetBufferPointer() + in->ComputeOffset(rowStart);
+        for (unsigned int a = 0; a < VImageDimension; a++)
+        {
+          if (a > 0 && rowStart[a] == roi.GetIndex(a))
+          {
+            continue; // no neighbors along a
+          }
+          const OffsetValueType stride = in->GetOffsetTable()[a];
+          for (SizeValueType x = (a == 0 ? 1 : 0); x < roi.GetSize(0); x++)
+          {
+            counts[a] += !RLEImageType::IsSamePixel(p[x], p[x - stride]);
+          }
+        }
+      }
+      sampledRows += rows;
+      for (unsigned int a = 0; a < VImageDimension; a++)
+      {
+        changes[a] += counts[a];
+      }
+    },
+    nullptr);
+
+  // every line starts a segment, and so does every change along it
+  const double scale = double(rowCount) / sampledRows;
+  for (unsigned int a = 0; a < VImageDimension; a++)
+  {
+    m_EstimatedSegmentCounts[a] = pixelCount / roi.GetSize(a) + SizeValueType(changes[a] * scale + 0.5);
+  }
+
+  // ties go to the lower axis, which iterates faster
+  unsigned int best = VImageDimension;
+  for (unsigned int a = 0; a < VImageDimension; a++)
+  {
+    if ((!TLine::LimitsLineLength || roi.GetSize(a) <= RLEImageType::MaximumSegmentLength) &&
+        (best == VImageDimension || m_EstimatedSegmentCounts[a] < m_EstimatedSegmentCounts[best]))
+    {
+      best = a;
+    }
+  }
+  if (best == VImageDimension)
+  {
+    return m_RunAxis; // no line is short enough, Allocate() will complain
+  }
+  itkDebugMacro("Run axis " << best << ", estimated segment count " << m_EstimatedSegmentCounts[best]);
+  return best;
+} // >::EstimateRunAxis
+
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VImageDimension, CounterType>>::
+RegionOfInterestImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VImageDimension, CounterType, TLine>>::
   DynamicThreadedGenerateData(const RegionType & outputRegionForThread)
 {
   // Get the input and output pointers
@@ -476,73 +704,99 @@ RegionOfInterestImageFilter<Image<TPixel, VImageDimension>, RLEImage<TPixel, VIm
   // so we ignore all the output regions which do not start
   // at the beginning of a line.
   // But the regions which do start at the beginning of a line
-  // must process the whole line
-  RegionType reqRegion = out->GetRequestedRegion();
-  if (reqRegion.GetIndex(0) != outputRegionForThread.GetIndex(0))
+  // must process the whole line.
+  // AllocateOutputs() left the output lines absent, without any storage:
+  // each of them is assigned exactly once below (see RLEImage::GetBufferForOverwrite()).
+  const unsigned int runAxis = out->GetRunAxis();
+  RegionType         reqRegion = out->GetRequestedRegion();
+  if (reqRegion.GetIndex(runAxis) != outputRegionForThread.GetIndex(runAxis))
   {
     return; // another thread will process this
   }
   RegionType outRegion = outputRegionForThread;
-  outRegion.SetSize(0, reqRegion.GetSize(0));
-
-  // Define the portion of the input to walk for this thread
-  InputImageRegionType inputRegionForThread;
+  outRegion.SetSize(runAxis, reqRegion.GetSize(runAxis));
 
-  inputRegionForThread.SetSize(outRegion.GetSize());
-
-  IndexType start, end;
   IndexType roiStart(m_RegionOfInterest.GetIndex());
-  IndexType threadStart(outRegion.GetIndex());
-  for (unsigned int i = 0; i < VImageDimension; i++)
-  {
-    start[i] = roiStart[i] + threadStart[i];
-    end[i] = roiStart[i] + threadStart[i] + outRegion.GetSize(i);
-  }
-  inputRegionForThread.SetIndex(start);
 
-  typename RLEImageType::BufferType::RegionType          oReg = outRegion.Slice(0);
-  ImageRegionConstIterator<ImageType>                    iIt(in, inputRegionForThread);
-  ImageRegionIterator<typename RLEImageType::BufferType> oIt(out->GetBuffer(), oReg);
-  SizeValueType                                          size0 = outRegion.GetSize(0);
-  typename RLEImageType::RLLine                          temp;
-  temp.reserve(size0); // pessimistically preallocate buffer, otherwise reallocations can occur
+  typename RLEImageType::BufferType::RegionType          oReg = outRegion.Slice(runAxis);
+  ImageRegionIterator<typename RLEImageType::BufferType> oIt(out->GetBufferForOverwrite(), oReg);
+  SizeValueType                                          size0 = outRegion.GetSize(runAxis);
+  const OffsetValueType                                  stride = in->GetOffsetTable()[runAxis];
+  constexpr SizeValueType                                maxCount = RLEImageType::MaximumSegmentLength;
+
+  // equal pixels belong to the same run, distinct ones get distinct palette indices
+  auto sameRun = [](const TPixel & a, const TPixel & b) { return RLEImageType::IsSamePixel(a, b); };
+  PaletteIndexCache<RLEImageType> cache(out);
 
   while (!oIt.IsAtEnd())
   {
-    SizeValueType x = 0;
-    temp.clear();
-    while (x < size0)
+    // the input pixels of this line are stride apart
+    IndexType lineStart = out->GetIndexOnLine(oIt.GetIndex(), outRegion.GetIndex(runAxis));
+    for (unsigned int i = 0; i < VImageDimension; i++)
+    {
+      lineStart[i] += roiStart[i];
+    }
+    const TPixel * lineBegin = in->GetBufferPointer() + in->ComputeOffset(lineStart);
+
+    // first pass counts the segments, so the line is allocated exactly once
+    SizeValueType  segmentCount = 0;
+    bool           background = true;
+    const TPixel * iPtr = lineBegin;
+    for (SizeValueType x = 0; x < size0;)
     {
-      typename RLEImageType::RLSegment s(0, iIt.Value());
-      while (x < size0 && iIt.Value() == s.second)
+      const TPixel  value = *iPtr;
+      SizeValueType count = 0;
+      for (; x < size0 && sameRun(*iPtr, value); x++, count++)
       {
-        x++;
-        s.first++;
-        ++(iIt);
+        iPtr += stride;
       }
+      segmentCount += (count + maxCount - 1) / maxCount; // runs too long for CounterType are split
+      background &= sameRun(value, TPixel());
+    }
 
-      temp.push_back(s);
+    typename RLEImageType::RLLine & oLine = oIt.Value();
+    if (out->GetSparseLines() && background)
+    {
+      oLine = typename RLEImageType::RLLine(); // absent line
+      ++oIt;
+      continue;
     }
 
-    oIt.Value() = temp;
+    // second pass appends the runs directly to the output line
+    oLine.clear();
+    oLine.reserve(segmentCount);
+    iPtr = lineBegin;
+    for (SizeValueType x = 0; x < size0;)
+    {
+      const TPixel  value = *iPtr;
+      SizeValueType count = 0;
+      for (; x < size0 && sameRun(*iPtr, value); x++, count++)
+      {
+        iPtr += stride;
+      }
+      RLEImageType::AppendRun(oLine, count, cache.EncodeValue(value));
+    }
+    if constexpr (TLine::StoresPixelRows)
+    {
+      oLine.shrink_to_fit(); // a noisy line becomes a row of pixels
+    }
     ++oIt;
   }
 } // DynamicThreadedGenerateData
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>, Image<TPixel, VImageDimension>>::PrintSelf(
-  std::ostream & os,
-  Indent         indent) const
+RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
+                            Image<TPixel, VImageDimension>>::PrintSelf(std::ostream & os, Indent indent) const
 {
   Superclass::PrintSelf(os, indent);
 
   os << indent << "RegionOfInterest: " << m_RegionOfInterest << std::endl;
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
+RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
                             Image<TPixel, VImageDimension>>::GenerateInputRequestedRegion()
 {
   // call the superclass' implementation of this method
@@ -558,9 +812,9 @@ RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
   }
 }
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
+RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
                             Image<TPixel, VImageDimension>>::EnlargeOutputRequestedRegion(DataObject * output)
 {
   // call the superclass' implementation of this method
@@ -571,9 +825,9 @@ RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
 }
 
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
+RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>,
                             Image<TPixel, VImageDimension>>::GenerateOutputInformation()
 {
   // do not call the superclass' implementation of this method since
@@ -609,9 +863,9 @@ RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>,
   outputPtr->SetOrigin(outputOrigin);
 } // >::GenerateOutputInformation
 
-template <typename TPixel, unsigned int VImageDimension, typename CounterType>
+template <typename TPixel, unsigned int VImageDimension, typename CounterType, typename TLine>
 void
-RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>, Image<TPixel, VImageDimension>>::
+RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType, TLine>, Image<TPixel, VImageDimension>>::
   DynamicThreadedGenerateData(const RegionType & outputRegionForThread)
 {
   // Get the input and output pointers
@@ -633,62 +887,68 @@ RegionOfInterestImageFilter<RLEImage<TPixel, VImageDimension, CounterType>, Imag
   }
   inputRegionForThread.SetIndex(start);
 
-  typename RLEImageType::BufferType::RegionType               iReg = inputRegionForThread.Slice(0);
+  // positions within the lines are relative to the buffered region
+  const unsigned int                                          runAxis = in->GetRunAxis();
+  const IndexValueType                                        bufferStart = in->GetBufferedRegion().GetIndex(runAxis);
+  const IndexValueType                                        start0 = start[runAxis] - bufferStart;
+  const IndexValueType                                        end0 = end[runAxis] - bufferStart;
+  const OffsetValueType                                       stride = out->GetOffsetTable()[runAxis];
+  typename RLEImageType::BufferType::RegionType               iReg = inputRegionForThread.Slice(runAxis);
   ImageRegionConstIterator<typename RLEImageType::BufferType> iIt(in->GetBuffer(), iReg);
-  ImageRegionIterator<ImageType>                              oIt(out, outputRegionForThread);
+  typename RLEImageType::RLLine                               frozenLine; // decoded line of a frozen input
+  typename RLEImageType::RLValueType                          uniform;    // stored value of a uniform slab
 
   while (!iIt.IsAtEnd())
   {
-    const typename RLEImageType::RLLine & iLine = iIt.Value();
-    CounterType                           t = 0;
-    SizeValueType                         x = 0;
-    // find start
-    for (; x < iLine.size(); x++)
+    // the output pixels of this line are stride apart
+    IndexType oIndex = in->GetIndexOnLine(iIt.GetIndex(), start[runAxis]);
+    for (unsigned int i = 0; i < VImageDimension; i++)
     {
-      t += iLine[x].first;
-      if (t > start[0])
+      oIndex[i] -= roiStart[i];
+    }
+    TPixel * oPtr = out->GetBufferPointer() + out->ComputeOffset(oIndex);
+    auto     fill = [&oPtr, stride](const TPixel & value, IndexValueType count) {
+      for (IndexValueType i = 0; i < count; i++, oPtr += stride)
       {
-        break;
+        *oPtr = value;
       }
+    };
+
+    if (in->IsUniformSlab(iIt.GetIndex()[VImageDimension - 2], uniform)) // the line is not read
+    {
+      fill(in->DecodeValue(uniform), end0 - start0);
+      ++iIt;
+      continue;
     }
+
+    const typename RLEImageType::RLLine & iLine =
+      in->IsFrozen() ? in->GetLine(iIt.GetIndex(), frozenLine) : in->ResolveLine(iIt.Value());
+    IndexValueType                        t = 0;
+    // find start
+    SizeValueType x = iLine.FindSegment(start0, t);
     assert(x < iLine.size());
+    t += start0; // end of segment x
 
-    if (t >= end[0]) // both begin and end are in this segment
+    if (t >= end0) // both begin and end are in this segment
     {
-      for (IndexValueType i = start[0]; i < end[0]; i++)
-      {
-        oIt.Set(iLine[x].second);
-        ++oIt;
-      }
+      fill(in->DecodeValue(iLine[x].second), end0 - start0);
       ++iIt;
       continue; // next line
     }
     // else handle the beginning segment
-    for (IndexValueType i = start[0]; i < t; i++)
-    {
-      oIt.Set(iLine[x].second);
-      ++oIt;
-    }
+    fill(in->DecodeValue(iLine[x].second), t - start0);
     // now handle middle segments
     for (x++; x < iLine.size(); x++)
     {
       t += iLine[x].first;
-      if (t >= end[0])
+      if (t >= end0)
       {
         break;
       }
-      for (CounterType i = 0; i < iLine[x].first; i++)
-      {
-        oIt.Set(iLine[x].second);
-        ++oIt;
-      }
+      fill(in->DecodeValue(iLine[x].second), iLine[x].first);
     }
     // handle the last segment
-    for (IndexValueType i = 0; i < end[0] + iLine[x].first - t; i++)
-    {
-      oIt.Set(iLine[x].second);
-      ++oIt;
-    }
+    fill(in->DecodeValue(iLine[x].second), end0 + iLine[x].first - t);
     ++iIt;
   }
 } // DynamicThreadedGenerateData
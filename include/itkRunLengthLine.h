@@ -0,0 +1,789 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkRunLengthLine_h
+#define itkRunLengthLine_h
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility> // std::pair
+#include <vector>
+
+namespace itk
+{
+/** \class RunLengthLine
+ *
+ *  \brief A line of run-length encoded segments, used as pixel type
+ *  of RLEImage's internal buffer.
+ *
+ *  The interface is a subset of std::vector's, so existing code which
+ *  manipulates lines keeps working. Unlike std::vector, the segments
+ *  can reside in storage owned by someone else (an Arena, see
+ *  RLEImage::Consolidate()). Such a line does not free its storage,
+ *  and moves to its own heap storage when it needs to grow beyond
+ *  the external capacity.
+ *
+ *  Lines of up to InlineCapacity segments (e.g. uniform lines, which are
+ *  the majority in label images) are stored within the line object itself,
+ *  without a heap allocation. For the common 2-byte pixel and counter types
+ *  the inline segments take no more room than a heap pointer.
+ *
+ *  Exactly sized heap storage is reference counted and shared between
+ *  copies (copy-on-write). Copying such a line is a pointer copy;
+ *  the first modification through a non-const method gives the line
+ *  its own storage. Read through a const reference to avoid that.
+ *
+ *  Segments are stored as an array of (count, value) pairs.
+ *  SoARunLengthLine is an alternative with separate arrays.
+ *
+ *  Heap storage comes from TAllocator, an allocator of char, e.g.
+ *  std::pmr::polymorphic_allocator<char> to draw lines from a pool or
+ *  monotonic memory resource (see PmrRLEImage). A stateless allocator
+ *  takes no room in the line. Like std::pmr containers, a line keeps its
+ *  allocator when assigned to, and only shares storage with lines whose
+ *  allocator compares equal.
+ *
+ *  \ingroup RLEImage
+ */
+template <typename TPixel, typename CounterType, typename TAllocator = std::allocator<char>>
+class RunLengthLine : private TAllocator // empty base optimization
+{
+public:
+  /** First element is count of repetitions,
+   * second element is the pixel value. */
+  using value_type = std::pair<CounterType, TPixel>;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = value_type &;
+  using const_reference = const value_type &;
+  using pointer = value_type *;
+  using const_pointer = const value_type *;
+  using iterator = value_type *;
+  using const_iterator = const value_type *;
+  using allocator_type = TAllocator;
+
+  RunLengthLine()
+    : RunLengthLine(allocator_type())
+  {}
+
+  explicit RunLengthLine(const allocator_type & allocator)
+    : TAllocator(allocator)
+  {
+    this->ConstructInline();
+  }
+
+  explicit RunLengthLine(size_type              count,
+                         const value_type &     value = value_type(),
+                         const allocator_type & allocator = allocator_type())
+    : TAllocator(allocator)
+  {
+    this->ConstructInline();
+    this->Reallocate(count);
+    std::fill_n(this->Segments(), count, value);
+    m_Size = static_cast<std::uint32_t>(count);
+  }
+
+  /** Copies share exactly sized heap storage,
+   * otherwise they get their own, exactly sized, storage. */
+  RunLengthLine(const RunLengthLine & other)
+    : RunLengthLine(other, AllocatorTraits::select_on_container_copy_construction(other.get_allocator()))
+  {}
+
+  /** Copy drawing storage from the given allocator. */
+  RunLengthLine(const RunLengthLine & other, const allocator_type & allocator)
+    : TAllocator(allocator)
+  {
+    if (other.IsShareable() && this->get_allocator() == other.get_allocator())
+    {
+      m_Storage.m_Heap = other.m_Storage.m_Heap;
+      m_Capacity = other.m_Capacity;
+      m_Size = other.m_Size;
+      GetHeader(m_Storage.m_Heap)->m_ReferenceCount.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    this->ConstructInline();
+    this->Reallocate(other.m_Size);
+    std::copy(other.begin(), other.end(), this->Segments());
+    m_Size = other.m_Size;
+  }
+
+  RunLengthLine(RunLengthLine && other) noexcept
+    : TAllocator(other.get_allocator())
+  {
+    this->Steal(other);
+  }
+
+  RunLengthLine &
+  operator=(const RunLengthLine & other)
+  {
+    if (this != &other)
+    {
+      RunLengthLine copy(other, this->get_allocator());
+      this->SwapStorage(copy);
+    }
+    return *this;
+  }
+
+  /** Segments are copied if the allocators differ. */
+  RunLengthLine &
+  operator=(RunLengthLine && other) noexcept(AllocatorTraits::is_always_equal::value)
+  {
+    if (AllocatorTraits::is_always_equal::value || this->get_allocator() == other.get_allocator())
+    {
+      this->SwapStorage(other);
+    }
+    else
+    {
+      *this = static_cast<const RunLengthLine &>(other);
+    }
+    return *this;
+  }
+
+  ~RunLengthLine() { this->Release(); }
+
+  allocator_type
+  get_allocator() const
+  {
+    return static_cast<const TAllocator &>(*this);
+  }
+
+  size_type
+  size() const
+  {
+    return m_Size;
+  }
+
+  bool
+  empty() const
+  {
+    return m_Size == 0;
+  }
+
+  size_type
+  capacity() const
+  {
+    return m_Capacity & ~(ExternalFlag | InlineFlag);
+  }
+
+  reference
+  operator[](size_type i)
+  {
+    assert(i < m_Size);
+    return this->data()[i];
+  }
+
+  const_reference
+  operator[](size_type i) const
+  {
+    assert(i < m_Size);
+    return this->data()[i];
+  }
+
+  reference
+  front()
+  {
+    return this->data()[0];
+  }
+
+  const_reference
+  front() const
+  {
+    return this->data()[0];
+  }
+
+  reference
+  back()
+  {
+    return this->data()[m_Size - 1];
+  }
+
+  const_reference
+  back() const
+  {
+    return this->data()[m_Size - 1];
+  }
+
+  /** Gives the line its own storage if it was shared. */
+  pointer
+  data()
+  {
+    this->MakeUnique();
+    return this->Segments();
+  }
+
+  const_pointer
+  data() const
+  {
+    return this->IsInline() ? m_Storage.m_Inline : m_Storage.m_Heap;
+  }
+
+  iterator
+  begin()
+  {
+    return this->data();
+  }
+
+  const_iterator
+  begin() const
+  {
+    return this->data();
+  }
+
+  iterator
+  end()
+  {
+    return this->data() + m_Size;
+  }
+
+  const_iterator
+  end() const
+  {
+    return this->data() + m_Size;
+  }
+
+  void
+  reserve(size_type n)
+  {
+    if (n > this->capacity())
+    {
+      this->Reallocate(n);
+    }
+  }
+
+  /** Reduce capacity to size, moving short lines inline.
+   * Shared and external storage is left alone. */
+  void
+  shrink_to_fit()
+  {
+    if (this->IsHeap() && this->capacity() > m_Size && !this->IsShared())
+    {
+      this->Reallocate(m_Size);
+    }
+  }
+
+  void
+  clear()
+  {
+    if (this->IsShared())
+    {
+      this->Release();
+      this->ConstructInline();
+    }
+    m_Size = 0;
+  }
+
+  void
+  resize(size_type n, const value_type & value = value_type())
+  {
+    this->MakeUnique();
+    this->reserve(n);
+    if (n > m_Size)
+    {
+      std::fill(this->Segments() + m_Size, this->Segments() + n, value);
+    }
+    m_Size = static_cast<std::uint32_t>(n);
+  }
+
+  void
+  push_back(const value_type & value)
+  {
+    value_type copy = value; // value might reside in this line
+    this->MakeUnique();
+    if (m_Size == this->capacity())
+    {
+      this->Grow(m_Size + 1);
+    }
+    this->Segments()[m_Size++] = copy;
+  }
+
+  iterator
+  insert(const_iterator pos, const value_type & value)
+  {
+    return this->insert(pos, 1, value);
+  }
+
+  iterator
+  insert(const_iterator pos, size_type count, const value_type & value)
+  {
+    value_type      copy = value; // value might reside in this line
+    difference_type offset = this->MakeGap(pos, count);
+    std::fill_n(this->Segments() + offset, count, copy);
+    return this->Segments() + offset;
+  }
+
+  template <typename TInputIterator>
+  iterator
+  insert(const_iterator pos, TInputIterator first, TInputIterator last)
+  {
+    difference_type offset = this->MakeGap(pos, size_type(std::distance(first, last)));
+    for (pointer out = this->Segments() + offset; first != last; ++first, ++out)
+    {
+      typename std::iterator_traits<TInputIterator>::value_type segment = *first;
+      out->first = segment.first;
+      out->second = segment.second;
+    }
+    return this->Segments() + offset;
+  }
+
+  iterator
+  erase(const_iterator pos)
+  {
+    return this->erase(pos, pos + 1);
+  }
+
+  iterator
+  erase(const_iterator first, const_iterator last)
+  {
+    difference_type f = first - this->Segments();
+    difference_type l = last - this->Segments();
+    this->MakeUnique();
+    std::move(this->Segments() + l, this->Segments() + m_Size, this->Segments() + f);
+    m_Size -= static_cast<std::uint32_t>(l - f);
+    return this->Segments() + f;
+  }
+
+  /** Each line keeps its allocator. Lines whose allocators differ exchange copies. */
+  void
+  swap(RunLengthLine & other) noexcept(AllocatorTraits::is_always_equal::value)
+  {
+    if (AllocatorTraits::is_always_equal::value || this->get_allocator() == other.get_allocator())
+    {
+      this->SwapStorage(other);
+      return;
+    }
+    RunLengthLine mine(*this, other.get_allocator());
+    RunLengthLine theirs(other, this->get_allocator());
+    this->SwapStorage(theirs);
+    other.SwapStorage(mine);
+  }
+
+  bool
+  operator==(const RunLengthLine & other) const
+  {
+    return m_Size == other.m_Size &&
+           (this->data() == other.data() || std::equal(this->begin(), this->end(), other.begin()));
+  }
+
+  bool
+  operator!=(const RunLengthLine & other) const
+  {
+    return !(*this == other);
+  }
+
+  /** Find the segment which contains the pixel at the given position,
+   * relative to the start of the line. Sets remainder to the number of pixels
+   * from that position to the end of the segment (inclusive).
+   * Returns size() if the position is past the end of the line. */
+  template <typename TIndex>
+  size_type
+  FindSegment(TIndex position, TIndex & remainder) const
+  {
+    const_pointer segments = this->data();
+    TIndex        t = 0;
+    size_type     x = 0;
+    for (; x < m_Size; ++x)
+    {
+      t += segments[x].first;
+      if (t > position)
+      {
+        break;
+      }
+    }
+    remainder = t - position;
+    return x;
+  }
+
+  /** Contiguous storage for segments of many lines, see MoveToArena(). */
+  class Arena
+  {
+  public:
+    explicit Arena(size_type segmentCount)
+      : m_Segments(segmentCount)
+    {}
+
+    size_type
+    GetNumberOfBytes() const
+    {
+      return m_Segments.size() * sizeof(value_type);
+    }
+
+  private:
+    friend class RunLengthLine;
+    std::vector<value_type> m_Segments;
+  };
+
+  /** Number of arena slots MoveToArena() would take. */
+  size_type
+  GetNumberOfArenaSlots() const
+  {
+    return m_Size > InlineCapacity && !this->IsShared() ? m_Size : 0;
+  }
+
+  /** Move the segments into the arena, starting at the given segment offset.
+   * The arena must outlive this line's use of it.
+   * Previously owned heap storage is released.
+   * Lines short enough to be stored inline are moved inline instead,
+   * lines sharing their storage are left alone. */
+  void
+  MoveToArena(Arena & arena, size_type offset)
+  {
+    if (this->IsShared())
+    {
+      return;
+    }
+    if (m_Size <= InlineCapacity)
+    {
+      this->Reallocate(m_Size);
+      return;
+    }
+    assert(offset + m_Size <= arena.m_Segments.size());
+    pointer storage = arena.m_Segments.data() + offset;
+    std::move(this->begin(), this->end(), storage);
+    this->Release();
+    m_Storage.m_Heap = storage;
+    m_Capacity = m_Size | ExternalFlag;
+  }
+
+  /** Do the segments reside in storage owned by someone else? */
+  bool
+  IsExternal() const
+  {
+    return (m_Capacity & ExternalFlag) != 0;
+  }
+
+  /** Are the segments stored within the line object itself? */
+  bool
+  IsInline() const
+  {
+    return (m_Capacity & InlineFlag) != 0;
+  }
+
+  /** Is the heap storage shared with other lines? */
+  bool
+  IsShared() const
+  {
+    return this->IsHeap() && GetHeader(m_Storage.m_Heap)->m_ReferenceCount.load(std::memory_order_acquire) > 1;
+  }
+
+  /** Would a copy of this line share its storage? */
+  bool
+  IsShareable() const
+  {
+    return this->IsHeap() && this->capacity() == m_Size;
+  }
+
+  /** Number of bytes this line owns on the heap,
+   * not counting sizeof(RunLengthLine) and external storage.
+   * Shared storage is split evenly between the lines sharing it. */
+  size_type
+  GetOwnedBytes() const
+  {
+    if (!this->IsHeap())
+    {
+      return 0;
+    }
+    size_type bytes = GetNumberOfBlockUnits(this->capacity()) * sizeof(BlockUnit);
+    return bytes / GetHeader(m_Storage.m_Heap)->m_ReferenceCount.load(std::memory_order_relaxed);
+  }
+
+  /** A hash of the segments, for finding identical lines. */
+  std::size_t
+  Hash() const
+  {
+    std::size_t hash = 14695981039346656037ull; // FNV-1a
+    for (const value_type & segment : *this)
+    {
+      const unsigned char * countBytes = reinterpret_cast<const unsigned char *>(&segment.first);
+      const unsigned char * valueBytes = reinterpret_cast<const unsigned char *>(&segment.second);
+      for (size_type i = 0; i < sizeof(CounterType); ++i)
+      {
+        hash = (hash ^ countBytes[i]) * 1099511628211ull;
+      }
+      for (size_type i = 0; i < sizeof(TPixel); ++i)
+      {
+        hash = (hash ^ valueBytes[i]) * 1099511628211ull;
+      }
+    }
+    return hash;
+  }
+
+  /** Number of segments stored without a heap allocation. */
+  static constexpr size_type InlineCapacity = 2;
+
+  /** Segment lengths are limited by CounterType, not the line length. */
+  static constexpr bool LimitsLineLength = false;
+
+  /** Consecutive segments can have the same value. */
+  static constexpr bool AlternatesValues = false;
+
+  /** Lines are always stored as segments. */
+  static constexpr bool StoresPixelRows = false;
+
+private:
+  static constexpr std::uint32_t ExternalFlag = std::uint32_t(1) << 31;
+  static constexpr std::uint32_t InlineFlag = std::uint32_t(1) << 30;
+
+  /** Precedes the segments in heap storage. */
+  struct HeapHeader
+  {
+    HeapHeader()
+      : m_ReferenceCount(1)
+    {}
+
+    std::atomic<std::uint32_t> m_ReferenceCount;
+  };
+
+  /** Offset of segments from the start of heap storage. */
+  static constexpr size_type HeaderSize =
+    (sizeof(HeapHeader) + alignof(value_type) - 1) / alignof(value_type) * alignof(value_type);
+
+  static HeapHeader *
+  GetHeader(const_pointer segments)
+  {
+    return reinterpret_cast<HeapHeader *>(const_cast<char *>(reinterpret_cast<const char *>(segments)) - HeaderSize);
+  }
+
+  using AllocatorTraits = std::allocator_traits<TAllocator>;
+
+  /** Unit of heap allocation, aligned for both the header and the segments. */
+  static constexpr size_type BlockAlignment =
+    alignof(HeapHeader) > alignof(value_type) ? alignof(HeapHeader) : alignof(value_type);
+  struct alignas(BlockAlignment) BlockUnit
+  {
+    unsigned char m_Bytes[BlockAlignment];
+  };
+  using BlockAllocator = typename AllocatorTraits::template rebind_alloc<BlockUnit>;
+  using BlockTraits = std::allocator_traits<BlockAllocator>;
+
+  /** Number of units taken by heap storage with room for n segments. */
+  static constexpr size_type
+  GetNumberOfBlockUnits(size_type n)
+  {
+    return (HeaderSize + n * sizeof(value_type) + sizeof(BlockUnit) - 1) / sizeof(BlockUnit);
+  }
+
+  /** Heap storage with room for n segments and reference count 1. */
+  pointer
+  AllocateHeap(size_type n)
+  {
+    BlockAllocator allocator(this->get_allocator());
+    char *         block = reinterpret_cast<char *>(BlockTraits::allocate(allocator, GetNumberOfBlockUnits(n)));
+    pointer        segments = reinterpret_cast<pointer>(block + HeaderSize);
+    new (block) HeapHeader();
+    for (size_type i = 0; i < n; ++i)
+    {
+      new (segments + i) value_type();
+    }
+    return segments;
+  }
+
+  /** Drop a reference to heap storage of capacity n, freeing it with the last one. */
+  void
+  ReleaseHeap(pointer segments, size_type n)
+  {
+    HeapHeader * header = GetHeader(segments);
+    if (header->m_ReferenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      for (size_type i = 0; i < n; ++i)
+      {
+        segments[i].~value_type();
+      }
+      header->~HeapHeader();
+      BlockAllocator allocator(this->get_allocator());
+      BlockTraits::deallocate(allocator, reinterpret_cast<BlockUnit *>(header), GetNumberOfBlockUnits(n));
+    }
+  }
+
+  /** Are the segments in heap storage managed by this class? */
+  bool
+  IsHeap() const
+  {
+    return (m_Capacity & (ExternalFlag | InlineFlag)) == 0 && m_Storage.m_Heap != nullptr;
+  }
+
+  /** Mutable access to segments, without unsharing. */
+  pointer
+  Segments()
+  {
+    return this->IsInline() ? m_Storage.m_Inline : m_Storage.m_Heap;
+  }
+
+  /** Give the line its own storage if it is shared. */
+  void
+  MakeUnique()
+  {
+    if (this->IsShared())
+    {
+      this->Reallocate(this->capacity());
+    }
+  }
+
+  /** Switch to empty inline storage. Previous storage must have been released. */
+  void
+  ConstructInline()
+  {
+    for (size_type i = 0; i < InlineCapacity; ++i)
+    {
+      new (&m_Storage.m_Inline[i]) value_type();
+    }
+    m_Capacity = InlineCapacity | InlineFlag;
+  }
+
+  /** Take over the content of other, which is left empty.
+   * Storage of this line must have been released. */
+  void
+  Steal(RunLengthLine & other) noexcept
+  {
+    if (other.IsInline())
+    {
+      this->ConstructInline();
+      std::move(other.m_Storage.m_Inline, other.m_Storage.m_Inline + other.m_Size, m_Storage.m_Inline);
+    }
+    else
+    {
+      m_Storage.m_Heap = other.m_Storage.m_Heap;
+      m_Capacity = other.m_Capacity;
+      other.ConstructInline();
+    }
+    m_Size = other.m_Size;
+    other.m_Size = 0;
+  }
+
+  /** Exchange the storage with other, whose allocator must compare equal. */
+  void
+  SwapStorage(RunLengthLine & other) noexcept
+  {
+    if (this == &other)
+    {
+      return;
+    }
+    RunLengthLine temp(std::move(other));
+    other.Release();
+    other.Steal(*this);
+    this->Release();
+    this->Steal(temp);
+  }
+
+  /** Copy segments to the destination, moving them if nobody else uses them. */
+  void
+  TransferSegments(pointer destination)
+  {
+    const_pointer segments = static_cast<const RunLengthLine *>(this)->data();
+    if (this->IsShared())
+    {
+      std::copy(segments, segments + m_Size, destination);
+    }
+    else
+    {
+      std::move(this->Segments(), this->Segments() + m_Size, destination);
+    }
+  }
+
+  /** Move content into new storage with room for n segments.
+   * Inline storage is used if n segments fit into it. */
+  void
+  Reallocate(size_type n)
+  {
+    assert(n >= m_Size && n < InlineFlag);
+    if (n <= InlineCapacity)
+    {
+      if (!this->IsInline())
+      {
+        value_type segments[InlineCapacity];
+        this->TransferSegments(segments);
+        this->Release();
+        this->ConstructInline();
+        std::move(segments, segments + m_Size, m_Storage.m_Inline);
+      }
+      return;
+    }
+    pointer storage = AllocateHeap(n);
+    this->TransferSegments(storage);
+    this->Release();
+    m_Storage.m_Heap = storage;
+    m_Capacity = static_cast<std::uint32_t>(n);
+  }
+
+  /** Geometric growth, same as std::vector. */
+  void
+  Grow(size_type required)
+  {
+    this->Reallocate(std::max(required, 2 * this->capacity()));
+  }
+
+  /** Shift segments starting at pos by count, growing if needed.
+   * Returns the offset of pos. */
+  difference_type
+  MakeGap(const_iterator pos, size_type count)
+  {
+    difference_type offset = pos - this->Segments();
+    this->MakeUnique();
+    if (m_Size + count > this->capacity())
+    {
+      this->Grow(m_Size + count);
+    }
+    pointer segments = this->Segments();
+    std::move_backward(segments + offset, segments + m_Size, segments + m_Size + count);
+    m_Size += static_cast<std::uint32_t>(count);
+    return offset;
+  }
+
+  /** Free, unshare or destroy the storage. Leaves the line without storage,
+   * so one of the above methods must set it up again. */
+  void
+  Release()
+  {
+    if (this->IsInline())
+    {
+      for (size_type i = 0; i < InlineCapacity; ++i)
+      {
+        m_Storage.m_Inline[i].~value_type();
+      }
+    }
+    else if (this->IsHeap())
+    {
+      ReleaseHeap(m_Storage.m_Heap, this->capacity());
+    }
+    m_Storage.m_Heap = nullptr;
+    m_Capacity = 0;
+  }
+
+  /** Heap or external storage, or segments stored inline. */
+  union Storage
+  {
+    Storage()
+      : m_Heap(nullptr)
+    {}
+    ~Storage() {}
+
+    pointer    m_Heap;
+    value_type m_Inline[InlineCapacity];
+  };
+
+  Storage       m_Storage;
+  std::uint32_t m_Size{ 0 };
+  std::uint32_t m_Capacity{ 0 }; // highest bits signal external or inline storage
+};
+} // namespace itk
+
+#endif // itkRunLengthLine_h
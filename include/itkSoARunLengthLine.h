@@ -0,0 +1,712 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+#ifndef itkSoARunLengthLine_h
+#define itkSoARunLengthLine_h
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility> // std::pair
+
+namespace itk
+{
+/** \class SoARunLengthLine
+ *
+ *  \brief A line of run-length encoded segments, stored as
+ *  a structure of arrays: one array of counts and one of values.
+ *
+ *  Drop-in alternative to RunLengthLine, selected through the last
+ *  template parameter of RLEImage:
+ *  \code
+ *  using ImageType = itk::RLEImage<short, 3, unsigned short, itk::SoARunLengthLine<short, unsigned short>>;
+ *  \endcode
+ *
+ *  Keeping the counts together makes locating the segment which contains
+ *  a given position (FindSegment()) touch fewer cache lines and lets the
+ *  compiler vectorize the scan, at the expense of a slightly larger line
+ *  object and slower sequential access to (count, value) pairs.
+ *  Element access returns proxies which behave like std::pair references.
+ *
+ *  \ingroup RLEImage
+ */
+template <typename TPixel, typename CounterType>
+class SoARunLengthLine
+{
+public:
+  /** First element is count of repetitions,
+   * second element is the pixel value. */
+  using value_type = std::pair<CounterType, TPixel>;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using allocator_type = std::allocator<char>; // segments come from the global heap
+
+  /** Behaves like std::pair<CounterType, TPixel> &. */
+  class reference
+  {
+  public:
+    reference(CounterType & count, TPixel & value)
+      : first(count)
+      , second(value)
+    {}
+
+    reference(const reference &) = default;
+
+    reference &
+    operator=(const reference & other)
+    {
+      first = other.first;
+      second = other.second;
+      return *this;
+    }
+
+    reference &
+    operator=(const value_type & segment)
+    {
+      first = segment.first;
+      second = segment.second;
+      return *this;
+    }
+
+    operator value_type() const { return value_type(first, second); }
+
+    CounterType & first;
+    TPixel &      second;
+  };
+
+  /** Behaves like const std::pair<CounterType, TPixel> &. */
+  class const_reference
+  {
+  public:
+    const_reference(const CounterType & count, const TPixel & value)
+      : first(count)
+      , second(value)
+    {}
+
+    const_reference(const reference & other)
+      : first(other.first)
+      , second(other.second)
+    {}
+
+    operator value_type() const { return value_type(first, second); }
+
+    const CounterType & first;
+    const TPixel &      second;
+  };
+
+  /** Random access iterator over both arrays in lockstep. */
+  template <typename TReference, typename TCounter, typename TValue>
+  class IteratorBase
+  {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename SoARunLengthLine::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = TReference;
+    using pointer = void;
+
+    IteratorBase() = default;
+
+    IteratorBase(TCounter * count, TValue * value)
+      : m_Count(count)
+      , m_Value(value)
+    {}
+
+    /** Allows conversion of iterator to const_iterator. */
+    template <typename TOtherReference, typename TOtherCounter, typename TOtherValue>
+    IteratorBase(const IteratorBase<TOtherReference, TOtherCounter, TOtherValue> & other)
+      : m_Count(other.m_Count)
+      , m_Value(other.m_Value)
+    {}
+
+    reference
+    operator*() const
+    {
+      return reference(*m_Count, *m_Value);
+    }
+
+    reference
+    operator[](difference_type n) const
+    {
+      return reference(m_Count[n], m_Value[n]);
+    }
+
+    IteratorBase &
+    operator++()
+    {
+      ++m_Count;
+      ++m_Value;
+      return *this;
+    }
+
+    IteratorBase
+    operator++(int)
+    {
+      IteratorBase old = *this;
+      ++*this;
+      return old;
+    }
+
+    IteratorBase &
+    operator--()
+    {
+      --m_Count;
+      --m_Value;
+      return *this;
+    }
+
+    IteratorBase
+    operator--(int)
+    {
+      IteratorBase old = *this;
+      --*this;
+      return old;
+    }
+
+    IteratorBase &
+    operator+=(difference_type n)
+    {
+      m_Count += n;
+      m_Value += n;
+      return *this;
+    }
+
+    IteratorBase &
+    operator-=(difference_type n)
+    {
+      return *this += -n;
+    }
+
+    IteratorBase
+    operator+(difference_type n) const
+    {
+      return IteratorBase(m_Count + n, m_Value + n);
+    }
+
+    IteratorBase
+    operator-(difference_type n) const
+    {
+      return IteratorBase(m_Count - n, m_Value - n);
+    }
+
+    difference_type
+    operator-(const IteratorBase & other) const
+    {
+      return m_Count - other.m_Count;
+    }
+
+    bool
+    operator==(const IteratorBase & other) const
+    {
+      return m_Count == other.m_Count;
+    }
+
+    bool
+    operator!=(const IteratorBase & other) const
+    {
+      return m_Count != other.m_Count;
+    }
+
+    bool
+    operator<(const IteratorBase & other) const
+    {
+      return m_Count < other.m_Count;
+    }
+
+    bool
+    operator>(const IteratorBase & other) const
+    {
+      return m_Count > other.m_Count;
+    }
+
+    bool
+    operator<=(const IteratorBase & other) const
+    {
+      return m_Count <= other.m_Count;
+    }
+
+    bool
+    operator>=(const IteratorBase & other) const
+    {
+      return m_Count >= other.m_Count;
+    }
+
+    TCounter * m_Count{ nullptr };
+    TValue *   m_Value{ nullptr };
+  };
+
+  using iterator = IteratorBase<reference, CounterType, TPixel>;
+  using const_iterator = IteratorBase<const_reference, const CounterType, const TPixel>;
+
+  /** Segment lengths are limited by CounterType, not the line length. */
+  static constexpr bool LimitsLineLength = false;
+
+  /** Consecutive segments can have the same value. */
+  static constexpr bool AlternatesValues = false;
+
+  /** Lines are always stored as segments. */
+  static constexpr bool StoresPixelRows = false;
+
+  SoARunLengthLine() = default;
+
+  explicit SoARunLengthLine(size_type count, const value_type & value = value_type())
+  {
+    this->Reallocate(count);
+    std::fill_n(m_Counts, count, value.first);
+    std::fill_n(m_Values, count, value.second);
+    m_Size = static_cast<std::uint32_t>(count);
+  }
+
+  /** Copies always get their own, exactly sized, heap storage. */
+  SoARunLengthLine(const SoARunLengthLine & other)
+  {
+    this->Reallocate(other.m_Size);
+    std::copy_n(other.m_Counts, other.m_Size, m_Counts);
+    std::copy_n(other.m_Values, other.m_Size, m_Values);
+    m_Size = other.m_Size;
+  }
+
+  SoARunLengthLine(SoARunLengthLine && other) noexcept
+    : m_Counts(other.m_Counts)
+    , m_Values(other.m_Values)
+    , m_Size(other.m_Size)
+    , m_Capacity(other.m_Capacity)
+  {
+    other.m_Counts = nullptr;
+    other.m_Values = nullptr;
+    other.m_Size = 0;
+    other.m_Capacity = 0;
+  }
+
+  SoARunLengthLine &
+  operator=(const SoARunLengthLine & other)
+  {
+    if (this != &other)
+    {
+      if (this->capacity() < other.m_Size)
+      {
+        m_Size = 0;
+        this->Reallocate(other.m_Size);
+      }
+      std::copy_n(other.m_Counts, other.m_Size, m_Counts);
+      std::copy_n(other.m_Values, other.m_Size, m_Values);
+      m_Size = other.m_Size;
+    }
+    return *this;
+  }
+
+  SoARunLengthLine &
+  operator=(SoARunLengthLine && other) noexcept
+  {
+    this->swap(other);
+    return *this;
+  }
+
+  ~SoARunLengthLine() { this->Release(); }
+
+  size_type
+  size() const
+  {
+    return m_Size;
+  }
+
+  bool
+  empty() const
+  {
+    return m_Size == 0;
+  }
+
+  size_type
+  capacity() const
+  {
+    return m_Capacity & ~ExternalFlag;
+  }
+
+  reference
+  operator[](size_type i)
+  {
+    assert(i < m_Size);
+    return reference(m_Counts[i], m_Values[i]);
+  }
+
+  const_reference
+  operator[](size_type i) const
+  {
+    assert(i < m_Size);
+    return const_reference(m_Counts[i], m_Values[i]);
+  }
+
+  reference
+  front()
+  {
+    return (*this)[0];
+  }
+
+  const_reference
+  front() const
+  {
+    return (*this)[0];
+  }
+
+  reference
+  back()
+  {
+    return (*this)[m_Size - 1];
+  }
+
+  const_reference
+  back() const
+  {
+    return (*this)[m_Size - 1];
+  }
+
+  /** Contiguous array of segment lengths. */
+  CounterType *
+  counts()
+  {
+    return m_Counts;
+  }
+
+  const CounterType *
+  counts() const
+  {
+    return m_Counts;
+  }
+
+  /** Contiguous array of segment values. */
+  TPixel *
+  values()
+  {
+    return m_Values;
+  }
+
+  const TPixel *
+  values() const
+  {
+    return m_Values;
+  }
+
+  iterator
+  begin()
+  {
+    return iterator(m_Counts, m_Values);
+  }
+
+  const_iterator
+  begin() const
+  {
+    return const_iterator(m_Counts, m_Values);
+  }
+
+  iterator
+  end()
+  {
+    return iterator(m_Counts + m_Size, m_Values + m_Size);
+  }
+
+  const_iterator
+  end() const
+  {
+    return const_iterator(m_Counts + m_Size, m_Values + m_Size);
+  }
+
+  void
+  reserve(size_type n)
+  {
+    if (n > this->capacity())
+    {
+      this->Reallocate(n);
+    }
+  }
+
+  /** Reduce capacity to size. External storage is left alone. */
+  void
+  shrink_to_fit()
+  {
+    if (!this->IsExternal() && this->capacity() > m_Size)
+    {
+      this->Reallocate(m_Size);
+    }
+  }
+
+  void
+  clear()
+  {
+    m_Size = 0;
+  }
+
+  void
+  resize(size_type n, const value_type & value = value_type())
+  {
+    this->reserve(n);
+    if (n > m_Size)
+    {
+      std::fill(m_Counts + m_Size, m_Counts + n, value.first);
+      std::fill(m_Values + m_Size, m_Values + n, value.second);
+    }
+    m_Size = static_cast<std::uint32_t>(n);
+  }
+
+  void
+  push_back(const value_type & value)
+  {
+    value_type copy = value; // value might reside in this line
+    if (m_Size == this->capacity())
+    {
+      this->Grow(m_Size + 1);
+    }
+    m_Counts[m_Size] = copy.first;
+    m_Values[m_Size] = copy.second;
+    ++m_Size;
+  }
+
+  iterator
+  insert(const_iterator pos, const value_type & value)
+  {
+    return this->insert(pos, 1, value);
+  }
+
+  iterator
+  insert(const_iterator pos, size_type count, const value_type & value)
+  {
+    value_type      copy = value; // value might reside in this line
+    difference_type offset = this->MakeGap(pos, count);
+    std::fill_n(m_Counts + offset, count, copy.first);
+    std::fill_n(m_Values + offset, count, copy.second);
+    return this->begin() + offset;
+  }
+
+  template <typename TInputIterator>
+  iterator
+  insert(const_iterator pos, TInputIterator first, TInputIterator last)
+  {
+    difference_type offset = this->MakeGap(pos, size_type(std::distance(first, last)));
+    for (difference_type i = offset; first != last; ++first, ++i)
+    {
+      typename std::iterator_traits<TInputIterator>::value_type segment = *first;
+      m_Counts[i] = segment.first;
+      m_Values[i] = segment.second;
+    }
+    return this->begin() + offset;
+  }
+
+  iterator
+  erase(const_iterator pos)
+  {
+    return this->erase(pos, pos + 1);
+  }
+
+  iterator
+  erase(const_iterator first, const_iterator last)
+  {
+    difference_type f = first.m_Count - m_Counts;
+    difference_type l = last.m_Count - m_Counts;
+    std::move(m_Counts + l, m_Counts + m_Size, m_Counts + f);
+    std::move(m_Values + l, m_Values + m_Size, m_Values + f);
+    m_Size -= static_cast<std::uint32_t>(l - f);
+    return this->begin() + f;
+  }
+
+  void
+  swap(SoARunLengthLine & other) noexcept
+  {
+    std::swap(m_Counts, other.m_Counts);
+    std::swap(m_Values, other.m_Values);
+    std::swap(m_Size, other.m_Size);
+    std::swap(m_Capacity, other.m_Capacity);
+  }
+
+  bool
+  operator==(const SoARunLengthLine & other) const
+  {
+    return m_Size == other.m_Size && std::equal(m_Counts, m_Counts + m_Size, other.m_Counts) &&
+           std::equal(m_Values, m_Values + m_Size, other.m_Values);
+  }
+
+  bool
+  operator!=(const SoARunLengthLine & other) const
+  {
+    return !(*this == other);
+  }
+
+  /** Find the segment which contains the pixel at the given position,
+   * relative to the start of the line. Sets remainder to the number of pixels
+   * from that position to the end of the segment (inclusive).
+   * Returns size() if the position is past the end of the line.
+   *
+   * Whole blocks of counts are summed without a data-dependent branch,
+   * which the compiler turns into vector instructions. */
+  template <typename TIndex>
+  size_type
+  FindSegment(TIndex position, TIndex & remainder) const
+  {
+    constexpr size_type blockSize = 8;
+
+    TIndex    t = 0;
+    size_type x = 0;
+    for (; x + blockSize <= m_Size; x += blockSize)
+    {
+      TIndex blockSum = 0;
+      for (size_type i = 0; i < blockSize; ++i)
+      {
+        blockSum += m_Counts[x + i];
+      }
+      if (t + blockSum > position)
+      {
+        break;
+      }
+      t += blockSum;
+    }
+    for (; x < m_Size; ++x)
+    {
+      t += m_Counts[x];
+      if (t > position)
+      {
+        break;
+      }
+    }
+    remainder = t - position;
+    return x;
+  }
+
+  /** Contiguous storage for segments of many lines, see MoveToArena(). */
+  class Arena
+  {
+  public:
+    explicit Arena(size_type segmentCount)
+      : m_Counts(new CounterType[segmentCount])
+      , m_Values(new TPixel[segmentCount])
+      , m_Size(segmentCount)
+    {}
+
+    size_type
+    GetNumberOfBytes() const
+    {
+      return m_Size * (sizeof(CounterType) + sizeof(TPixel));
+    }
+
+  private:
+    friend class SoARunLengthLine;
+    std::unique_ptr<CounterType[]> m_Counts;
+    std::unique_ptr<TPixel[]>      m_Values;
+    size_type                      m_Size;
+  };
+
+  /** Number of arena slots MoveToArena() would take. */
+  size_type
+  GetNumberOfArenaSlots() const
+  {
+    return m_Size;
+  }
+
+  /** Move the segments into the arena, starting at the given segment offset.
+   * The arena must outlive this line's use of it.
+   * Previously owned heap storage is released. */
+  void
+  MoveToArena(Arena & arena, size_type offset)
+  {
+    assert(offset + m_Size <= arena.m_Size);
+    CounterType * counts = arena.m_Counts.get() + offset;
+    TPixel *      values = arena.m_Values.get() + offset;
+    std::copy_n(m_Counts, m_Size, counts);
+    std::move(m_Values, m_Values + m_Size, values);
+    this->Release();
+    m_Counts = counts;
+    m_Values = values;
+    m_Capacity = m_Size | ExternalFlag;
+  }
+
+  /** Do the segments reside in storage owned by someone else? */
+  bool
+  IsExternal() const
+  {
+    return (m_Capacity & ExternalFlag) != 0;
+  }
+
+  /** Number of bytes this line owns on the heap,
+   * not counting sizeof(SoARunLengthLine) and external storage. */
+  size_type
+  GetOwnedBytes() const
+  {
+    return this->IsExternal() ? 0 : this->capacity() * (sizeof(CounterType) + sizeof(TPixel));
+  }
+
+private:
+  static constexpr std::uint32_t ExternalFlag = std::uint32_t(1) << 31;
+
+  /** Move content into new heap storage with room for n segments. */
+  void
+  Reallocate(size_type n)
+  {
+    assert(n >= m_Size && n < ExternalFlag);
+    CounterType * counts = n > 0 ? new CounterType[n] : nullptr;
+    TPixel *      values = n > 0 ? new TPixel[n] : nullptr;
+    std::copy_n(m_Counts, m_Size, counts);
+    std::move(m_Values, m_Values + m_Size, values);
+    this->Release();
+    m_Counts = counts;
+    m_Values = values;
+    m_Capacity = static_cast<std::uint32_t>(n);
+  }
+
+  /** Geometric growth, same as std::vector. */
+  void
+  Grow(size_type required)
+  {
+    this->Reallocate(std::max(required, 2 * this->capacity()));
+  }
+
+  /** Shift segments starting at pos by count, growing if needed.
+   * Returns the offset of pos. */
+  difference_type
+  MakeGap(const_iterator pos, size_type count)
+  {
+    difference_type offset = pos.m_Count - m_Counts;
+    if (m_Size + count > this->capacity())
+    {
+      this->Grow(m_Size + count);
+    }
+    std::move_backward(m_Counts + offset, m_Counts + m_Size, m_Counts + m_Size + count);
+    std::move_backward(m_Values + offset, m_Values + m_Size, m_Values + m_Size + count);
+    m_Size += static_cast<std::uint32_t>(count);
+    return offset;
+  }
+
+  void
+  Release()
+  {
+    if (!this->IsExternal())
+    {
+      delete[] m_Counts;
+      delete[] m_Values;
+    }
+    m_Counts = nullptr;
+    m_Values = nullptr;
+    m_Capacity = 0;
+  }
+
+  CounterType * m_Counts{ nullptr };
+  TPixel *      m_Values{ nullptr };
+  std::uint32_t m_Size{ 0 };
+  std::uint32_t m_Capacity{ 0 }; // highest bit signals external storage
+};
+} // namespace itk
+
+#endif // itkSoARunLengthLine_h
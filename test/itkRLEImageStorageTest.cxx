@@ -0,0 +1,1904 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkImageRegionIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkImageScanlineConstIterator.h"
+#include "itkImageScanlineIterator.h"
+#include "itkRGBPixel.h"
+#include "itkRLEImage.h"
+#include "itkRLERegionOfInterestImageFilter.h"
+#include "itkVariableLengthVector.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using DenseImageType = itk::Image<short, 3>;
+using RLEImageType = itk::RLEImage<short, 3>;
+using SoARLEImageType = itk::RLEImage<short, 3, unsigned short, itk::SoARunLengthLine<short, unsigned short>>;
+using CumulativeRLEImageType =
+  itk::RLEImage<short, 3, unsigned short, itk::CumulativeRunLengthLine<short, unsigned short>>;
+using PaletteRLEImageType = itk::PaletteRLEImage<short, 3, unsigned short, unsigned char>;
+using HybridRLEImageType = itk::HybridRLEImage<short, 3>;
+using RGBPixelType = itk::RGBPixel<unsigned char>;
+using RGBRLEImageType =
+  itk::RLEImage<RGBPixelType, 3, unsigned short, itk::SoARunLengthLine<RGBPixelType, unsigned short>>;
+
+// pseudo-random but deterministic label pattern with runs of varying length
+static short
+labelAt(const DenseImageType::IndexType & index, unsigned seed)
+{
+  unsigned v = unsigned(index[0] / 7) * 31u + unsigned(index[1]) * 17u + unsigned(index[2]) * 13u + seed;
+  return static_cast<short>((v * 2654435761u >> 28) % 4);
+}
+
+template <typename ImageType>
+static void
+paint(ImageType * image, unsigned seed)
+{
+  itk::ImageRegionIterator<ImageType> it(image, image->GetLargestPossibleRegion());
+  for (; !it.IsAtEnd(); ++it)
+  {
+    it.Set(labelAt(it.GetIndex(), seed));
+  }
+}
+
+template <typename RLEImageType>
+static bool
+sameContent(const DenseImageType * dense, const RLEImageType * rle, const char * stage)
+{
+  itk::ImageRegionConstIterator<DenseImageType> dIt(dense, dense->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<RLEImageType>   rIt(rle, rle->GetLargestPossibleRegion());
+  for (; !dIt.IsAtEnd(); ++dIt, ++rIt)
+  {
+    if (dIt.Get() != rIt.Get() || rle->GetPixel(dIt.GetIndex()) != dIt.Get())
+    {
+      std::cerr << stage << ": images differ at " << dIt.GetIndex() << std::endl;
+      return false;
+    }
+  }
+  std::cout << stage << ": OK" << std::endl;
+  return true;
+}
+
+template <typename RLEImageType>
+static bool
+testLayout(const DenseImageType::RegionType & region)
+{
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate();
+  typename RLEImageType::Pointer rle = RLEImageType::New();
+  rle->SetRegions(region);
+  rle->Allocate();
+
+  paint<DenseImageType>(dense, 0);
+  paint<RLEImageType>(rle, 0);
+  bool ok = sameContent(dense.GetPointer(), rle.GetPointer(), "Painted");
+
+  // the encoder sizes every line exactly, leaving nothing for Compact() to reclaim
+  using EncoderType = itk::RegionOfInterestImageFilter<DenseImageType, RLEImageType>;
+  typename EncoderType::Pointer encoder = EncoderType::New();
+  encoder->SetInput(dense);
+  encoder->SetRegionOfInterest(region);
+  encoder->Update();
+  typename RLEImageType::Pointer                encoded = encoder->GetOutput();
+  itk::ImageRegionConstIterator<DenseImageType> eIt(dense, region);
+  itk::ImageRegionConstIterator<RLEImageType>   rIt(encoded, encoded->GetLargestPossibleRegion());
+  bool                                          encodedOK = true;
+  for (; !eIt.IsAtEnd(); ++eIt, ++rIt)
+  {
+    encodedOK &= eIt.Get() == rIt.Get();
+  }
+  encodedOK &= encoded->Compact() == 0;
+  std::cout << "Encoded: " << (encodedOK ? "OK" : "failed") << std::endl;
+  ok &= encodedOK;
+
+  rle->Consolidate();
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Consolidated");
+
+  // edits after consolidation split segments beyond their arena slots
+  paint<DenseImageType>(dense, 5);
+  paint<RLEImageType>(rle, 5);
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Edited after consolidation");
+
+  // the edits left spare capacity in the lines they reallocated
+  itk::SizeValueType reclaimed = rle->Compact();
+  std::cout << "Compact reclaimed " << reclaimed << " bytes" << std::endl;
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Compacted");
+  if (rle->Compact() != 0)
+  {
+    std::cout << "Compacting twice reclaimed more bytes" << std::endl;
+    ok = false;
+  }
+
+  rle->Consolidate();
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Consolidated again");
+
+  // a frozen image is read in place, and thawed by the first write
+  rle->Freeze();
+  ok &= rle->IsFrozen() && sameContent(dense.GetPointer(), rle.GetPointer(), "Frozen");
+  std::cout << "Frozen size: " << rle->GetFrozenLines()->GetNumberOfBytes() << " bytes" << std::endl;
+
+  using DecoderType = itk::RegionOfInterestImageFilter<RLEImageType, DenseImageType>;
+  typename DecoderType::Pointer decoder = DecoderType::New();
+  decoder->SetInput(rle);
+  decoder->SetRegionOfInterest(region);
+  decoder->Update();
+  itk::ImageRegionConstIterator<DenseImageType> dIt(dense, region);
+  itk::ImageRegionConstIterator<DenseImageType> oIt(decoder->GetOutput(), decoder->GetOutput()->GetBufferedRegion());
+  for (; !dIt.IsAtEnd(); ++dIt, ++oIt)
+  {
+    ok &= dIt.Get() == oIt.Get();
+  }
+  ok &= rle->IsFrozen(); // reading does not thaw
+
+  paint<DenseImageType>(dense, 9);
+  paint<RLEImageType>(rle, 9);
+  ok &= !rle->IsFrozen() && sameContent(dense.GetPointer(), rle.GetPointer(), "Edited after freezing");
+
+  rle->Freeze();
+  typename RLEImageType::IndexType index = region.GetIndex();
+  index[0] += 3;
+  rle->SetPixel(index, 5);
+  dense->SetPixel(index, 5);
+  ok &= !rle->IsFrozen() && sameContent(dense.GetPointer(), rle.GetPointer(), "Set pixel after freezing");
+  rle->Print(std::cout);
+  return ok;
+}
+
+// uniform and nearly uniform lines should not need heap storage
+static bool
+testInlineLines(const DenseImageType::RegionType & region)
+{
+  using BufferType = RLEImageType::BufferType;
+  RLEImageType::Pointer rle = RLEImageType::New();
+  rle->SetRegions(region);
+  rle->Allocate();
+
+  RLEImageType::IndexType index = region.GetIndex();
+  index[0] += 10;
+  rle->SetPixel(index, 1); // splits the first line into 3 segments
+
+  itk::ImageRegionConstIterator<BufferType> it(rle->GetBuffer(), rle->GetBuffer()->GetBufferedRegion());
+  bool                                      ok = !it.Value().IsInline() && it.Value().size() == 3;
+  for (++it; !it.IsAtEnd(); ++it)
+  {
+    ok &= it.Value().IsInline() && it.Value().GetOwnedBytes() == 0;
+  }
+
+  rle->SetPixel(index, 0); // back to 1 segment
+  rle->Consolidate();      // which can go inline again
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  {
+    ok &= it.Value().IsInline();
+  }
+  std::cout << "Inline lines: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// identical lines share storage, editing one of them does not affect the others
+static bool
+testSharedLines(const DenseImageType::RegionType & region)
+{
+  using BufferType = RLEImageType::BufferType;
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate();
+  RLEImageType::Pointer rle = RLEImageType::New();
+  rle->SetRegions(region);
+  rle->Allocate();
+
+  // every line gets the same stripes
+  itk::ImageRegionIterator<RLEImageType>   rIt(rle, region);
+  itk::ImageRegionIterator<DenseImageType> dIt(dense, region);
+  for (; !rIt.IsAtEnd(); ++rIt, ++dIt)
+  {
+    short value = static_cast<short>(rIt.GetIndex()[0] / 10 % 3);
+    rIt.Set(value);
+    dIt.Set(value);
+  }
+
+  itk::SizeValueType lineCount = region.GetNumberOfPixels() / region.GetSize(0);
+  itk::SizeValueType sharedCount = rle->Deduplicate();
+  bool               ok = sharedCount == lineCount - 1;
+
+  itk::ImageRegionConstIterator<BufferType> it(rle->GetBuffer(), rle->GetBuffer()->GetBufferedRegion());
+  for (; !it.IsAtEnd(); ++it)
+  {
+    ok &= it.Value().IsShared();
+  }
+
+  // copying the image shares all the lines, compacting does not unshare them
+  using RoiType = itk::RegionOfInterestImageFilter<RLEImageType, RLEImageType>;
+  RoiType::Pointer roi = RoiType::New();
+  roi->SetInput(rle);
+  roi->SetRegionOfInterest(region);
+  roi->CompactOutputOn();
+  roi->Update();
+  BufferType *                              copyBuffer = roi->GetOutput()->GetBuffer();
+  itk::ImageRegionConstIterator<BufferType> cIt(copyBuffer, copyBuffer->GetBufferedRegion());
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it, ++cIt)
+  {
+    ok &= cIt.Value().data() == it.Value().data();
+  }
+
+  // edit a single line
+  RLEImageType::IndexType index = region.GetIndex();
+  index[1] += 2;
+  rle->SetPixel(index, 7);
+  dense->SetPixel(index, 7);
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Edited shared line");
+  RLEImageType::IndexType copyIndex = roi->GetOutput()->GetLargestPossibleRegion().GetIndex();
+  copyIndex[1] += 2;
+  ok &= roi->GetOutput()->GetPixel(copyIndex) == 0; // the copy is not affected
+
+  std::cout << "Shared lines: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// changes value from to value to in the dense image
+static void
+replaceValue(DenseImageType * dense, short from, short to)
+{
+  itk::ImageRegionIterator<DenseImageType> it(dense, dense->GetLargestPossibleRegion());
+  for (; !it.IsAtEnd(); ++it)
+  {
+    if (it.Get() == from)
+    {
+      it.Set(to);
+    }
+  }
+}
+
+// segments store palette indices, remapping values only touches the palette
+static bool
+testPalette(const DenseImageType::RegionType & region)
+{
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate();
+  PaletteRLEImageType::Pointer rle = PaletteRLEImageType::New();
+  rle->SetRegions(region);
+  rle->Allocate();
+
+  paint<DenseImageType>(dense, 0);
+  paint<PaletteRLEImageType>(rle, 0);
+  bool ok = sameContent(dense.GetPointer(), rle.GetPointer(), "Palette encoded");
+  ok &= rle->GetPalette().size() == 4 && rle->GetPalette()[0] == 0;
+
+  // adding values never moves the palette, so other threads can keep decoding pixels
+  const short * paletteData = rle->GetPalette().data();
+  for (short v = 100; v < 300; v++)
+  {
+    rle->EncodeValue(v);
+  }
+  ok &= rle->GetPalette().data() == paletteData && rle->GetPalette().size() == 204;
+
+  using RoiType = itk::RegionOfInterestImageFilter<PaletteRLEImageType, PaletteRLEImageType>;
+  RoiType::Pointer roi = RoiType::New();
+  roi->SetInput(rle);
+  roi->SetRegionOfInterest(region);
+  roi->Update();
+  ok &= roi->GetOutput()->GetPalette() == rle->GetPalette();
+
+  using ConverterType = itk::RegionOfInterestImageFilter<PaletteRLEImageType, RLEImageType>;
+  ConverterType::Pointer converter = ConverterType::New();
+  converter->SetInput(rle);
+  converter->SetRegionOfInterest(region);
+  converter->Update();
+
+  rle->Freeze();
+  rle->ReplaceValue(2, 1000);
+  replaceValue(dense, 2, 1000);
+  ok &= rle->IsFrozen() && sameContent(dense.GetPointer(), rle.GetPointer(), "Palette remapped");
+  const std::size_t paletteSize = rle->GetPalette().size();
+  rle->ReplaceValue(3, 1); // merges two values, freeing an index
+  replaceValue(dense, 3, 1);
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Palette values merged");
+  rle->EncodeValue(3000);
+  ok &= rle->GetPalette().size() == paletteSize;
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Freed index reused");
+
+  RLEImageType::Pointer plain = converter->GetOutput();
+  plain->ReplaceValue(2, 1000);
+  plain->ReplaceValue(3, 1);
+  itk::ImageRegionConstIterator<DenseImageType> dIt(dense, region);
+  itk::ImageRegionConstIterator<RLEImageType>   pIt(plain, plain->GetLargestPossibleRegion());
+  for (; !dIt.IsAtEnd(); ++dIt, ++pIt)
+  {
+    ok &= dIt.Get() == pIt.Get();
+  }
+
+  std::cout << "Palette: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// runs along Y or Z instead of X
+static bool
+testRunAxis(const DenseImageType::RegionType & region, unsigned int runAxis)
+{
+  std::cout << "Run axis " << runAxis << std::endl;
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate();
+  paint<DenseImageType>(dense, 0);
+
+  using EncoderType = itk::RegionOfInterestImageFilter<DenseImageType, RLEImageType>;
+  EncoderType::Pointer encoder = EncoderType::New();
+  encoder->SetInput(dense);
+  encoder->SetRegionOfInterest(region);
+  encoder->SetRunAxis(runAxis);
+  encoder->Update();
+  RLEImageType::Pointer encoded = encoder->GetOutput();
+  bool                  ok = encoded->GetRunAxis() == runAxis;
+  ok &= encoded->GetBuffer()->GetBufferedRegion().GetNumberOfPixels() ==
+        region.GetNumberOfPixels() / region.GetSize(runAxis);
+  itk::ImageRegionConstIterator<DenseImageType> dIt(dense, region);
+  itk::ImageRegionConstIterator<RLEImageType>   eIt(encoded, encoded->GetLargestPossibleRegion());
+  for (; !dIt.IsAtEnd(); ++dIt, ++eIt)
+  {
+    ok &= dIt.Get() == eIt.Get();
+  }
+
+  // writing through iterators and SetPixel
+  RLEImageType::Pointer rle = RLEImageType::New();
+  rle->SetRunAxis(runAxis);
+  rle->SetRegions(region);
+  rle->Allocate();
+  paint<RLEImageType>(rle, 0);
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Painted");
+  DenseImageType::IndexType index = region.GetIndex();
+  index[runAxis] += 2;
+  rle->SetPixel(index, 7);
+  dense->SetPixel(index, 7);
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Set pixel");
+
+  itk::ImageScanlineConstIterator<DenseImageType> dsIt(dense, region);
+  itk::ImageScanlineConstIterator<RLEImageType>   rsIt(rle, region);
+  for (; !dsIt.IsAtEnd(); dsIt.NextLine(), rsIt.NextLine())
+  {
+    for (; !dsIt.IsAtEndOfLine(); ++dsIt, ++rsIt)
+    {
+      ok &= dsIt.Get() == rsIt.Get() && dsIt.GetIndex() == rsIt.GetIndex();
+    }
+  }
+  ok &= rsIt.IsAtEnd();
+
+  // iterators carry on along each line from where they left it, also after writes and backwards
+  itk::ImageRegionIterator<DenseImageType> dwIt(dense, region);
+  itk::ImageRegionIterator<RLEImageType>   rwIt(rle, region);
+  for (unsigned int n = 0; !dwIt.IsAtEnd(); ++dwIt, ++rwIt, n++)
+  {
+    if (n % 7 < 2)
+    {
+      dwIt.Set(n % 5);
+      rwIt.Set(n % 5);
+    }
+    ok &= dwIt.Get() == rwIt.Get();
+  }
+  ok &= rwIt.IsAtEnd() && sameContent(dense.GetPointer(), rle.GetPointer(), "Written along other lines");
+  itk::ImageRegionConstIterator<DenseImageType> dbIt(dense, region);
+  itk::ImageRegionConstIterator<RLEImageType>   rbIt(rle, region);
+  dbIt.GoToEnd();
+  rbIt.GoToEnd();
+  do
+  {
+    --dbIt;
+    --rbIt;
+    ok &= dbIt.Get() == rbIt.Get() && dbIt.GetIndex() == rbIt.GetIndex();
+  } while (!dbIt.IsAtBegin());
+  ok &= rbIt.IsAtBegin();
+
+  // a region of interest keeps the run axis
+  DenseImageType::RegionType roiRegion = region;
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    roiRegion.SetIndex(i, region.GetIndex(i) + 1);
+    roiRegion.SetSize(i, region.GetSize(i) - 3);
+  }
+  using RoiType = itk::RegionOfInterestImageFilter<RLEImageType, RLEImageType>;
+  RoiType::Pointer roi = RoiType::New();
+  roi->SetInput(rle);
+  roi->SetRegionOfInterest(roiRegion);
+  roi->Update();
+  ok &= roi->GetOutput()->GetRunAxis() == runAxis;
+
+  rle->Freeze();
+  using DecoderType = itk::RegionOfInterestImageFilter<RLEImageType, DenseImageType>;
+  DecoderType::Pointer decoder = DecoderType::New();
+  decoder->SetInput(rle);
+  decoder->SetRegionOfInterest(roiRegion);
+  decoder->Update();
+
+  dIt = itk::ImageRegionConstIterator<DenseImageType>(dense, roiRegion);
+  itk::ImageRegionConstIterator<RLEImageType>   rIt(roi->GetOutput(), roi->GetOutput()->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<DenseImageType> oIt(decoder->GetOutput(), decoder->GetOutput()->GetBufferedRegion());
+  for (; !dIt.IsAtEnd(); ++dIt, ++rIt, ++oIt)
+  {
+    ok &= dIt.Get() == rIt.Get() && dIt.Get() == oIt.Get();
+  }
+  ok &= rle->IsFrozen() && sameContent(dense.GetPointer(), rle.GetPointer(), "Frozen");
+
+  std::cout << "Run axis " << runAxis << ": " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// the encoder picks the axis with the fewest segments
+static bool
+testAutomaticRunAxis(const DenseImageType::RegionType & region)
+{
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate();
+
+  using EncoderType = itk::RegionOfInterestImageFilter<DenseImageType, RLEImageType>;
+  bool ok = true;
+  for (unsigned int expectedAxis : { 0, 2 })
+  {
+    if (expectedAxis == 0)
+    {
+      paint<DenseImageType>(dense, 0); // runs of 7 pixels along X
+    }
+    else
+    {
+      itk::ImageRegionIterator<DenseImageType> it(dense, region);
+      for (; !it.IsAtEnd(); ++it)
+      {
+        it.Set(static_cast<short>((it.GetIndex()[0] + it.GetIndex()[1] + 3) % 3)); // constant along Z
+      }
+    }
+
+    EncoderType::Pointer encoder = EncoderType::New();
+    encoder->SetInput(dense);
+    encoder->SetRegionOfInterest(region);
+    encoder->AutomaticRunAxisOn();
+    encoder->Update();
+    RLEImageType::Pointer rle = encoder->GetOutput();
+
+    // a small image is sampled completely, so the estimate is exact
+    itk::SizeValueType                                        segmentCount = 0;
+    itk::ImageRegionConstIterator<RLEImageType::BufferType> lIt(rle->GetBuffer(),
+                                                                 rle->GetBuffer()->GetBufferedRegion());
+    for (; !lIt.IsAtEnd(); ++lIt)
+    {
+      segmentCount += lIt.Get().size();
+    }
+    std::cout << "Automatic run axis " << encoder->GetRunAxis() << ": " << segmentCount << " segments, "
+              << encoder->GetEstimatedSegmentCount(0) << " along X" << std::endl;
+    ok &= encoder->GetRunAxis() == expectedAxis && rle->GetRunAxis() == expectedAxis;
+    ok &= encoder->GetEstimatedSegmentCount(expectedAxis) == segmentCount;
+
+    itk::ImageRegionConstIterator<DenseImageType> dIt(dense, region);
+    itk::ImageRegionConstIterator<RLEImageType>   rIt(rle, rle->GetLargestPossibleRegion());
+    for (; !dIt.IsAtEnd(); ++dIt, ++rIt)
+    {
+      ok &= dIt.Get() == rIt.Get();
+    }
+  }
+  std::cout << "Automatic run axis: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// binary masks store only alternating run lengths
+static bool
+testBinaryMask(const DenseImageType::RegionType & region)
+{
+  using MaskImageType = itk::Image<bool, 3>;
+  using MaskRLEImageType = itk::BinaryMaskRLEImage<bool, 3>;
+  using PairRLEImageType = itk::RLEImage<bool, 3>;
+
+  MaskImageType::Pointer dense = MaskImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate();
+  MaskRLEImageType::Pointer mask = MaskRLEImageType::New();
+  mask->SetRegions(region);
+  mask->Allocate();
+  PairRLEImageType::Pointer pairs = PairRLEImageType::New();
+  pairs->SetRegions(region);
+  pairs->Allocate();
+
+  auto same = [&dense](const MaskRLEImageType * rle, const char * stage) {
+    itk::ImageRegionConstIterator<MaskImageType>    dIt(dense, dense->GetLargestPossibleRegion());
+    itk::ImageRegionConstIterator<MaskRLEImageType> rIt(rle, rle->GetLargestPossibleRegion());
+    for (; !dIt.IsAtEnd(); ++dIt, ++rIt)
+    {
+      if (dIt.Get() != rIt.Get())
+      {
+        std::cerr << stage << ": masks differ at " << dIt.GetIndex() << std::endl;
+        return false;
+      }
+    }
+    std::cout << stage << ": OK" << std::endl;
+    return true;
+  };
+  auto paintMask = [&dense, &mask](unsigned seed) {
+    itk::ImageRegionIterator<MaskImageType>    dIt(dense, dense->GetLargestPossibleRegion());
+    itk::ImageRegionIterator<MaskRLEImageType> mIt(mask, mask->GetLargestPossibleRegion());
+    for (; !dIt.IsAtEnd(); ++dIt, ++mIt)
+    {
+      dIt.Set(labelAt(dIt.GetIndex(), seed) % 2 == 1);
+      mIt.Set(dIt.Get());
+    }
+  };
+
+  paintMask(0);
+  itk::ImageRegionConstIterator<MaskImageType> dIt(dense, region);
+  itk::ImageRegionIterator<PairRLEImageType>   pIt(pairs, region);
+  for (; !dIt.IsAtEnd(); ++dIt, ++pIt)
+  {
+    pIt.Set(dIt.Get());
+  }
+  bool ok = same(mask, "Mask painted");
+
+  // same segments in half the bytes
+  mask->Compact();
+  pairs->Compact();
+  itk::SizeValueType maskSegments = 0, maskBytes = 0, pairSegments = 0, pairBytes = 0;
+  itk::ImageRegionConstIterator<MaskRLEImageType::BufferType> mlIt(mask->GetBuffer(),
+                                                                   mask->GetBuffer()->GetBufferedRegion());
+  itk::ImageRegionConstIterator<PairRLEImageType::BufferType> plIt(pairs->GetBuffer(),
+                                                                   pairs->GetBuffer()->GetBufferedRegion());
+  for (; !mlIt.IsAtEnd(); ++mlIt, ++plIt)
+  {
+    maskSegments += mlIt.Get().size();
+    maskBytes += mlIt.Get().GetOwnedBytes();
+    pairSegments += plIt.Get().size();
+    pairBytes += plIt.Get().capacity() * sizeof(PairRLEImageType::RLSegment); // pair lines may share storage
+  }
+  std::cout << "Mask segments: " << maskSegments << " in " << maskBytes << " bytes, as pairs " << pairBytes
+            << " bytes" << std::endl;
+  ok &= maskSegments == pairSegments && 2 * maskBytes <= pairBytes;
+
+  // alternating segments are merged even without on the fly cleanup
+  mask->SetOnTheFlyCleanup(false);
+  paintMask(5);
+  ok &= same(mask, "Mask repainted");
+
+  using EncoderType = itk::RegionOfInterestImageFilter<MaskImageType, MaskRLEImageType>;
+  EncoderType::Pointer encoder = EncoderType::New();
+  encoder->SetInput(dense);
+  encoder->SetRegionOfInterest(region);
+  encoder->Update();
+  MaskRLEImageType::Pointer encoded = encoder->GetOutput();
+  ok &= same(encoded, "Mask encoded");
+  encoded->Freeze();
+  ok &= same(encoded, "Mask frozen");
+
+  // the encoder output starts at index 0
+  DenseImageType::RegionType roiRegion = encoded->GetLargestPossibleRegion();
+  roiRegion.SetIndex(0, 3);
+  roiRegion.SetSize(0, region.GetSize(0) - 10);
+  DenseImageType::RegionType denseRoiRegion = region;
+  denseRoiRegion.SetIndex(0, region.GetIndex(0) + 3);
+  denseRoiRegion.SetSize(0, roiRegion.GetSize(0));
+  using RoiType = itk::RegionOfInterestImageFilter<MaskRLEImageType, MaskRLEImageType>;
+  RoiType::Pointer roi = RoiType::New();
+  roi->SetInput(encoded);
+  roi->SetRegionOfInterest(roiRegion);
+  roi->Update();
+  using DecoderType = itk::RegionOfInterestImageFilter<MaskRLEImageType, MaskImageType>;
+  DecoderType::Pointer decoder = DecoderType::New();
+  decoder->SetInput(encoded);
+  decoder->SetRegionOfInterest(roiRegion);
+  decoder->Update();
+  itk::ImageRegionConstIterator<MaskImageType>    rdIt(dense, denseRoiRegion);
+  itk::ImageRegionConstIterator<MaskRLEImageType> rIt(roi->GetOutput(), roi->GetOutput()->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<MaskImageType>    oIt(decoder->GetOutput(), decoder->GetOutput()->GetBufferedRegion());
+  for (; !rdIt.IsAtEnd(); ++rdIt, ++rIt, ++oIt)
+  {
+    ok &= rdIt.Get() == rIt.Get() && rdIt.Get() == oIt.Get();
+  }
+
+  encoded->ReplaceValue(false, true);
+  dense->FillBuffer(true);
+  ok &= same(encoded, "Mask replaced");
+
+  // any two pixel values, kept in the palette
+  using ShortMaskRLEImageType = itk::BinaryMaskRLEImage<short, 3>;
+  DenseImageType::Pointer shortDense = DenseImageType::New();
+  shortDense->SetRegions(region);
+  shortDense->Allocate();
+  ShortMaskRLEImageType::Pointer shortMask = ShortMaskRLEImageType::New();
+  shortMask->SetRegions(region);
+  shortMask->Allocate();
+  itk::ImageRegionIterator<DenseImageType>        sdIt(shortDense, region);
+  itk::ImageRegionIterator<ShortMaskRLEImageType> smIt(shortMask, region);
+  for (; !sdIt.IsAtEnd(); ++sdIt, ++smIt)
+  {
+    sdIt.Set(labelAt(sdIt.GetIndex(), 0) % 2 == 1 ? 255 : 0);
+    smIt.Set(sdIt.Get());
+  }
+  ok &= sameContent(shortDense.GetPointer(), shortMask.GetPointer(), "Two-valued mask");
+  ok &= shortMask->GetPalette().size() == 2;
+  try
+  {
+    shortMask->SetPixel(region.GetIndex(), 7);
+    ok = false;
+  }
+  catch (const itk::ExceptionObject &)
+  {
+    std::cout << "A third value is rejected" << std::endl;
+  }
+
+  // merging the two values frees an index for the next one
+  shortMask->ReplaceValue(255, 0);
+  shortDense->FillBuffer(0);
+  ok &= sameContent(shortDense.GetPointer(), shortMask.GetPointer(), "Two-valued mask merged");
+  shortMask->SetPixel(region.GetIndex(), 255);
+  shortDense->SetPixel(region.GetIndex(), 255);
+  ok &= sameContent(shortDense.GetPointer(), shortMask.GetPointer(), "Value written again after merging");
+
+  std::cout << "Binary mask: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// noisy lines are stored as rows of pixels, and encoded again once they are not
+static bool
+testNoisyLines(const DenseImageType::RegionType & region)
+{
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate();
+  HybridRLEImageType::Pointer rle = HybridRLEImageType::New();
+  rle->SetRegions(region);
+  rle->Allocate();
+
+  auto paintNoise = [&dense, &rle](unsigned seed) {
+    itk::ImageRegionIterator<DenseImageType>     dIt(dense, dense->GetLargestPossibleRegion());
+    itk::ImageRegionIterator<HybridRLEImageType> rIt(rle, rle->GetLargestPossibleRegion());
+    for (unsigned v = seed; !dIt.IsAtEnd(); ++dIt, ++rIt)
+    {
+      v = v * 1103515245u + 12345u;
+      dIt.Set(static_cast<short>(v >> 20));
+      rIt.Set(dIt.Get());
+    }
+  };
+  // returns the number of dense lines, and the bytes owned by all lines
+  auto denseLines = [](const HybridRLEImageType * image, itk::SizeValueType & bytes) {
+    itk::SizeValueType                                            count = 0;
+    itk::ImageRegionConstIterator<HybridRLEImageType::BufferType> lIt(image->GetBuffer(),
+                                                                       image->GetBuffer()->GetBufferedRegion());
+    for (bytes = 0; !lIt.IsAtEnd(); ++lIt)
+    {
+      count += lIt.Get().IsDense();
+      bytes += lIt.Get().GetOwnedBytes();
+    }
+    return count;
+  };
+  const itk::SizeValueType lineCount = region.GetNumberOfPixels() / region.GetSize(0);
+  const itk::SizeValueType pixelBytes = region.GetNumberOfPixels() * sizeof(short);
+  itk::SizeValueType       bytes = 0;
+
+  paintNoise(1);
+  bool ok = sameContent(dense.GetPointer(), rle.GetPointer(), "Noise painted");
+  ok &= denseLines(rle, bytes) == lineCount;
+  rle->Compact();
+  ok &= denseLines(rle, bytes) == lineCount && bytes == pixelBytes;
+  std::cout << "Noise takes " << bytes << " bytes, dense image " << pixelBytes << std::endl;
+
+  paint<DenseImageType>(dense, 0);
+  paint<HybridRLEImageType>(rle, 0);
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Labels painted over noise");
+  ok &= denseLines(rle, bytes) == 0;
+
+  paintNoise(2);
+  rle->SetOnTheFlyCleanup(false);
+  paint<DenseImageType>(dense, 3);
+  paint<HybridRLEImageType>(rle, 3);
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Labels painted without cleanup");
+  ok &= denseLines(rle, bytes) == 0;
+
+  // the encoder and thawing choose the representation of each line
+  paintNoise(4);
+  using EncoderType = itk::RegionOfInterestImageFilter<DenseImageType, HybridRLEImageType>;
+  EncoderType::Pointer encoder = EncoderType::New();
+  encoder->SetInput(dense);
+  encoder->SetRegionOfInterest(region);
+  encoder->Update();
+  HybridRLEImageType::Pointer encoded = encoder->GetOutput();
+  ok &= denseLines(encoded, bytes) == lineCount;
+  encoded->Freeze();
+  encoded->Thaw();
+  ok &= denseLines(encoded, bytes) == lineCount;
+  itk::ImageRegionConstIterator<DenseImageType>     dIt(dense, region);
+  itk::ImageRegionConstIterator<HybridRLEImageType> eIt(encoded, encoded->GetLargestPossibleRegion());
+  for (; !dIt.IsAtEnd(); ++dIt, ++eIt)
+  {
+    ok &= dIt.Get() == eIt.Get();
+  }
+
+  std::cout << "Noisy lines: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// lines which are all background are stored as absent (empty) lines
+static bool
+testSparseLines(const DenseImageType::RegionType & region)
+{
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate(true);
+  RLEImageType::Pointer rle = RLEImageType::New();
+  rle->SetSparseLines(true);
+  rle->SetRegions(region);
+  rle->Allocate();
+
+  auto absentLines = [](const RLEImageType * image) {
+    itk::SizeValueType                                      count = 0;
+    itk::ImageRegionConstIterator<RLEImageType::BufferType> lIt(image->GetBuffer(),
+                                                                 image->GetBuffer()->GetBufferedRegion());
+    for (; !lIt.IsAtEnd(); ++lIt)
+    {
+      count += lIt.Get().empty();
+    }
+    return count;
+  };
+  // labels in a small box, background elsewhere
+  auto paintBox = [&dense, &rle](unsigned seed, const DenseImageType::RegionType & box) {
+    itk::ImageRegionIterator<DenseImageType> dIt(dense, dense->GetLargestPossibleRegion());
+    itk::ImageRegionIterator<RLEImageType>   rIt(rle, rle->GetLargestPossibleRegion());
+    for (; !dIt.IsAtEnd(); ++dIt, ++rIt)
+    {
+      dIt.Set(box.IsInside(dIt.GetIndex()) ? static_cast<short>(1 + labelAt(dIt.GetIndex(), seed)) : 0);
+      rIt.Set(dIt.Get());
+    }
+  };
+  const itk::SizeValueType lineCount = region.GetNumberOfPixels() / region.GetSize(0);
+  DenseImageType::RegionType box;
+  box.SetIndex(0, 40);
+  box.SetIndex(1, 0);
+  box.SetIndex(2, 2);
+  box.SetSize(0, 60);
+  box.SetSize(1, 5);
+  box.SetSize(2, 4);
+
+  bool ok = absentLines(rle) == lineCount && sameContent(dense.GetPointer(), rle.GetPointer(), "Allocated absent");
+
+  paintBox(0, box);
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Box painted");
+  ok &= absentLines(rle) == lineCount - 20; // writing background leaves lines absent
+
+  DenseImageType::IndexType index = region.GetIndex();
+  rle->SetPixel(index, 0);
+  ok &= absentLines(rle) == lineCount - 20;
+  rle->SetPixel(index, 7);
+  dense->SetPixel(index, 7);
+  ok &= absentLines(rle) == lineCount - 21 && sameContent(dense.GetPointer(), rle.GetPointer(), "Line materialized");
+
+  // lines painted back to background become absent when compacted
+  box.SetSize(2, 3);
+  paintBox(1, box);
+  ok &= absentLines(rle) == lineCount - 21;
+  rle->Compact();
+  ok &= absentLines(rle) == lineCount - 15 && sameContent(dense.GetPointer(), rle.GetPointer(), "Compacted");
+
+  rle->Freeze();
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Frozen");
+  rle->Thaw();
+  ok &= absentLines(rle) == lineCount - 15;
+
+  using ROIType = itk::RegionOfInterestImageFilter<RLEImageType, RLEImageType>;
+  DenseImageType::RegionType roiRegion = region;
+  roiRegion.SetIndex(2, 1);
+  roiRegion.SetSize(2, 4);
+  ROIType::Pointer roi = ROIType::New();
+  roi->SetInput(rle);
+  roi->SetRegionOfInterest(roiRegion);
+  roi->Update();
+  RLEImageType::Pointer roiOut = roi->GetOutput();
+  ok &= roiOut->GetSparseLines() && absentLines(roiOut) == 4 * region.GetSize(1) - 15;
+  itk::ImageRegionConstIterator<DenseImageType> dIt(dense, roiRegion);
+  itk::ImageRegionConstIterator<RLEImageType>   oIt(roiOut, roiOut->GetLargestPossibleRegion());
+  for (; !dIt.IsAtEnd(); ++dIt, ++oIt)
+  {
+    ok &= dIt.Get() == oIt.Get();
+  }
+
+  using EncoderType = itk::RegionOfInterestImageFilter<DenseImageType, RLEImageType>;
+  EncoderType::Pointer encoder = EncoderType::New();
+  encoder->SetInput(dense);
+  encoder->SetRegionOfInterest(region);
+  encoder->SparseLinesOn();
+  encoder->Update();
+  RLEImageType::Pointer encoded = encoder->GetOutput();
+  ok &= absentLines(encoded) == lineCount - 15;
+  itk::ImageRegionConstIterator<RLEImageType> eIt(encoded, encoded->GetLargestPossibleRegion());
+  for (dIt = itk::ImageRegionConstIterator<DenseImageType>(dense, region); !dIt.IsAtEnd(); ++dIt, ++eIt)
+  {
+    ok &= dIt.Get() == eIt.Get();
+  }
+
+  rle->ReplaceValue(0, 9);
+  replaceValue(dense, 0, 9);
+  ok &= absentLines(rle) == 0 && sameContent(dense.GetPointer(), rle.GetPointer(), "Background replaced");
+
+  encoded->SetSparseLines(false);
+  ok &= absentLines(encoded) == 0;
+  replaceValue(dense, 9, 0);
+  for (dIt.GoToBegin(), eIt.GoToBegin(); !dIt.IsAtEnd(); ++dIt, ++eIt)
+  {
+    ok &= dIt.Get() == eIt.Get();
+  }
+
+  std::cout << "Sparse lines: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// slabs along Z which are known to be uniform are skipped without reading their lines
+static bool
+testSlabSummary(const DenseImageType::RegionType & region)
+{
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate(true);
+  RLEImageType::Pointer rle = RLEImageType::New();
+  rle->SetSlabSummary(true);
+  rle->SetRegions(region);
+  rle->Allocate();
+
+  // returns the number of uniform slabs, and checks their values against the dense image
+  auto uniformSlabs = [&dense](const RLEImageType * image, const DenseImageType::RegionType & denseRegion) {
+    itk::SizeValueType       count = 0;
+    RLEImageType::RLValueType stored;
+    for (itk::SizeValueType z = 0; z < denseRegion.GetSize(2); z++)
+    {
+      if (image->IsUniformSlab(image->GetBufferedRegion().GetIndex(2) + z, stored))
+      {
+        DenseImageType::RegionType slab = denseRegion;
+        slab.SetIndex(2, denseRegion.GetIndex(2) + z);
+        slab.SetSize(2, 1);
+        itk::ImageRegionConstIterator<DenseImageType> dIt(dense, slab);
+        for (; !dIt.IsAtEnd(); ++dIt)
+        {
+          if (dIt.Get() != stored)
+          {
+            return itk::SizeValueType(-1);
+          }
+        }
+        ++count;
+      }
+    }
+    return count;
+  };
+  // sums the pixels of the image, skipping uniform slabs
+  auto sum = [](const RLEImageType * image, itk::SizeValueType & skipped) {
+    long long                                   total = 0;
+    short                                       value = 0;
+    itk::SizeValueType                          count = 0;
+    itk::ImageRegionConstIterator<RLEImageType> it(image, image->GetLargestPossibleRegion());
+    for (skipped = 0; !it.IsAtEnd();)
+    {
+      if (it.SkipUniformSlab(value, count))
+      {
+        total += value * static_cast<long long>(count);
+        skipped += count;
+        continue;
+      }
+      total += it.Get();
+      ++it;
+    }
+    return total;
+  };
+  auto denseSum = [&dense]() {
+    long long                                     total = 0;
+    itk::ImageRegionConstIterator<DenseImageType> dIt(dense, dense->GetLargestPossibleRegion());
+    for (; !dIt.IsAtEnd(); ++dIt)
+    {
+      total += dIt.Get();
+    }
+    return total;
+  };
+  const itk::SizeValueType slabPixels = region.GetNumberOfPixels() / region.GetSize(2);
+  itk::SizeValueType       skipped = 0;
+
+  bool ok = uniformSlabs(rle, region) == 10 && sum(rle, skipped) == 0 && skipped == region.GetNumberOfPixels();
+
+  // paint slabs 3 and 4 through iterators, and a pixel of slab 7
+  DenseImageType::RegionType box = region;
+  box.SetIndex(2, 3);
+  box.SetSize(2, 2);
+  itk::ImageRegionIterator<DenseImageType> dIt(dense, box);
+  itk::ImageRegionIterator<RLEImageType>   rIt(rle, box);
+  for (; !dIt.IsAtEnd(); ++dIt, ++rIt)
+  {
+    dIt.Set(labelAt(dIt.GetIndex(), 0));
+    rIt.Set(dIt.Get());
+  }
+  DenseImageType::IndexType index = region.GetIndex();
+  index[2] = 7;
+  rle->SetPixel(index, 2);
+  dense->SetPixel(index, 2);
+  ok &= uniformSlabs(rle, region) == 7 && sameContent(dense.GetPointer(), rle.GetPointer(), "Slabs painted");
+  ok &= sum(rle, skipped) == denseSum() && skipped == 7 * slabPixels;
+
+  // a slab painted back to uniform stays mixed until the summary is updated
+  rle->SetPixel(index, 0);
+  dense->SetPixel(index, 0);
+  ok &= uniformSlabs(rle, region) == 7;
+  rle->UpdateSlabSummary();
+  ok &= uniformSlabs(rle, region) == 8;
+
+  rle->ReplaceValue(0, 5);
+  replaceValue(dense, 0, 5);
+  ok &= uniformSlabs(rle, region) == 8 && sum(rle, skipped) == denseSum() && skipped == 8 * slabPixels;
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Background replaced");
+
+  // region of interest reads uniform slabs from the summary
+  DenseImageType::RegionType roiRegion = region;
+  roiRegion.SetIndex(0, 10);
+  roiRegion.SetSize(0, 100);
+  roiRegion.SetIndex(2, 2);
+  roiRegion.SetSize(2, 5);
+  rle->Freeze();
+  using ROIType = itk::RegionOfInterestImageFilter<RLEImageType, RLEImageType>;
+  ROIType::Pointer roi = ROIType::New();
+  roi->SetInput(rle);
+  roi->SetRegionOfInterest(roiRegion);
+  roi->Update();
+  ok &= roi->GetOutput()->GetSlabSummary() && uniformSlabs(roi->GetOutput(), roiRegion) == 3;
+  using DecoderType = itk::RegionOfInterestImageFilter<RLEImageType, DenseImageType>;
+  DecoderType::Pointer decoder = DecoderType::New();
+  decoder->SetInput(rle);
+  decoder->SetRegionOfInterest(roiRegion);
+  decoder->Update();
+  RLEImageType::Pointer                         roiOut = roi->GetOutput();
+  DenseImageType::Pointer                       decoded = decoder->GetOutput();
+  itk::ImageRegionConstIterator<DenseImageType> eIt(dense, roiRegion);
+  itk::ImageRegionConstIterator<RLEImageType>   oIt(roiOut, roiOut->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<DenseImageType> cIt(decoded, decoded->GetLargestPossibleRegion());
+  for (; !eIt.IsAtEnd(); ++eIt, ++oIt, ++cIt)
+  {
+    ok &= eIt.Get() == oIt.Get() && eIt.Get() == cIt.Get();
+  }
+  ok &= rle->IsFrozen();
+
+  // lines written through the buffer make all slabs mixed
+  rle->GetBuffer();
+  ok &= uniformSlabs(rle, region) == 0;
+  rle->FillBuffer(3);
+  dense->FillBuffer(3);
+  ok &= uniformSlabs(rle, region) == 10;
+
+  // writes gathered with WriteCombining on make their slab mixed before it is skipped
+  rle->SetWriteCombining(true);
+  {
+    itk::ImageRegionIterator<RLEImageType> it(rle, region);
+    it.Set(1);
+    dense->SetPixel(region.GetIndex(), 1);
+    short              value = 0;
+    itk::SizeValueType count = 0;
+    ok &= !it.SkipUniformSlab(value, count) && it.Get() == 1;
+  }
+  rle->SetWriteCombining(false);
+  ok &= uniformSlabs(rle, region) == 9 && sum(rle, skipped) == denseSum() && skipped == 9 * slabPixels;
+
+  std::cout << "Slab summary: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// Allocate() leaves lines absent, Allocate(true) makes them uniform
+static bool
+testAllocate(const DenseImageType::RegionType & region)
+{
+  using BufferType = SoARLEImageType::BufferType;
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate(true);
+  SoARLEImageType::Pointer rle = SoARLEImageType::New();
+  rle->SetRegions(region);
+
+  auto lineSizes = [&rle](itk::SizeValueType size) {
+    const SoARLEImageType *                   constRle = rle;
+    bool                                      same = true;
+    itk::ImageRegionConstIterator<BufferType> it(constRle->GetBuffer(), constRle->GetBuffer()->GetBufferedRegion());
+    for (; !it.IsAtEnd(); ++it)
+    {
+      same &= it.Value().size() == size && (size > 0 || it.Value().GetOwnedBytes() == 0);
+    }
+    return same;
+  };
+
+  rle->Allocate();
+  bool ok = lineSizes(0) && sameContent(dense.GetPointer(), rle.GetPointer(), "Allocated uninitialized");
+  rle->Allocate(true);
+  ok &= lineSizes(1) && sameContent(dense.GetPointer(), rle.GetPointer(), "Allocated initialized");
+
+  SoARLEImageType::IndexType index = region.GetIndex();
+  index[0] += 10;
+  rle->SetPixel(index, 1);
+  rle->Allocate(); // reallocating the same size does not keep the old lines
+  ok &= lineSizes(0) && rle->GetPixel(index) == 0;
+  rle->GetBufferForOverwrite(); // lines which are not assigned stay absent
+  ok &= lineSizes(0);
+  rle->GetBuffer(); // lines written through the buffer are never absent
+  ok &= lineSizes(1) && sameContent(dense.GetPointer(), rle.GetPointer(), "Buffer of allocated image");
+
+  rle->SetSparseLines(true);
+  rle->Allocate(true); // background lines stay absent
+  ok &= lineSizes(0) && sameContent(dense.GetPointer(), rle.GetPointer(), "Allocated sparse");
+
+  std::cout << "Allocate: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+#if __has_include(<memory_resource>)
+// counts the bytes currently allocated through it
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+  std::atomic<std::size_t> m_Bytes{ 0 };
+
+private:
+  void *
+  do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    m_Bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void
+  do_deallocate(void * p, std::size_t bytes, std::size_t alignment) override
+  {
+    m_Bytes -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool
+  do_is_equal(const std::pmr::memory_resource & other) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+// lines draw their storage from the memory resource of the image
+static bool
+testLineAllocator(const DenseImageType::RegionType & region)
+{
+  using PmrRLEImageType = itk::PmrRLEImage<short, 3>;
+  CountingResource resource;
+  bool             ok = true;
+  {
+    DenseImageType::Pointer dense = DenseImageType::New();
+    dense->SetRegions(region);
+    dense->Allocate();
+    PmrRLEImageType::Pointer rle = PmrRLEImageType::New();
+    rle->SetLineAllocator(&resource);
+    rle->SetRegions(region);
+    rle->Allocate();
+
+    // all heap storage of the lines is accounted for by the resource
+    auto allocatedBytes = [&rle, &region]() {
+      const itk::SizeValueType lineCount = region.GetNumberOfPixels() / region.GetSize(0);
+      return rle->GetNumberOfBytes() - lineCount * sizeof(PmrRLEImageType::RLLine) -
+             rle->GetPalette().capacity() * sizeof(short);
+    };
+
+    paint<DenseImageType>(dense, 0);
+    paint<PmrRLEImageType>(rle, 0);
+    ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Painted from a memory resource");
+    ok &= resource.m_Bytes > 0 && allocatedBytes() == resource.m_Bytes;
+
+    rle->Freeze();
+    ok &= resource.m_Bytes == 0;
+    paint<DenseImageType>(dense, 5);
+    paint<PmrRLEImageType>(rle, 5);
+    ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Thawed into a memory resource");
+    ok &= resource.m_Bytes > 0 && allocatedBytes() == resource.m_Bytes;
+  }
+  ok &= resource.m_Bytes == 0; // all returned with the image
+
+  std::cout << "Line allocator: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+#endif
+
+// images compare equal by their pixels, whatever their segments and palettes
+static bool
+testLineHashes(const DenseImageType::RegionType & region)
+{
+  RLEImageType::Pointer a = RLEImageType::New();
+  a->SetRegions(region);
+  a->Allocate();
+  paint<RLEImageType>(a, 0);
+  RLEImageType::Pointer b = RLEImageType::New();
+  b->SetRegions(region);
+  b->Allocate();
+  b->SetOnTheFlyCleanup(false); // leaves b segmented differently
+  paint<RLEImageType>(b, 5);
+  paint<RLEImageType>(b, 0);
+
+  bool ok = a->IsSameContent(b) && b->IsSameContent(a) && a->GetDifferingLines(b).empty();
+  RLEImageType::IndexType index = region.GetIndex();
+  index[0] += 40;
+  index[1] += 3;
+  const RLEImageType::BufferType::IndexType lineIndex = a->GetLineIndex(index);
+  ok &= a->GetLineHash(lineIndex) == b->GetLineHash(lineIndex);
+
+  // a write forgets the hash of its line
+  const short old = b->GetPixel(index);
+  b->SetPixel(index, short(old + 1));
+  std::vector<RLEImageType::BufferType::IndexType> differing = a->GetDifferingLines(b);
+  ok &= differing.size() == 1 && differing[0] == lineIndex && !a->IsSameContent(b);
+  ok &= a->GetLineHash(lineIndex) != b->GetLineHash(lineIndex);
+  itk::ImageRegionIterator<RLEImageType> it(b, RLEImageType::RegionType(index, RLEImageType::SizeType::Filled(1)));
+  it.Set(old);
+  ok &= a->IsSameContent(b) && a->GetLineHash(lineIndex) == b->GetLineHash(lineIndex);
+
+  b->Freeze();
+  ok &= a->IsSameContent(b) && b->IsFrozen();
+  a->FillBuffer(1);
+  ok &= a->GetDifferingLines(b).size() == region.GetNumberOfPixels() / region.GetSize(0);
+
+  RLEImageType::Pointer    smaller = RLEImageType::New();
+  RLEImageType::RegionType smallerRegion = region;
+  smallerRegion.SetSize(2, region.GetSize(2) - 1);
+  smaller->SetRegions(smallerRegion);
+  smaller->Allocate();
+  ok &= !a->IsSameContent(smaller);
+
+  // the same pixels stored through different palettes
+  PaletteRLEImageType::Pointer p = PaletteRLEImageType::New();
+  p->SetRegions(region);
+  p->Allocate();
+  paint<PaletteRLEImageType>(p, 0);
+  PaletteRLEImageType::Pointer q = PaletteRLEImageType::New();
+  q->SetRegions(region);
+  q->Allocate();
+  paint<PaletteRLEImageType>(q, 5);
+  paint<PaletteRLEImageType>(q, 0);
+  ok &= p->GetPalette() != q->GetPalette() && p->IsSameContent(q);
+  ok &= p->GetLineHash(lineIndex) == q->GetLineHash(lineIndex);
+  q->ReplaceValue(3, 7);
+  ok &= !p->IsSameContent(q);
+
+  // comparisons in several threads make room for the hashes of the same image
+  RLEImageType::Pointer c = RLEImageType::New();
+  c->SetRegions(region);
+  c->Allocate();
+  paint<RLEImageType>(c, 0);
+  std::atomic<bool>        sameInThreads{ true };
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < 4; t++)
+  {
+    threads.emplace_back([&c, &b, &sameInThreads]() {
+      if (!c->IsSameContent(b))
+      {
+        sameInThreads = false;
+      }
+    });
+  }
+  for (auto & thread : threads)
+  {
+    thread.join();
+  }
+  ok &= sameInThreads;
+
+  std::cout << "Line hashes: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// are adjacent segments of the same value merged, as far as the counter type allows?
+template <typename RLEImageType>
+static bool
+cleanLines(const RLEImageType * rle)
+{
+  itk::SizeValueType                                                 segments = 0;
+  itk::SizeValueType                                                 cleanSegments = 0;
+  itk::ImageRegionConstIterator<typename RLEImageType::BufferType> lIt(rle->GetBuffer(),
+                                                                       rle->GetBuffer()->GetBufferedRegion());
+  for (; !lIt.IsAtEnd(); ++lIt)
+  {
+    const typename RLEImageType::RLLine & line = lIt.Value();
+    typename RLEImageType::RLLine         clean;
+    for (itk::SizeValueType x = 0; x < line.size(); x++)
+    {
+      RLEImageType::AppendRun(clean, line[x].first, line[x].second);
+    }
+    segments += line.size();
+    cleanSegments += clean.size();
+  }
+  return RLEImageType::RLLine::StoresPixelRows || segments == cleanSegments;
+}
+
+// deterministic pseudo-random numbers below n, for choosing edits
+struct RandomNumbers
+{
+  unsigned int state;
+
+  itk::SizeValueType
+  operator()(itk::SizeValueType n)
+  {
+    state = state * 1103515245u + 12345u;
+    return itk::SizeValueType(state >> 8) % n;
+  }
+};
+
+// a dense image and an RLE image with sparse lines, both of background
+template <typename RLEImageType>
+static void
+allocateImages(const DenseImageType::RegionType & region,
+               DenseImageType::Pointer &          dense,
+               itk::SmartPointer<RLEImageType> &  rle,
+               unsigned int                       runAxis = 0)
+{
+  dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate(true);
+  rle = RLEImageType::New();
+  rle->SetRunAxis(runAxis);
+  rle->SetRegions(region);
+  rle->Allocate();
+  rle->SetSparseLines(true);
+}
+
+// the line through an index, across the whole region
+static DenseImageType::RegionType
+lineThrough(const DenseImageType::RegionType & region, const DenseImageType::IndexType & index)
+{
+  DenseImageType::RegionType line = region;
+  for (unsigned int d = 1; d < 3; d++)
+  {
+    line.SetIndex(d, index[d]);
+    line.SetSize(d, 1);
+  }
+  return line;
+}
+
+// does background written over a whole line, by write(line), make the line absent again?
+template <typename RLEImageType, typename WriteFunction>
+static bool
+lineBecomesAbsent(DenseImageType *                   dense,
+                  const RLEImageType *               rle,
+                  const DenseImageType::RegionType & line,
+                  WriteFunction                      write)
+{
+  write(line);
+  for (itk::ImageRegionIterator<DenseImageType> dIt(dense, line); !dIt.IsAtEnd(); ++dIt)
+  {
+    dIt.Set(0);
+  }
+  return rle->GetBuffer()->GetPixel(rle->GetLineIndex(line.GetIndex())).empty();
+}
+
+// runs set in one call give the same pixels as setting them one at a time
+template <typename RLEImageType>
+static bool
+testSetRun(const DenseImageType::RegionType & region, const std::vector<short> & values, const char * name)
+{
+  DenseImageType::Pointer        dense;
+  typename RLEImageType::Pointer rle;
+  allocateImages(region, dense, rle);
+
+  RandomNumbers next{ 1 };
+  bool          ok = true;
+  for (unsigned int i = 0; i < 2000; i++)
+  {
+    DenseImageType::IndexType index = region.GetIndex();
+    index[1] += next(region.GetSize(1));
+    index[2] += next(region.GetSize(2));
+    const itk::SizeValueType length = next(region.GetSize(0) + 1); // up to a whole line
+    index[0] += next(region.GetSize(0) - length + 1);
+    const short value = values[next(values.size())];
+    if (i % 2 == 0)
+    {
+      rle->SetRun(index, length, value);
+    }
+    else
+    {
+      itk::ImageRegionIterator<RLEImageType> it(rle, region);
+      it.SetIndex(index);
+      it.SetRun(length, value);
+      ok &= length == 0 || it.Get() == value; // still on the first pixel of the run
+    }
+    for (itk::SizeValueType x = 0; x < length; x++, index[0]++)
+    {
+      dense->SetPixel(index, value);
+    }
+  }
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), name);
+  ok &= cleanLines(rle.GetPointer()); // segments of the same value were merged as the runs were set
+
+  ok &= lineBecomesAbsent(dense.GetPointer(),
+                          rle.GetPointer(),
+                          lineThrough(region, region.GetIndex()),
+                          [&](const DenseImageType::RegionType & line) {
+                            rle->SetRun(line.GetIndex(), line.GetSize(0), values[0]);
+                          });
+
+  std::cout << name << " runs: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// iterators with WriteCombining on splice their writes into lines at once
+template <typename RLEImageType>
+static bool
+testWriteCombining(const DenseImageType::RegionType & region, const char * name)
+{
+  DenseImageType::Pointer        dense;
+  typename RLEImageType::Pointer rle;
+  allocateImages(region, dense, rle);
+  rle->SetWriteCombining(true);
+  paint(dense.GetPointer(), 5);
+  paint(rle.GetPointer(), 5);
+  bool ok = sameContent(dense.GetPointer(), rle.GetPointer(), "Painted with write combining");
+  ok &= cleanLines(rle.GetPointer());
+
+  // a written pixel reads back through the same iterator, writing one which does not follow splices in the others
+  DenseImageType::RegionType inner = region;
+  inner.ShrinkByRadius(2);
+  {
+    itk::ImageScanlineIterator<RLEImageType> it(rle, inner);
+    for (; !it.IsAtEnd(); it.NextLine())
+    {
+      for (; !it.IsAtEndOfLine(); ++it)
+      {
+        const short value = labelAt(it.GetIndex(), 6);
+        it.Set(value);
+        dense->SetPixel(it.GetIndex(), value);
+        ok &= it.GetIndex()[0] % 7 != 0 || it.Get() == value;
+      }
+      it.GoToBeginOfLine();
+      it.Set(3);
+      dense->SetPixel(it.GetIndex(), 3);
+    }
+  }
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Repainted with write combining");
+
+  ok &= lineBecomesAbsent(dense.GetPointer(),
+                          rle.GetPointer(),
+                          lineThrough(region, region.GetIndex()),
+                          [&](const DenseImageType::RegionType & line) {
+                            itk::ImageRegionIterator<RLEImageType> it(rle, line);
+                            for (; !it.IsAtEnd(); ++it)
+                            {
+                              it.Set(0);
+                            }
+                          });
+
+  // the first write thaws a frozen image, FlushWrites() makes the writes visible at once
+  rle->Freeze();
+  {
+    itk::ImageRegionIteratorWithIndex<RLEImageType> it(rle, inner);
+    it.Set(2);
+    it.FlushWrites();
+    ok &= !rle->IsFrozen() && rle->GetPixel(inner.GetIndex()) == 2;
+  }
+  dense->SetPixel(inner.GetIndex(), 2);
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Frozen with write combining");
+
+  // until then, other readers see the previous pixels
+  {
+    itk::ImageRegionIteratorWithIndex<RLEImageType> it(rle, inner);
+    it.Set(4);
+    ok &= it.Get() == 4 && rle->GetPixel(inner.GetIndex()) == 2;
+    it.FlushWrites();
+    ok &= rle->GetPixel(inner.GetIndex()) == 4;
+    it.Set(2);
+  }
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Read while gathering writes");
+
+  // an iterator with gathered writes keeps its image alive
+  {
+    typename RLEImageType::Pointer temporary = RLEImageType::New();
+    temporary->SetRegions(region);
+    temporary->Allocate();
+    temporary->SetWriteCombining(true);
+    itk::ImageRegionIterator<RLEImageType> it(temporary, region);
+    it.Set(1);
+    temporary = nullptr;
+  }
+
+  // along another run axis, consecutive pixels lie on different lines
+  typename RLEImageType::Pointer zRuns = RLEImageType::New();
+  zRuns->SetRegions(region);
+  zRuns->SetRunAxis(2);
+  zRuns->Allocate();
+  zRuns->SetWriteCombining(true);
+  paint(zRuns.GetPointer(), 5);
+  paint(dense.GetPointer(), 5);
+  ok &= sameContent(dense.GetPointer(), zRuns.GetPointer(), "Run axis 2 with write combining");
+
+  std::cout << name << " write combining: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// scattered edits set in a batch, line by line
+template <typename RLEImageType>
+static bool
+testSetPixels(const DenseImageType::RegionType & region, const char * name)
+{
+  DenseImageType::Pointer        dense;
+  typename RLEImageType::Pointer rle;
+  allocateImages(region, dense, rle);
+  paint(dense.GetPointer(), 8);
+  paint(rle.GetPointer(), 8);
+
+  RandomNumbers next{ 7 };
+  bool          ok = true;
+  for (bool inParallel : { true, false })
+  {
+    std::vector<typename RLEImageType::PixelEdit> edits;
+    for (unsigned int i = 0; i < 20000; i++) // several edits of some pixels
+    {
+      DenseImageType::IndexType index = region.GetIndex();
+      for (unsigned int d = 0; d < 3; d++)
+      {
+        index[d] += next(region.GetSize(d));
+      }
+      const short value = static_cast<short>(next(4));
+      edits.emplace_back(index, value);
+      dense->SetPixel(index, value); // in order, so the last edit of a pixel wins
+    }
+    rle->SetPixels(edits, inParallel);
+    ok &= sameContent(dense.GetPointer(), rle.GetPointer(), inParallel ? "Edited in parallel" : "Edited in sequence");
+    ok &= cleanLines(rle.GetPointer());
+  }
+
+  ok &= lineBecomesAbsent(dense.GetPointer(),
+                          rle.GetPointer(),
+                          lineThrough(region, region.GetIndex()),
+                          [&](const DenseImageType::RegionType & line) {
+                            std::vector<typename RLEImageType::PixelEdit> edits;
+                            DenseImageType::IndexType                     index = line.GetIndex();
+                            for (itk::SizeValueType x = 0; x < line.GetSize(0); x++, index[0]++)
+                            {
+                              edits.emplace_back(index, 0);
+                            }
+                            rle->SetPixels(edits);
+                          });
+
+  std::cout << name << " batch: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// an edit session writes to rows of pixels, and encodes the written ones at its end
+template <typename RLEImageType>
+static bool
+testEditSession(const DenseImageType::RegionType & region, const char * name)
+{
+  DenseImageType::Pointer        dense;
+  typename RLEImageType::Pointer rle;
+  allocateImages(region, dense, rle);
+  paint(dense.GetPointer(), 9);
+  paint(rle.GetPointer(), 9);
+
+  // labels as the image stores them, all but 0 become true in a mask of bool
+  auto label = [](short value) { return static_cast<short>(static_cast<typename RLEImageType::PixelType>(value)); };
+  for (itk::ImageRegionIterator<DenseImageType> dIt(dense, region); !dIt.IsAtEnd(); ++dIt)
+  {
+    dIt.Set(label(dIt.Get()));
+  }
+
+  // a brush stroke of overlapping balls, painted again and again
+  DenseImageType::RegionType brush = region;
+  brush.ShrinkByRadius(3);
+  rle->BeginEdit(brush);
+  bool ok = rle->IsEditing();
+  for (unsigned int stroke = 0; stroke < 4; stroke++)
+  {
+    itk::ImageRegionIteratorWithIndex<RLEImageType> it(rle, brush);
+    for (; !it.IsAtEnd(); ++it)
+    {
+      const DenseImageType::IndexType index = it.GetIndex();
+      const itk::OffsetValueType      dx = index[0] - 20 - 25 * itk::OffsetValueType(stroke);
+      const itk::OffsetValueType      dy = index[1] - 4;
+      const itk::OffsetValueType      dz = index[2] - 5;
+      if (dx * dx + dy * dy + dz * dz <= 30)
+      {
+        const short value = label(static_cast<short>(stroke % 2 + 2));
+        it.Set(value);
+        ok &= it.Get() == value;
+        dense->SetPixel(index, value);
+      }
+    }
+  }
+  DenseImageType::IndexType index = brush.GetIndex();
+  rle->SetPixel(index, 1);
+  dense->SetPixel(index, 1);
+  rle->SetRun(index, 10, 0);
+  for (unsigned int x = 0; x < 10; x++, index[0]++)
+  {
+    dense->SetPixel(index, 0);
+  }
+  index = region.GetIndex(); // outside of the brush
+  rle->SetPixel(index, 3);
+  dense->SetPixel(index, label(3));
+  ok &= sameContent(dense.GetPointer(), rle.GetPointer(), "Edit session");
+  rle->EndEdit();
+  ok &= !rle->IsEditing() && sameContent(dense.GetPointer(), rle.GetPointer(), "Edit session ended");
+  ok &= cleanLines(rle.GetPointer());
+
+  ok &= lineBecomesAbsent(dense.GetPointer(),
+                          rle.GetPointer(),
+                          lineThrough(region, brush.GetIndex()),
+                          [&](const DenseImageType::RegionType & line) {
+                            rle->BeginEdit(line);
+                            {
+                              itk::ImageRegionIterator<RLEImageType> it(rle, line);
+                              for (; !it.IsAtEnd(); ++it)
+                              {
+                                it.Set(0);
+                              }
+                            }
+                            rle->EndEdit();
+                          });
+
+  // freezing ends the session
+  rle->BeginEdit(brush);
+  rle->SetPixel(brush.GetIndex(), 2);
+  dense->SetPixel(brush.GetIndex(), label(2));
+  rle->Freeze();
+  ok &= !rle->IsEditing() && sameContent(dense.GetPointer(), rle.GetPointer(), "Edit session frozen");
+
+  // iterators created before a session write to its rows, and carry on after its end
+  {
+    itk::ImageRegionIterator<RLEImageType>   it(rle, region);
+    itk::ImageRegionIterator<DenseImageType> dIt(dense, region);
+    rle->BeginEdit(brush); // thaws the image the iterator was created on
+    for (itk::SizeValueType n = 0; !it.IsAtEnd(); ++it, ++dIt, n++)
+    {
+      if (n == region.GetNumberOfPixels() / 2)
+      {
+        rle->EndEdit(); // rewrites the line the iterator is on
+      }
+      if (n % 3 == 0)
+      {
+        it.Set(static_cast<short>(n % 4));
+        dIt.Set(label(static_cast<short>(n % 4)));
+      }
+      ok &= it.Get() == dIt.Get();
+    }
+  }
+  ok &= !rle->IsEditing() && sameContent(dense.GetPointer(), rle.GetPointer(), "Iterated across an edit session");
+
+  std::cout << name << " edit session: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// dense slices written back along every axis, whatever the run axis
+template <typename RLEImageType>
+static bool
+testSetSlice(const DenseImageType::RegionType & region, const char * name)
+{
+  using SliceImageType = typename RLEImageType::SliceImageType;
+  RandomNumbers next{ 11 };
+  bool          ok = true;
+  for (unsigned int runAxis : { 0u, 2u })
+  {
+    DenseImageType::Pointer        dense;
+    typename RLEImageType::Pointer rle;
+    allocateImages(region, dense, rle, runAxis);
+    paint(dense.GetPointer(), 10);
+    paint(rle.GetPointer(), 10);
+
+    for (unsigned int axis = 0; axis < 3; axis++)
+    {
+      for (bool whole : { true, false })
+      {
+        typename SliceImageType::RegionType sliceRegion = region.Slice(axis);
+        if (!whole)
+        {
+          sliceRegion.ShrinkByRadius(1);
+        }
+        typename SliceImageType::Pointer slice = SliceImageType::New();
+        slice->SetRegions(sliceRegion);
+        slice->Allocate();
+        short value = 0;
+        for (itk::ImageRegionIterator<SliceImageType> it(slice, sliceRegion); !it.IsAtEnd(); ++it)
+        {
+          if (next(6) == 0) // runs of a few pixels, of labels new to the image but along axis 0
+          {
+            value = static_cast<short>(next(4) + 10 * axis);
+          }
+          it.Set(value);
+        }
+        const itk::IndexValueType position = region.GetIndex(axis) + itk::IndexValueType(next(region.GetSize(axis)));
+        itk::ImageRegionConstIteratorWithIndex<SliceImageType> it(slice, sliceRegion);
+        for (; !it.IsAtEnd(); ++it)
+        {
+          DenseImageType::IndexType index;
+          for (unsigned int d = 0, k = 0; d < 3; d++)
+          {
+            index[d] = d == axis ? position : it.GetIndex()[k++];
+          }
+          dense->SetPixel(index, it.Get());
+        }
+        rle->SetSlice(slice, axis, position, whole); // parts of slices in sequence
+        ok &= sameContent(dense.GetPointer(), rle.GetPointer(), whole ? "Slice written" : "Part of a slice written");
+        ok &= cleanLines(rle.GetPointer());
+      }
+    }
+
+    // a background slice along another axis makes the lines it covers absent
+    const unsigned int                  axis = (runAxis + 1) % 3;
+    typename SliceImageType::RegionType sliceRegion = region.Slice(axis);
+    typename SliceImageType::Pointer    slice = SliceImageType::New();
+    slice->SetRegions(sliceRegion);
+    slice->Allocate(true);
+    rle->Freeze();
+    rle->SetSlice(slice, axis, region.GetIndex(axis));
+    ok &= !rle->IsFrozen() && rle->GetBuffer()->GetPixel(rle->GetLineIndex(region.GetIndex())).empty();
+  }
+
+  std::cout << name << " slices: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+static RGBPixelType
+labelColour(short label)
+{
+  RGBPixelType colour;
+  colour.Set(static_cast<unsigned char>(60 * label), static_cast<unsigned char>(255 - label), 128);
+  return colour;
+}
+
+static itk::VariableLengthVector<float>
+labelVector(short label)
+{
+  itk::VariableLengthVector<float> vector(4);
+  vector.Fill(0.5f * label);
+  vector[1] = -label;
+  return vector;
+}
+
+// multi-component pixels are run-length encoded as whole pixels
+template <typename RLEVectorImageType, typename ColourFunction>
+static bool
+testVectorPixels(const DenseImageType::RegionType & region, ColourFunction colour, const char * name)
+{
+  using PixelType = typename RLEVectorImageType::PixelType;
+  using DenseVectorImageType = itk::Image<PixelType, 3>;
+  const unsigned int                     length = itk::NumericTraits<PixelType>::GetLength(colour(0));
+  typename DenseVectorImageType::Pointer dense = DenseVectorImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate();
+  typename RLEVectorImageType::Pointer rle = RLEVectorImageType::New();
+  rle->SetRegions(region);
+  rle->SetNumberOfComponentsPerPixel(length);
+  rle->Allocate();
+  rle->FillBuffer(colour(0)); // the default of a variable length pixel has no components
+
+  itk::ImageRegionIterator<DenseVectorImageType> dIt(dense, region);
+  itk::ImageRegionIterator<RLEVectorImageType>   rIt(rle, region);
+  for (; !dIt.IsAtEnd(); ++dIt, ++rIt)
+  {
+    const PixelType value = colour(labelAt(dIt.GetIndex(), 0));
+    dIt.Set(value);
+    rIt.Set(value);
+  }
+
+  auto sameVectors = [&dense, &region](const RLEVectorImageType * image) {
+    itk::ImageRegionConstIterator<DenseVectorImageType> it(dense, region);
+    itk::ImageRegionConstIterator<RLEVectorImageType>   vIt(image, image->GetLargestPossibleRegion());
+    bool                                                same = true;
+    for (; !it.IsAtEnd(); ++it, ++vIt)
+    {
+      same &= vIt.Get() == it.Get() && image->GetPixel(vIt.GetIndex()) == it.Get();
+    }
+    return same;
+  };
+  bool ok = sameVectors(rle) && rle->GetNumberOfComponentsPerPixel() == length;
+
+  using EncoderType = itk::RegionOfInterestImageFilter<DenseVectorImageType, RLEVectorImageType>;
+  typename EncoderType::Pointer encoder = EncoderType::New();
+  encoder->SetInput(dense);
+  encoder->SetRegionOfInterest(region);
+  encoder->Update();
+  ok &= sameVectors(encoder->GetOutput()) && encoder->GetOutput()->IsSameContent(rle);
+
+  using DecoderType = itk::RegionOfInterestImageFilter<RLEVectorImageType, DenseVectorImageType>;
+  typename DecoderType::Pointer decoder = DecoderType::New();
+  decoder->SetInput(rle);
+  decoder->SetRegionOfInterest(region);
+  decoder->Update();
+  itk::ImageRegionConstIterator<DenseVectorImageType> oIt(decoder->GetOutput(),
+                                                          decoder->GetOutput()->GetLargestPossibleRegion());
+  for (dIt.GoToBegin(); !dIt.IsAtEnd(); ++dIt, ++oIt)
+  {
+    ok &= dIt.Get() == oIt.Get();
+  }
+
+  if constexpr (std::is_trivially_copyable<PixelType>::value)
+  {
+    rle->Freeze();
+    ok &= rle->IsFrozen() && sameVectors(rle);
+  }
+
+  std::cout << name << ": " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+// runs longer than an unsigned char counter can count are split into several segments
+static bool
+testLongRuns()
+{
+  using NarrowRLEImageType = itk::RLEImage<short, 3, unsigned char>;
+
+  DenseImageType::RegionType region;
+  region.SetSize(0, 700);
+  region.SetSize(1, 4);
+  region.SetSize(2, 3);
+  DenseImageType::Pointer dense = DenseImageType::New();
+  dense->SetRegions(region);
+  dense->Allocate();
+  itk::ImageRegionIterator<DenseImageType> dIt(dense, region);
+  for (; !dIt.IsAtEnd(); ++dIt)
+  {
+    const DenseImageType::IndexType & index = dIt.GetIndex();
+    dIt.Set(index[0] % 97 == 0 ? 5 : (index[0] / 300 + index[1]) % 2);
+  }
+
+  // returns the number of segments, or zero if a line is malformed
+  auto segmentCount = [&region](const NarrowRLEImageType * image) {
+    itk::SizeValueType                                            count = 0;
+    itk::ImageRegionConstIterator<NarrowRLEImageType::BufferType> lIt(image->GetBuffer(),
+                                                                       image->GetBuffer()->GetBufferedRegion());
+    for (; !lIt.IsAtEnd(); ++lIt)
+    {
+      itk::SizeValueType length = 0;
+      for (itk::SizeValueType x = 0; x < lIt.Get().size(); x++)
+      {
+        if (lIt.Get()[x].first == 0)
+        {
+          return itk::SizeValueType(0);
+        }
+        length += lIt.Get()[x].first;
+      }
+      if (length != region.GetSize(0))
+      {
+        return itk::SizeValueType(0);
+      }
+      count += lIt.Get().size();
+    }
+    return count;
+  };
+  const itk::SizeValueType lineCount = region.GetNumberOfPixels() / region.GetSize(0);
+
+  NarrowRLEImageType::Pointer rle = NarrowRLEImageType::New();
+  rle->SetRegions(region);
+  rle->Allocate(true);
+  bool ok = segmentCount(rle) == 3 * lineCount; // 255 + 255 + 190
+
+  itk::ImageRegionIterator<NarrowRLEImageType> rIt(rle, region);
+  for (dIt.GoToBegin(); !dIt.IsAtEnd(); ++dIt, ++rIt)
+  {
+    rIt.Set(dIt.Get());
+  }
+  ok &= segmentCount(rle) > 0 && sameContent(dense.GetPointer(), rle.GetPointer(), "Long runs painted");
+
+  // merging on the fly stops at full segments, CleanUp() packs them
+  for (rIt.GoToBegin(); !rIt.IsAtEnd(); ++rIt)
+  {
+    rIt.Set(0);
+  }
+  ok &= segmentCount(rle) >= 3 * lineCount;
+  rle->SetOnTheFlyCleanup(false);
+  rle->SetOnTheFlyCleanup(true);
+  ok &= segmentCount(rle) == 3 * lineCount;
+
+  using EncoderType = itk::RegionOfInterestImageFilter<DenseImageType, NarrowRLEImageType>;
+  EncoderType::Pointer encoder = EncoderType::New();
+  encoder->SetInput(dense);
+  encoder->SetRegionOfInterest(region);
+  encoder->Update();
+  NarrowRLEImageType::Pointer encoded = encoder->GetOutput();
+  ok &= segmentCount(encoded) > 0 && sameContent(dense.GetPointer(), encoded.GetPointer(), "Long runs encoded");
+
+  // frozen lines store whole runs, and split them again when decoded
+  encoded->Freeze();
+  ok &= sameContent(dense.GetPointer(), encoded.GetPointer(), "Long runs frozen");
+
+  DenseImageType::RegionType roiRegion = region;
+  roiRegion.SetIndex(0, 10);
+  roiRegion.SetSize(0, 650);
+  using RoiType = itk::RegionOfInterestImageFilter<NarrowRLEImageType, NarrowRLEImageType>;
+  RoiType::Pointer roi = RoiType::New();
+  roi->SetInput(encoded);
+  roi->SetRegionOfInterest(roiRegion);
+  roi->Update();
+  NarrowRLEImageType * roiImage = roi->GetOutput();
+  ok &= roiImage->GetBuffer()->GetPixel({ { 0, 0 } }).size() > 2; // the first line has two long runs
+
+  itk::ImageRegionConstIterator<DenseImageType>     rdIt(dense, roiRegion);
+  itk::ImageRegionConstIterator<NarrowRLEImageType> oIt(roiImage, roiImage->GetLargestPossibleRegion());
+  for (; !rdIt.IsAtEnd(); ++rdIt, ++oIt)
+  {
+    ok &= rdIt.Get() == oIt.Get();
+  }
+
+  encoded->SetPixel(region.GetIndex(), 3); // thaws
+  dense->SetPixel(region.GetIndex(), 3);
+  ok &= segmentCount(encoded) > 0 && sameContent(dense.GetPointer(), encoded.GetPointer(), "Long runs thawed");
+
+  std::cout << "Long runs: " << (ok ? "OK" : "failed") << std::endl;
+  return ok;
+}
+
+int
+itkRLEImageStorageTest(int, char *[])
+{
+  DenseImageType::RegionType region;
+  region.SetSize(0, 150);
+  region.SetSize(1, 20);
+  region.SetSize(2, 10);
+  region.SetIndex(1, -3);
+
+  bool ok = testInlineLines(region);
+  ok &= testSharedLines(region);
+  ok &= testPalette(region);
+  ok &= testRunAxis(region, 1);
+  ok &= testRunAxis(region, 2);
+  ok &= testAutomaticRunAxis(region);
+  ok &= testLongRuns();
+  ok &= testBinaryMask(region);
+  ok &= testNoisyLines(region);
+  ok &= testSparseLines(region);
+  ok &= testSlabSummary(region);
+  ok &= testAllocate(region);
+#if __has_include(<memory_resource>)
+  ok &= testLineAllocator(region);
+#endif
+  ok &= testLineHashes(region);
+  const std::vector<short> labels{ 0, 1, 2, 3 };
+  ok &= testSetRun<RLEImageType>(region, labels, "Pairs");
+  ok &= testSetRun<SoARLEImageType>(region, labels, "Separate arrays");
+  ok &= testSetRun<CumulativeRLEImageType>(region, labels, "End positions");
+  ok &= testSetRun<HybridRLEImageType>(region, labels, "Pixel rows");
+  ok &= testSetRun<PaletteRLEImageType>(region, labels, "Palette");
+  ok &= testSetRun<itk::BinaryMaskRLEImage<short, 3>>(region, { 0, 255 }, "Binary mask");
+  ok &= testWriteCombining<RLEImageType>(region, "Pairs");
+  ok &= testWriteCombining<SoARLEImageType>(region, "Separate arrays");
+  ok &= testWriteCombining<CumulativeRLEImageType>(region, "End positions");
+  ok &= testWriteCombining<HybridRLEImageType>(region, "Pixel rows");
+  ok &= testWriteCombining<PaletteRLEImageType>(region, "Palette");
+  ok &= testSetPixels<RLEImageType>(region, "Pairs");
+  ok &= testSetPixels<SoARLEImageType>(region, "Separate arrays");
+  ok &= testSetPixels<CumulativeRLEImageType>(region, "End positions");
+  ok &= testSetPixels<HybridRLEImageType>(region, "Pixel rows");
+  ok &= testSetPixels<PaletteRLEImageType>(region, "Palette");
+  ok &= testEditSession<RLEImageType>(region, "Pairs");
+  ok &= testEditSession<SoARLEImageType>(region, "Separate arrays");
+  ok &= testEditSession<CumulativeRLEImageType>(region, "End positions");
+  ok &= testEditSession<HybridRLEImageType>(region, "Pixel rows");
+  ok &= testEditSession<PaletteRLEImageType>(region, "Palette");
+  ok &= testEditSession<itk::BinaryMaskRLEImage<bool, 3>>(region, "Binary mask");
+  ok &= testSetSlice<RLEImageType>(region, "Pairs");
+  ok &= testSetSlice<SoARLEImageType>(region, "Separate arrays");
+  ok &= testSetSlice<CumulativeRLEImageType>(region, "End positions");
+  ok &= testSetSlice<HybridRLEImageType>(region, "Pixel rows");
+  ok &= testSetSlice<PaletteRLEImageType>(region, "Palette");
+  ok &= testVectorPixels<RGBRLEImageType>(region, labelColour, "RGB pixels");
+  ok &= testVectorPixels<itk::PaletteRLEImage<RGBPixelType, 3, unsigned short, unsigned char>>(
+    region, labelColour, "RGB palette");
+  ok &= testVectorPixels<itk::HybridRLEImage<RGBPixelType, 3>>(region, labelColour, "RGB pixel rows");
+  ok &= testVectorPixels<itk::RLEImage<itk::VariableLengthVector<float>, 3>>(
+    region, labelVector, "Variable length pixels");
+  std::cout << "Segments stored as pairs" << std::endl;
+  ok &= testLayout<RLEImageType>(region);
+  std::cout << "Segments stored as separate arrays" << std::endl;
+  ok &= testLayout<SoARLEImageType>(region);
+  std::cout << "Segments stored by end positions" << std::endl;
+  ok &= testLayout<CumulativeRLEImageType>(region);
+  std::cout << "Segments or rows of pixels" << std::endl;
+  ok &= testLayout<HybridRLEImageType>(region);
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -160,6 +160,29 @@ doTest(std::string inFilename, std::string outFilename)
   std::cout << "Converting RLEImage to regular image" << std::endl;
   outConv->Update();
 
+  // encoding along the axis with the fewest segments gives the same image
+  typename inConverterType::Pointer autoConv = inConverterType::New();
+  autoConv->SetInput(reader->GetOutput());
+  autoConv->SetRegionOfInterest(reader->GetOutput()->GetLargestPossibleRegion());
+  autoConv->AutomaticRunAxisOn();
+  std::cout << "Converting regular image to RLEImage along the best axis" << std::endl;
+  autoConv->Update();
+  const unsigned int runAxis = autoConv->GetRunAxis();
+  std::cout << "  run axis " << runAxis << ", estimated segment count " << autoConv->GetEstimatedSegmentCount(runAxis)
+            << " (" << autoConv->GetEstimatedSegmentCount(0) << " along X)" << std::endl;
+  ITK_TEST_EXPECT_TRUE(autoConv->GetEstimatedSegmentCount(runAxis) <= autoConv->GetEstimatedSegmentCount(0));
+  typename myRLEImage::Pointer              autoEncoded = autoConv->GetOutput();
+  itk::ImageRegionConstIterator<ImageType>  dIt(reader->GetOutput(), reader->GetOutput()->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<myRLEImage> aIt(autoEncoded, autoEncoded->GetLargestPossibleRegion());
+  for (; !dIt.IsAtEnd(); ++dIt, ++aIt)
+  {
+    if (dIt.Get() != aIt.Get())
+    {
+      std::cerr << "Encoding along axis " << runAxis << " changed the pixel at " << dIt.GetIndex() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   using WriterType = itk::ImageFileWriter<ImageType>;
   typename WriterType::Pointer writer = WriterType::New();
   writer->SetFileName(outFilename);
@@ -0,0 +1,182 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+// Compares segment layouts of RLEImage on a given label image, e.g.:
+//   rleBenchmark wb-seg.nrrd
+
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkRLEImage.h"
+#include "itkRLERegionOfInterestImageFilter.h"
+#include "itkTestDriverIncludeRequiredIOFactories.h"
+#include "itkTimeProbe.h"
+#include <iostream>
+#include <random>
+#include <string>
+
+using ImageType = itk::Image<short, 3>;
+
+template <typename RLEImageType>
+itk::SizeValueType
+memoryUsed(const RLEImageType * image)
+{
+  if (image->IsFrozen())
+  {
+    return image->GetFrozenLines()->GetNumberOfBytes();
+  }
+  using BufferType = typename RLEImageType::BufferType;
+  itk::SizeValueType                        bytes = 0;
+  itk::ImageRegionConstIterator<BufferType> it(image->GetBuffer(), image->GetBuffer()->GetBufferedRegion());
+  for (; !it.IsAtEnd(); ++it)
+  {
+    bytes += sizeof(typename RLEImageType::RLLine) + it.Value().GetOwnedBytes();
+  }
+  return bytes;
+}
+
+template <typename RLEImageType>
+void
+benchmark(const std::string & name, const ImageType * dense, unsigned randomAccesses)
+{
+  itk::TimeProbe convertProbe, iterateProbe, randomProbe, decodeProbe, editProbe;
+  itk::TimeProbe freezeProbe, frozenIterateProbe, frozenRandomProbe;
+
+  using inConverterType = itk::RegionOfInterestImageFilter<ImageType, RLEImageType>;
+  typename inConverterType::Pointer inConv = inConverterType::New();
+  inConv->SetInput(dense);
+  inConv->SetRegionOfInterest(dense->GetLargestPossibleRegion());
+  convertProbe.Start();
+  inConv->Update();
+  convertProbe.Stop();
+  typename RLEImageType::Pointer rle = inConv->GetOutput();
+
+  long long                                   sum = 0;
+  itk::ImageRegionConstIterator<RLEImageType> it(rle, rle->GetLargestPossibleRegion());
+  iterateProbe.Start();
+  for (; !it.IsAtEnd(); ++it)
+  {
+    sum += it.Get();
+  }
+  iterateProbe.Stop();
+
+  const typename RLEImageType::RegionType region = rle->GetLargestPossibleRegion();
+  std::mt19937                            rng(42); // same positions for each layout
+  typename RLEImageType::IndexType        index;
+  randomProbe.Start();
+  for (unsigned i = 0; i < randomAccesses; i++)
+  {
+    for (unsigned d = 0; d < RLEImageType::ImageDimension; d++)
+    {
+      index[d] = region.GetIndex(d) + rng() % region.GetSize(d);
+    }
+    sum += rle->GetPixel(index);
+  }
+  randomProbe.Stop();
+
+  using outConverterType = itk::RegionOfInterestImageFilter<RLEImageType, ImageType>;
+  typename outConverterType::Pointer outConv = outConverterType::New();
+  outConv->SetInput(rle);
+  outConv->SetRegionOfInterest(region);
+  decodeProbe.Start();
+  outConv->Update();
+  decodeProbe.Stop();
+
+  const itk::SizeValueType memory = memoryUsed(rle.GetPointer());
+  freezeProbe.Start();
+  rle->Freeze();
+  freezeProbe.Stop();
+  const itk::SizeValueType frozenMemory = memoryUsed(rle.GetPointer());
+
+  frozenIterateProbe.Start();
+  for (it.GoToBegin(); !it.IsAtEnd(); ++it)
+  {
+    sum += it.Get();
+  }
+  frozenIterateProbe.Stop();
+
+  rng.seed(42);
+  frozenRandomProbe.Start();
+  for (unsigned i = 0; i < randomAccesses; i++)
+  {
+    for (unsigned d = 0; d < RLEImageType::ImageDimension; d++)
+    {
+      index[d] = region.GetIndex(d) + rng() % region.GetSize(d);
+    }
+    sum += rle->GetPixel(index);
+  }
+  frozenRandomProbe.Stop();
+  rle->Thaw();
+
+  rng.seed(42);
+  editProbe.Start();
+  for (unsigned i = 0; i < randomAccesses; i++)
+  {
+    for (unsigned d = 0; d < RLEImageType::ImageDimension; d++)
+    {
+      index[d] = region.GetIndex(d) + rng() % region.GetSize(d);
+    }
+    rle->SetPixel(index, static_cast<short>(i % 7));
+  }
+  editProbe.Stop();
+
+  std::cout << name << ":\n";
+  std::cout << "  memory: " << memory << " bytes, frozen: " << frozenMemory << " bytes\n";
+  std::cout << "  Image -> RLE: " << convertProbe.GetTotal() << " s\n";
+  std::cout << "  sequential iteration: " << iterateProbe.GetTotal() << " s\n";
+  std::cout << "  " << randomAccesses << " x GetPixel: " << randomProbe.GetTotal() << " s\n";
+  std::cout << "  RLE -> Image: " << decodeProbe.GetTotal() << " s\n";
+  std::cout << "  " << randomAccesses << " x SetPixel: " << editProbe.GetTotal() << " s\n";
+  std::cout << "  Freeze: " << freezeProbe.GetTotal() << " s\n";
+  std::cout << "  frozen sequential iteration: " << frozenIterateProbe.GetTotal() << " s\n";
+  std::cout << "  " << randomAccesses << " x frozen GetPixel: " << frozenRandomProbe.GetTotal() << " s\n";
+  std::cout << "  checksum: " << sum << std::endl;
+}
+
+int
+main(int argc, char * argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " inputImage [randomAccesses]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  unsigned randomAccesses = argc > 2 ? std::stoul(argv[2]) : 1000000;
+
+  using ReaderType = itk::ImageFileReader<ImageType>;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(argv[1]);
+
+  try
+  {
+    RegisterRequiredFactories();
+    reader->Update();
+    benchmark<itk::RLEImage<short, 3>>("RunLengthLine (pairs)", reader->GetOutput(), randomAccesses);
+    benchmark<itk::RLEImage<short, 3, unsigned short, itk::SoARunLengthLine<short, unsigned short>>>(
+      "SoARunLengthLine (separate arrays)", reader->GetOutput(), randomAccesses);
+    benchmark<itk::RLEImage<short, 3, unsigned short, itk::CumulativeRunLengthLine<short, unsigned short>>>(
+      "CumulativeRunLengthLine (end positions)", reader->GetOutput(), randomAccesses);
+    benchmark<itk::HybridRLEImage<short, 3>>(
+      "HybridRunLengthLine (rows of pixels when noisy)", reader->GetOutput(), randomAccesses);
+  }
+  catch (itk::ExceptionObject & error)
+  {
+    std::cerr << "Error: " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}